@@ -0,0 +1,755 @@
+/*
+ * btree.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: jinyang
+ */
+
+#ifndef MEMDB_DB_BTREE_H_
+#define MEMDB_DB_BTREE_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <algorithm>
+#include <set>
+#include <vector>
+#include "db/rowindex.h"
+#include "util/radix_sort.h"
+
+namespace memdb {
+
+// In-memory B+-tree over row buffers.
+//
+// Each slot stores the 64-bit key prefix computed by Compare::Prefix right
+// next to the row pointer, so a descent compares integers packed in a few
+// cache lines per node and only dereferences a row buffer when two prefixes
+// tie. Leaves are chained both ways for Next/Prev. Compare must provide
+//   uint64_t Prefix(const char *row) const;  order preserving key prefix
+//   bool PrefixIsKey() const;               equal prefixes mean equal keys
+//   bool Less(const char *r1, const char *r2) const;
+template<class Compare>
+class BTreeIndex: public RowIndex {
+public:
+	explicit BTreeIndex(const Compare &cmp) :
+			cmp_(cmp), root_(NULL), head_(NULL), tail_(NULL), size_(0),
+			node_bytes_(0) {
+	}
+	virtual ~BTreeIndex() {
+		Clear();
+	}
+
+	virtual bool Insert(char *row, bool replace, char **old) {
+		return InsertFromRoot(row, replace, old, NULL);
+	}
+	virtual bool InsertNear(IndexPos *hint, char *row, bool replace,
+			char **old);
+	virtual void BulkLoad(char **rows, size_t n, bool replace,
+			std::vector<char *> *displaced);
+	virtual char *Find(const char *probe);
+	virtual bool Remove(const char *probe, char **old);
+	virtual void Clear();
+	virtual size_t Size() {
+		return size_;
+	}
+	virtual size_t MemoryUsage() {
+		return sizeof(*this) + node_bytes_;
+	}
+	virtual uint64_t KeyPrefix(const char *row) {
+		return cmp_.Prefix(row);
+	}
+
+	virtual void SeekToFirst(IndexPos *p);
+	virtual void SeekToLast(IndexPos *p);
+	virtual void Seek(IndexPos *p, const char *probe);
+	virtual void MultiSeek(IndexPos *p, const char * const *probes, size_t n);
+	virtual void Next(IndexPos *p);
+	virtual void Prev(IndexPos *p);
+	virtual char *RowAt(const IndexPos &p) {
+		return ((Leaf *) p.node)->rows[p.slot];
+	}
+
+private:
+	enum {
+		kLeafSlots = 32, kInnerSlots = 31, kMaxHeight = 16
+	};
+
+	struct Node {
+		bool leaf;
+		int n;
+	};
+
+	struct Leaf: public Node {
+		Leaf *prev;
+		Leaf *next;
+		uint64_t keys[kLeafSlots];
+		char *rows[kLeafSlots];
+	};
+
+	// child[i] holds the rows whose keys lie in [separator i-1, separator i)
+	struct Inner: public Node {
+		uint64_t keys[kInnerSlots];
+		char *rows[kInnerSlots];
+		Node *child[kInnerSlots + 1];
+	};
+
+	bool Less(uint64_t k1, const char *r1, uint64_t k2, const char *r2) const {
+		if (k1 != k2)
+			return k1 < k2;
+		if (cmp_.PrefixIsKey())
+			return false;
+		return cmp_.Less(r1, r2);
+	}
+
+	// A row with its precomputed prefix
+	struct Entry {
+		uint64_t key;
+		char *row;
+	};
+
+	// Orders rows whose prefixes tie
+	struct RowLess {
+		const Compare *cmp;
+		bool operator()(const Entry &a, const Entry &b) const {
+			return cmp->Less(a.row, b.row);
+		}
+	};
+
+	// index of the first separator greater than the probe
+	int UpperBound(const Inner *in, uint64_t k, const char *r) const {
+		int lo = 0, hi = in->n;
+		while (lo < hi) {
+			int mid = (lo + hi) / 2;
+			if (Less(k, r, in->keys[mid], in->rows[mid]))
+				hi = mid;
+			else
+				lo = mid + 1;
+		}
+		return lo;
+	}
+
+	// index of the first slot that is not less than the probe
+	int LowerBound(const Leaf *l, uint64_t k, const char *r) const {
+		int lo = 0, hi = l->n;
+		while (lo < hi) {
+			int mid = (lo + hi) / 2;
+			if (Less(l->keys[mid], l->rows[mid], k, r))
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		return lo;
+	}
+
+	// Starts loading what a search of node n reads: the header and keys,
+	// which end later in a leaf than in an inner node
+	static void PrefetchNode(const Node *n) {
+		const char *p = (const char *) n;
+		const char *end = (const char *) (((const Leaf *) n)->keys + kLeafSlots);
+		for (; p < end; p += 64)
+			__builtin_prefetch(p);
+	}
+
+	Leaf *NewLeaf() {
+		Leaf *l = new Leaf;
+		node_bytes_ += sizeof(Leaf);
+		l->leaf = true;
+		l->n = 0;
+		l->prev = l->next = NULL;
+		return l;
+	}
+
+	Inner *NewInner() {
+		Inner *in = new Inner;
+		node_bytes_ += sizeof(Inner);
+		in->leaf = false;
+		in->n = 0;
+		return in;
+	}
+
+	void FreeLeaf(Leaf *l) {
+		node_bytes_ -= sizeof(Leaf);
+		delete l;
+	}
+
+	void FreeInner(Inner *in) {
+		node_bytes_ -= sizeof(Inner);
+		delete in;
+	}
+
+	static void InsertAt(Leaf *l, int pos, uint64_t k, char *row) {
+		memmove(l->keys + pos + 1, l->keys + pos,
+				(l->n - pos) * sizeof(uint64_t));
+		memmove(l->rows + pos + 1, l->rows + pos, (l->n - pos) * sizeof(char *));
+		l->keys[pos] = k;
+		l->rows[pos] = row;
+		l->n++;
+	}
+
+	// Insert, leaving *at (if not NULL) at the slot of row or of the row
+	// with its key
+	bool InsertFromRoot(char *row, bool replace, char **old, IndexPos *at);
+	void InsertIntoParent(Inner **path, int *slots, int depth, Node *left,
+			uint64_t k, char *r, Node *right);
+	int RemoveFromParent(Inner **path, int *slots, int depth);
+	void Build(const std::vector<Entry> &sorted);
+	void FreeNode(Node *n);
+
+	Compare cmp_;
+	Node *root_;
+	Leaf *head_;
+	Leaf *tail_;
+	size_t size_;
+	size_t node_bytes_; //bytes in leaves and inner nodes
+};
+
+template<class Compare>
+bool BTreeIndex<Compare>::InsertFromRoot(char *row, bool replace, char **old,
+		IndexPos *at) {
+	IndexPos unused;
+	if (at == NULL)
+		at = &unused;
+	uint64_t k = cmp_.Prefix(row);
+	if (root_ == NULL) {
+		Leaf *l = NewLeaf();
+		InsertAt(l, 0, k, row);
+		root_ = head_ = tail_ = l;
+		size_ = 1;
+		at->node = l;
+		at->slot = 0;
+		return true;
+	}
+
+	Inner *path[kMaxHeight];
+	int slots[kMaxHeight];
+	int depth = 0;
+	Inner *eq = NULL; //inner node whose separator has the same key as row
+	int eqslot = 0;
+	Node *n = root_;
+	while (!n->leaf) {
+		Inner *in = (Inner *) n;
+		int i = UpperBound(in, k, row);
+		if (i > 0 && !Less(in->keys[i - 1], in->rows[i - 1], k, row)) {
+			eq = in;
+			eqslot = i - 1;
+		}
+		assert(depth < kMaxHeight);
+		path[depth] = in;
+		slots[depth] = i;
+		depth++;
+		n = in->child[i];
+	}
+
+	Leaf *l = (Leaf *) n;
+	int pos = LowerBound(l, k, row);
+	at->node = l;
+	at->slot = pos;
+	if (pos < l->n && !Less(k, row, l->keys[pos], l->rows[pos])) {
+		if (!replace)
+			return false;
+		*old = l->rows[pos];
+		l->rows[pos] = row;
+		if (eq) {
+			//separators point at live rows, keep it that way
+			assert(eq->rows[eqslot] == *old);
+			eq->rows[eqslot] = row;
+		}
+		return true;
+	}
+
+	size_++;
+	if (l->n < kLeafSlots) {
+		InsertAt(l, pos, k, row);
+		return true;
+	}
+
+	Leaf *r = NewLeaf();
+	int half = kLeafSlots / 2;
+	r->n = l->n - half;
+	memcpy(r->keys, l->keys + half, r->n * sizeof(uint64_t));
+	memcpy(r->rows, l->rows + half, r->n * sizeof(char *));
+	l->n = half;
+	r->prev = l;
+	r->next = l->next;
+	if (l->next)
+		l->next->prev = r;
+	else
+		tail_ = r;
+	l->next = r;
+	if (pos <= half) {
+		InsertAt(l, pos, k, row);
+	} else {
+		InsertAt(r, pos - half, k, row);
+		at->node = r;
+		at->slot = pos - half;
+	}
+	InsertIntoParent(path, slots, depth, l, r->keys[0], r->rows[0], r);
+	return true;
+}
+
+//A search for row would end in the hinted leaf if row's key lies between
+//the leaf's first and last keys, or beyond them at either end of the tree.
+//Rows that need a split, or have an equal key that a separator may point
+//at, take the way from the root.
+template<class Compare>
+bool BTreeIndex<Compare>::InsertNear(IndexPos *hint, char *row, bool replace,
+		char **old) {
+	Leaf *l = (Leaf *) hint->node;
+	if (l == NULL || l->n == 0 || l->n == kLeafSlots)
+		return InsertFromRoot(row, replace, old, hint);
+	uint64_t k = cmp_.Prefix(row);
+	int last = l->n - 1;
+	if ((l != head_ && !Less(l->keys[0], l->rows[0], k, row))
+			|| (l != tail_ && !Less(k, row, l->keys[last], l->rows[last])))
+		return InsertFromRoot(row, replace, old, hint);
+	int pos = LowerBound(l, k, row);
+	if (pos < l->n && !Less(k, row, l->keys[pos], l->rows[pos]))
+		return InsertFromRoot(row, replace, old, hint);
+	InsertAt(l, pos, k, row);
+	size_++;
+	hint->slot = pos;
+	return true;
+}
+
+template<class Compare>
+void BTreeIndex<Compare>::InsertIntoParent(Inner **path, int *slots,
+		int depth, Node *left, uint64_t k, char *r, Node *right) {
+	while (depth > 0) {
+		depth--;
+		Inner *in = path[depth];
+		int i = slots[depth]; //left is in->child[i]
+		int n = in->n;
+		if (n < kInnerSlots) {
+			memmove(in->keys + i + 1, in->keys + i, (n - i) * sizeof(uint64_t));
+			memmove(in->rows + i + 1, in->rows + i, (n - i) * sizeof(char *));
+			memmove(in->child + i + 2, in->child + i + 1,
+					(n - i) * sizeof(Node *));
+			in->keys[i] = k;
+			in->rows[i] = r;
+			in->child[i + 1] = right;
+			in->n++;
+			return;
+		}
+
+		//full, lay out all n+1 separators and split around the middle one
+		uint64_t tk[kInnerSlots + 1];
+		char *tr[kInnerSlots + 1];
+		Node *tc[kInnerSlots + 2];
+		memcpy(tk, in->keys, i * sizeof(uint64_t));
+		memcpy(tr, in->rows, i * sizeof(char *));
+		memcpy(tc, in->child, (i + 1) * sizeof(Node *));
+		tk[i] = k;
+		tr[i] = r;
+		tc[i + 1] = right;
+		memcpy(tk + i + 1, in->keys + i, (n - i) * sizeof(uint64_t));
+		memcpy(tr + i + 1, in->rows + i, (n - i) * sizeof(char *));
+		memcpy(tc + i + 2, in->child + i + 1, (n - i) * sizeof(Node *));
+
+		int total = n + 1;
+		int mid = total / 2;
+		Inner *sib = NewInner();
+		in->n = mid;
+		memcpy(in->keys, tk, mid * sizeof(uint64_t));
+		memcpy(in->rows, tr, mid * sizeof(char *));
+		memcpy(in->child, tc, (mid + 1) * sizeof(Node *));
+		sib->n = total - mid - 1;
+		memcpy(sib->keys, tk + mid + 1, sib->n * sizeof(uint64_t));
+		memcpy(sib->rows, tr + mid + 1, sib->n * sizeof(char *));
+		memcpy(sib->child, tc + mid + 1, (sib->n + 1) * sizeof(Node *));
+
+		left = in;
+		k = tk[mid];
+		r = tr[mid];
+		right = sib;
+	}
+
+	Inner *root = NewInner();
+	root->n = 1;
+	root->keys[0] = k;
+	root->rows[0] = r;
+	root->child[0] = left;
+	root->child[1] = right;
+	root_ = root;
+}
+
+template<class Compare>
+void BTreeIndex<Compare>::BulkLoad(char **rows, size_t n, bool replace,
+		std::vector<char *> *displaced) {
+	std::vector<Entry> batch(n);
+	for (size_t i = 0; i < n; i++) {
+		batch[i].key = cmp_.Prefix(rows[i]);
+		batch[i].row = rows[i];
+	}
+	//stable, so rows with equal keys stay in batch order
+	ParallelRadixSort(&batch);
+	if (!cmp_.PrefixIsKey()) {
+		RowLess less = { &cmp_ };
+		for (size_t i = 0, j; i < n; i = j) {
+			for (j = i + 1; j < n && batch[j].key == batch[i].key; j++)
+				;
+			if (j - i > 1)
+				std::stable_sort(batch.begin() + i, batch.begin() + j, less);
+		}
+	}
+
+	//collapse runs of equal keys inside the batch
+	std::set<char *> refused;
+	size_t m = 0;
+	for (size_t i = 0; i < n; i++) {
+		Entry &e = batch[i];
+		if (m > 0 && !Less(batch[m - 1].key, batch[m - 1].row, e.key, e.row)) {
+			if (replace) {
+				displaced->push_back(batch[m - 1].row);
+				batch[m - 1] = e;
+			} else {
+				refused.insert(e.row);
+			}
+			continue;
+		}
+		batch[m++] = e;
+	}
+	batch.resize(m);
+
+	//merge with the rows already in the tree, they come first in time
+	std::vector<Entry> all;
+	all.reserve(size_ + m);
+	Leaf *l = head_;
+	int slot = 0;
+	size_t j = 0;
+	while (l || j < m) {
+		if (l == NULL) {
+			all.push_back(batch[j++]);
+			continue;
+		}
+		Entry e = { l->keys[slot], l->rows[slot] };
+		bool take_old = true;
+		if (j < m) {
+			Entry &b = batch[j];
+			if (Less(b.key, b.row, e.key, e.row)) {
+				e = b;
+				j++;
+				take_old = false;
+			} else if (!Less(e.key, e.row, b.key, b.row)) {
+				if (replace) {
+					displaced->push_back(e.row);
+					e = b;
+				} else {
+					refused.insert(b.row);
+				}
+				j++;
+			}
+		}
+		all.push_back(e);
+		if (take_old && ++slot >= l->n) {
+			l = l->next;
+			slot = 0;
+		}
+	}
+
+	if (!refused.empty()) {
+		for (size_t i = 0; i < n; i++) {
+			if (refused.count(rows[i]))
+				rows[i] = NULL;
+		}
+	}
+	Clear();
+	Build(all);
+}
+
+// Packs sorted, unique entries into full leaves, then stacks inner levels
+// on top of them. Nodes on one level get counts that differ by at most one,
+// so no inner node ends up with a single child.
+template<class Compare>
+void BTreeIndex<Compare>::Build(const std::vector<Entry> &sorted) {
+	size_t n = sorted.size();
+	if (n == 0)
+		return;
+
+	std::vector<Node *> level;
+	std::vector<size_t> mins; //index in sorted of each node's smallest row
+	size_t nleaves = (n + kLeafSlots - 1) / kLeafSlots;
+	size_t pos = 0;
+	Leaf *prev = NULL;
+	for (size_t i = 0; i < nleaves; i++) {
+		size_t cnt = (n - pos) / (nleaves - i);
+		Leaf *l = NewLeaf();
+		for (size_t c = 0; c < cnt; c++) {
+			l->keys[c] = sorted[pos + c].key;
+			l->rows[c] = sorted[pos + c].row;
+		}
+		l->n = cnt;
+		l->prev = prev;
+		if (prev)
+			prev->next = l;
+		else
+			head_ = l;
+		prev = l;
+		level.push_back(l);
+		mins.push_back(pos);
+		pos += cnt;
+	}
+	tail_ = prev;
+
+	while (level.size() > 1) {
+		std::vector<Node *> up;
+		std::vector<size_t> upmins;
+		size_t groups = (level.size() + kInnerSlots) / (kInnerSlots + 1);
+		pos = 0;
+		for (size_t g = 0; g < groups; g++) {
+			size_t cnt = (level.size() - pos) / (groups - g);
+			Inner *in = NewInner();
+			in->child[0] = level[pos];
+			for (size_t c = 1; c < cnt; c++) {
+				in->keys[c - 1] = sorted[mins[pos + c]].key;
+				in->rows[c - 1] = sorted[mins[pos + c]].row;
+				in->child[c] = level[pos + c];
+			}
+			in->n = cnt - 1;
+			up.push_back(in);
+			upmins.push_back(mins[pos]);
+			pos += cnt;
+		}
+		level.swap(up);
+		mins.swap(upmins);
+	}
+	root_ = level[0];
+	size_ = n;
+}
+
+//Nodes are never merged, only dropped once empty, so a tree that shrank
+//may be sparser than one built from its rows
+template<class Compare>
+bool BTreeIndex<Compare>::Remove(const char *probe, char **old) {
+	if (root_ == NULL)
+		return false;
+	uint64_t k = cmp_.Prefix(probe);
+	Inner *path[kMaxHeight];
+	int slots[kMaxHeight];
+	int depth = 0;
+	int eqdepth = -1; //where the separator with the probe's key is, if any
+	Node *n = root_;
+	while (!n->leaf) {
+		Inner *in = (Inner *) n;
+		int i = UpperBound(in, k, probe);
+		if (i > 0 && !Less(in->keys[i - 1], in->rows[i - 1], k, probe))
+			eqdepth = depth;
+		path[depth] = in;
+		slots[depth] = i;
+		depth++;
+		n = in->child[i];
+	}
+
+	Leaf *l = (Leaf *) n;
+	int pos = LowerBound(l, k, probe);
+	if (pos == l->n || Less(k, probe, l->keys[pos], l->rows[pos]))
+		return false;
+	*old = l->rows[pos];
+	size_--;
+	l->n--;
+	memmove(l->keys + pos, l->keys + pos + 1, (l->n - pos) * sizeof(uint64_t));
+	memmove(l->rows + pos, l->rows + pos + 1, (l->n - pos) * sizeof(char *));
+
+	//the row that now follows the removed one, NULL if it was the last
+	Leaf *succ = l;
+	int succpos = pos;
+	if (pos == l->n) {
+		succ = l->next;
+		succpos = 0;
+	}
+	int gone = depth; //first level whose node survives
+	if (l->n == 0) {
+		if (l->prev)
+			l->prev->next = l->next;
+		else
+			head_ = l->next;
+		if (l->next)
+			l->next->prev = l->prev;
+		else
+			tail_ = l->prev;
+		FreeLeaf(l);
+		gone = RemoveFromParent(path, slots, depth);
+	}
+	//separators point at live rows, a separator equal to the removed row
+	//bounds a subtree that still holds the successor
+	if (eqdepth >= 0 && eqdepth < gone) {
+		Inner *in = path[eqdepth];
+		int i = slots[eqdepth] - 1;
+		assert(in->rows[i] == *old && succ != NULL);
+		in->keys[i] = succ->keys[succpos];
+		in->rows[i] = succ->rows[succpos];
+	}
+	while (root_ && !root_->leaf && root_->n == 0) {
+		Inner *in = (Inner *) root_;
+		root_ = in->child[0];
+		FreeInner(in);
+	}
+	return true;
+}
+
+//Drops the child at path[depth-1]->child[slots[depth-1]], which has been
+//freed, along with one separator, and frees ancestors left without
+//children. Returns the depth of the deepest node still alive, which has
+//lost a separator, or -1 if the tree is now empty.
+template<class Compare>
+int BTreeIndex<Compare>::RemoveFromParent(Inner **path, int *slots,
+		int depth) {
+	while (depth > 0) {
+		depth--;
+		Inner *in = path[depth];
+		int i = slots[depth];
+		if (in->n == 0) {
+			//its only child is gone
+			FreeInner(in);
+			continue;
+		}
+		//child i covers [separator i-1, separator i), drop the bound on the
+		//side that has a neighbour to absorb the range
+		int s = i > 0 ? i - 1 : 0;
+		memmove(in->keys + s, in->keys + s + 1,
+				(in->n - s - 1) * sizeof(uint64_t));
+		memmove(in->rows + s, in->rows + s + 1, (in->n - s - 1) * sizeof(char *));
+		memmove(in->child + i, in->child + i + 1, (in->n - i) * sizeof(Node *));
+		in->n--;
+		return depth;
+	}
+	root_ = NULL;
+	return -1;
+}
+
+template<class Compare>
+void BTreeIndex<Compare>::FreeNode(Node *n) {
+	if (n->leaf) {
+		FreeLeaf((Leaf *) n);
+		return;
+	}
+	Inner *in = (Inner *) n;
+	for (int i = 0; i <= in->n; i++)
+		FreeNode(in->child[i]);
+	FreeInner(in);
+}
+
+template<class Compare>
+void BTreeIndex<Compare>::Clear() {
+	if (root_)
+		FreeNode(root_);
+	root_ = NULL;
+	head_ = tail_ = NULL;
+	size_ = 0;
+}
+
+template<class Compare>
+void BTreeIndex<Compare>::SeekToFirst(IndexPos *p) {
+	p->node = head_;
+	p->slot = 0;
+}
+
+template<class Compare>
+void BTreeIndex<Compare>::SeekToLast(IndexPos *p) {
+	p->node = tail_;
+	p->slot = tail_ ? tail_->n - 1 : 0;
+}
+
+template<class Compare>
+void BTreeIndex<Compare>::Seek(IndexPos *p, const char *probe) {
+	if (root_ == NULL) {
+		p->node = NULL;
+		return;
+	}
+	uint64_t k = cmp_.Prefix(probe);
+	Node *n = root_;
+	while (!n->leaf) {
+		Inner *in = (Inner *) n;
+		n = in->child[UpperBound(in, k, probe)];
+	}
+	Leaf *l = (Leaf *) n;
+	int pos = LowerBound(l, k, probe);
+	if (pos == l->n) {
+		l = l->next;
+		pos = 0;
+	}
+	p->node = l;
+	p->slot = pos;
+}
+
+//Descends for a group of probes one level at a time and prefetches the
+//node each one needs next; by the time a probe searches its node the
+//others have been waiting on theirs too, instead of one miss after
+//another per level
+template<class Compare>
+void BTreeIndex<Compare>::MultiSeek(IndexPos *p, const char * const *probes,
+		size_t n) {
+	enum {
+		kGroup = 16
+	};
+	for (size_t base = 0; base < n; base += kGroup) {
+		size_t m = n - base < kGroup ? n - base : kGroup;
+		if (root_ == NULL) {
+			for (size_t i = 0; i < m; i++)
+				p[base + i].node = NULL;
+			continue;
+		}
+		uint64_t k[kGroup];
+		Node *node[kGroup];
+		for (size_t i = 0; i < m; i++) {
+			k[i] = cmp_.Prefix(probes[base + i]);
+			node[i] = root_;
+		}
+		//a probe is done once it stands on a leaf
+		for (size_t left = m; left > 0;) {
+			left = 0;
+			for (size_t i = 0; i < m; i++) {
+				if (node[i]->leaf)
+					continue;
+				Inner *in = (Inner *) node[i];
+				node[i] = in->child[UpperBound(in, k[i], probes[base + i])];
+				PrefetchNode(node[i]);
+				left++;
+			}
+		}
+		for (size_t i = 0; i < m; i++) {
+			Leaf *l = (Leaf *) node[i];
+			int pos = LowerBound(l, k[i], probes[base + i]);
+			if (pos == l->n) {
+				l = l->next;
+				pos = 0;
+			}
+			p[base + i].node = l;
+			p[base + i].slot = pos;
+		}
+	}
+}
+
+template<class Compare>
+char *BTreeIndex<Compare>::Find(const char *probe) {
+	IndexPos p;
+	Seek(&p, probe);
+	if (!p.Valid())
+		return NULL;
+	Leaf *l = (Leaf *) p.node;
+	if (Less(cmp_.Prefix(probe), probe, l->keys[p.slot], l->rows[p.slot]))
+		return NULL;
+	return l->rows[p.slot];
+}
+
+template<class Compare>
+void BTreeIndex<Compare>::Next(IndexPos *p) {
+	Leaf *l = (Leaf *) p->node;
+	if (++p->slot >= l->n) {
+		p->node = l->next;
+		p->slot = 0;
+	}
+}
+
+template<class Compare>
+void BTreeIndex<Compare>::Prev(IndexPos *p) {
+	Leaf *l = (Leaf *) p->node;
+	if (--p->slot < 0) {
+		l = l->prev;
+		p->node = l;
+		p->slot = l ? l->n - 1 : 0;
+	}
+}
+
+} //namespace memdb
+
+#endif
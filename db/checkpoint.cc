@@ -0,0 +1,253 @@
+/*
+ * checkpoint.cc
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: jinyang
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+#include "db/checkpoint.h"
+#include "db/rowformat.h"
+
+namespace memdb {
+
+static const char kMagic[8] = { 'm', 'e', 'm', 'd', 'b', 'c', 'k', '2' };
+static const uint32_t kBlockRows = 64;
+
+static uint64_t Align(uint64_t off, uint64_t a) {
+	return (off + a - 1) / a * a;
+}
+
+static bool Pad(FILE *f, uint64_t *off, uint64_t to) {
+	static const char zeros[64] = { 0 };
+	assert(to - *off <= sizeof(zeros));
+	if (fwrite(zeros, 1, to - *off, f) != to - *off)
+		return false;
+	*off = to;
+	return true;
+}
+
+//Tombstones of a table with snapshots stay out of the checkpoint
+static bool IsLive(TableSchema *schema, const char *row) {
+	int pos = schema->GetVersionPos();
+	return pos < 0 || !((const RowVersion *) (row + pos))->deleted;
+}
+
+static void DescribeColumn(TableSchema *schema, int i, CheckpointColumn *c) {
+	memset(c, 0, sizeof(*c));
+	c->type = schema->GetColumnType(i);
+	c->pos = schema->GetColumnPos(i);
+	c->size = schema->GetColumnSize(i);
+	for (int k = 0; k < schema->NumKeyColumns(); k++) {
+		if (schema->GetKeyColumn(k) == i)
+			c->key = (k + 1)
+					| (schema->IsKeyDescending(k) ?
+							CheckpointColumn::kDescending : 0);
+	}
+}
+
+//Two passes over the rows: the rows, with their long strings pointed at
+//where the heap will put them, then the heap itself
+static bool WriteSections(TableSchema *schema, RowCursor *rows, FILE *f,
+		CheckpointHeader *h) {
+	int ncols = schema->NumColumns();
+	uint64_t off = sizeof(CheckpointHeader);
+	h->columns_off = off;
+	for (int i = 0; i < ncols; i++) {
+		CheckpointColumn c;
+		DescribeColumn(schema, i, &c);
+		if (fwrite(&c, sizeof(c), 1, f) != 1)
+			return false;
+	}
+	off += ncols * sizeof(CheckpointColumn);
+	if (!Pad(f, &off, Align(off, 64)))
+		return false;
+
+	int rs = schema->RowSize();
+	h->rows_off = off;
+	h->heap_off = h->rows_off + h->nrows * rs;
+	std::vector<char> buf(rs);
+	std::vector<uint64_t> blocks;
+	uint64_t heap = 0, nrows = 0;
+	for (rows->SeekToFirst(); rows->Valid(); rows->Next()) {
+		const char *row = rows->Row();
+		if (!IsLive(schema, row))
+			continue;
+		if (nrows % kBlockRows == 0)
+			blocks.push_back(rows->KeyPrefix(row));
+		memcpy(buf.data(), row, rs);
+		//versions do not outlive the table
+		if (schema->GetVersionPos() >= 0)
+			memset(buf.data() + schema->GetVersionPos(), 0, sizeof(RowVersion));
+		for (int i = 0; i < ncols; i++) {
+			if (schema->GetColumnType(i) != cString)
+				continue;
+			uint32_t len = StrColumn::Length(row + schema->GetColumnPos(i));
+			if (StrColumn::IsInline(len))
+				continue;
+			//the column lands at rows_off + nrows * rs + pos, its string at
+			//heap_off + heap, only the distance between them matters
+			uint64_t col = h->rows_off + nrows * rs + schema->GetColumnPos(i);
+			int64_t delta = (int64_t) (h->heap_off + heap) - (int64_t) col;
+			memcpy(buf.data() + schema->GetColumnPos(i) + 8, &delta,
+					sizeof(delta));
+			heap += len + 1;
+		}
+		if (fwrite(buf.data(), 1, rs, f) != (size_t) rs)
+			return false;
+		nrows++;
+	}
+	assert(nrows == h->nrows);
+
+	for (rows->SeekToFirst(); rows->Valid(); rows->Next()) {
+		const char *row = rows->Row();
+		if (!IsLive(schema, row))
+			continue;
+		for (int i = 0; i < ncols; i++) {
+			if (schema->GetColumnType(i) != cString)
+				continue;
+			const char *col = row + schema->GetColumnPos(i);
+			uint32_t len = StrColumn::Length(col);
+			if (StrColumn::IsInline(len))
+				continue;
+			if (fwrite(StrColumn::Data(col), 1, len + 1, f) != len + 1)
+				return false;
+		}
+	}
+	h->heap_size = heap;
+	off = h->heap_off + heap;
+	if (!Pad(f, &off, Align(off, 8)))
+		return false;
+
+	h->blocks_off = off;
+	if (!blocks.empty()
+			&& fwrite(blocks.data(), sizeof(uint64_t), blocks.size(), f)
+					!= blocks.size())
+		return false;
+	return true;
+}
+
+namespace {
+
+class IndexCursor: public RowCursor {
+public:
+	explicit IndexCursor(RowIndex *index) :
+			index_(index) {
+	}
+	virtual void SeekToFirst() {
+		index_->SeekToFirst(&p_);
+	}
+	virtual bool Valid() {
+		return p_.Valid();
+	}
+	virtual void Next() {
+		index_->Next(&p_);
+	}
+	virtual const char *Row() {
+		return index_->RowAt(p_);
+	}
+	virtual uint64_t KeyPrefix(const char *row) {
+		return index_->KeyPrefix(row);
+	}
+
+private:
+	RowIndex *index_;
+	IndexPos p_;
+};
+
+} //namespace
+
+bool WriteCheckpoint(TableSchema *schema, RowIndex *index,
+		const std::string &path) {
+	IndexCursor rows(index);
+	return WriteCheckpoint(schema, &rows, path);
+}
+
+bool WriteCheckpoint(TableSchema *schema, RowCursor *rows,
+		const std::string &path) {
+	std::string tmp = path + ".tmp";
+	FILE *f = fopen(tmp.c_str(), "w");
+	if (f == NULL)
+		return false;
+	CheckpointHeader h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, kMagic, sizeof(kMagic));
+	h.ncols = schema->NumColumns();
+	h.row_size = schema->RowSize();
+	h.index_col = schema->GetIndexNumber();
+	h.primary_col = schema->GetPrimaryNumber();
+	for (rows->SeekToFirst(); rows->Valid(); rows->Next())
+		h.nrows += IsLive(schema, rows->Row());
+	h.block_rows = kBlockRows;
+
+	bool ok = fwrite(&h, sizeof(h), 1, f) == 1
+			&& WriteSections(schema, rows, f, &h) && fseek(f, 0, SEEK_SET) == 0
+			&& fwrite(&h, sizeof(h), 1, f) == 1 && fflush(f) == 0
+			&& fdatasync(fileno(f)) == 0;
+	ok = (fclose(f) == 0) && ok;
+	if (ok)
+		ok = rename(tmp.c_str(), path.c_str()) == 0;
+	if (!ok)
+		unlink(tmp.c_str());
+	return ok;
+}
+
+Checkpoint::Checkpoint() :
+		base_(NULL), size_(0), header_(NULL) {
+}
+
+Checkpoint::~Checkpoint() {
+	if (base_)
+		munmap((void *) base_, size_);
+}
+
+bool Checkpoint::Open(const std::string &path, TableSchema *schema) {
+	assert(base_ == NULL);
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(CheckpointHeader)) {
+		close(fd);
+		return false;
+	}
+	void *m = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (m == MAP_FAILED)
+		return false;
+	base_ = (const char *) m;
+	size_ = st.st_size;
+	header_ = (const CheckpointHeader *) base_;
+
+	const CheckpointHeader *h = header_;
+	bool ok = memcmp(h->magic, kMagic, sizeof(kMagic)) == 0
+			&& h->ncols == (uint32_t) schema->NumColumns()
+			&& h->row_size == (uint32_t) schema->RowSize() && h->block_rows > 0
+			&& h->index_col == (uint32_t) schema->GetIndexNumber()
+			&& h->primary_col == (uint32_t) schema->GetPrimaryNumber()
+			&& h->columns_off + h->ncols * sizeof(CheckpointColumn) <= size_
+			&& h->rows_off + h->nrows * h->row_size == h->heap_off
+			&& h->heap_off + h->heap_size <= h->blocks_off
+			&& h->blocks_off + NumBlocks() * sizeof(uint64_t) <= size_;
+	for (uint32_t i = 0; ok && i < h->ncols; i++) {
+		const CheckpointColumn *columns =
+				(const CheckpointColumn *) (base_ + h->columns_off);
+		CheckpointColumn c;
+		DescribeColumn(schema, i, &c);
+		ok = memcmp(&columns[i], &c, sizeof(c)) == 0;
+	}
+	if (!ok) {
+		munmap(m, size_);
+		base_ = NULL;
+		header_ = NULL;
+	}
+	return ok;
+}
+
+} //namespace memdb
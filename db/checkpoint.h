@@ -0,0 +1,241 @@
+/*
+ * checkpoint.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: jinyang
+ */
+
+#ifndef MEMDB_DB_CHECKPOINT_H_
+#define MEMDB_DB_CHECKPOINT_H_
+
+#include <stdint.h>
+#include <assert.h>
+#include <string>
+#include "db/rowindex.h"
+#include "db/tableschema.h"
+
+namespace memdb {
+
+// A checkpoint file holds the rows of a table in index order, laid out so
+// the file can be mapped and read in place:
+//   header   CheckpointHeader
+//   columns  CheckpointColumn per column, which with the index and primary
+//            of the header describe the schema the rows were laid out by
+//   rows     nrows row buffers, exactly as in memory, starting 64 byte
+//            aligned; long strings refer into the heap by their offset from
+//            the column (see StrColumn)
+//   heap     the NUL terminated long strings
+//   blocks   uint64 key prefix (RowIndex::KeyPrefix) of the first row of
+//            every block of block_rows rows
+struct CheckpointHeader {
+	char magic[8];
+	uint32_t ncols;
+	uint32_t row_size;
+	uint64_t nrows;
+	uint32_t block_rows;
+	uint32_t index_col; //the main index column
+	uint32_t primary_col;
+	uint32_t unused;
+	uint64_t columns_off;
+	uint64_t rows_off;
+	uint64_t heap_off;
+	uint64_t heap_size;
+	uint64_t blocks_off;
+};
+
+struct CheckpointColumn {
+	uint32_t type;
+	uint32_t pos; //within a row
+	uint32_t size;
+	// 0 unless the column is part i of a SetKey key, then i + 1, with
+	// kDescending set if that part is descending
+	uint32_t key;
+
+	static const uint32_t kDescending = 1u << 31;
+};
+
+// The rows a checkpoint is written from, in index order. WriteCheckpoint
+// goes through them several times.
+class RowCursor {
+public:
+	virtual ~RowCursor() {
+	}
+	virtual void SeekToFirst() = 0;
+	virtual bool Valid() = 0;
+	virtual void Next() = 0;
+	virtual const char *Row() = 0;
+	// As RowIndex::KeyPrefix
+	virtual uint64_t KeyPrefix(const char *row) = 0;
+};
+
+// Writes the rows of index to a checkpoint at path. The file is written
+// under a temporary name, synced and renamed, so path always holds a
+// complete checkpoint. Returns false on I/O errors.
+// REQUIRES: index is not modified while this runs
+bool WriteCheckpoint(TableSchema *schema, RowIndex *index,
+		const std::string &path);
+bool WriteCheckpoint(TableSchema *schema, RowCursor *rows,
+		const std::string &path);
+
+// A checkpoint mapped read-only into memory
+class Checkpoint {
+public:
+	Checkpoint();
+	~Checkpoint();
+
+	// Maps the checkpoint at path. Returns false if it cannot be read or
+	// was not written for a schema with the same columns, laid out the
+	// same way, and the same index, primary and key.
+	bool Open(const std::string &path, TableSchema *schema);
+
+	const char *Rows() const {
+		return base_ + header_->rows_off;
+	}
+	size_t NumRows() const {
+		return header_->nrows;
+	}
+	int RowSize() const {
+		return header_->row_size;
+	}
+	const uint64_t *BlockKeys() const {
+		return (const uint64_t *) (base_ + header_->blocks_off);
+	}
+	size_t BlockRows() const {
+		return header_->block_rows;
+	}
+	size_t NumBlocks() const {
+		return (NumRows() + BlockRows() - 1) / BlockRows();
+	}
+
+private:
+	const char *base_; //NULL until opened
+	size_t size_;
+	const CheckpointHeader *header_;
+
+	//no copying allowed
+	Checkpoint(const Checkpoint &);
+	void operator=(const Checkpoint &);
+};
+
+// Read-only RowIndex over the rows of a mapped checkpoint. A Seek searches
+// the block keys, which sit together in a few pages, and then the rows of
+// one block. An IndexPos points straight at a row.
+template<class Compare>
+class MappedIndex: public RowIndex {
+public:
+	MappedIndex(const Compare &cmp, const Checkpoint *ck) :
+			cmp_(cmp), rows_(ck->Rows()), n_(ck->NumRows()),
+			row_size_(ck->RowSize()), keys_(ck->BlockKeys()),
+			block_rows_(ck->BlockRows()), nblocks_(ck->NumBlocks()) {
+	}
+
+	virtual bool Insert(char *row, bool replace, char **old) {
+		assert(0);
+		return false;
+	}
+	virtual void BulkLoad(char **rows, size_t n, bool replace,
+			std::vector<char *> *displaced) {
+		assert(0);
+	}
+	virtual char *Find(const char *probe) {
+		IndexPos p;
+		Seek(&p, probe);
+		char *r = (char *) p.node;
+		if (r == NULL || Less(cmp_.Prefix(probe), probe, cmp_.Prefix(r), r))
+			return NULL;
+		return r;
+	}
+	virtual bool Remove(const char *probe, char **old) {
+		assert(0);
+		return false;
+	}
+	// Stops showing the rows, the mapping stays
+	virtual void Clear() {
+		n_ = 0;
+		nblocks_ = 0;
+	}
+	virtual size_t Size() {
+		return n_;
+	}
+	// Rows and block keys live in the mapped file, not on the heap
+	virtual size_t MemoryUsage() {
+		return sizeof(*this);
+	}
+	virtual uint64_t KeyPrefix(const char *row) {
+		return cmp_.Prefix(row);
+	}
+
+	virtual void SeekToFirst(IndexPos *p) {
+		p->node = n_ ? Row(0) : NULL;
+	}
+	virtual void SeekToLast(IndexPos *p) {
+		p->node = n_ ? Row(n_ - 1) : NULL;
+	}
+	virtual void Seek(IndexPos *p, const char *probe);
+	virtual void Next(IndexPos *p) {
+		char *r = (char *) p->node + row_size_;
+		p->node = r < Row(n_) ? r : NULL;
+	}
+	virtual void Prev(IndexPos *p) {
+		char *r = (char *) p->node;
+		p->node = r > Row(0) ? r - row_size_ : NULL;
+	}
+	virtual char *RowAt(const IndexPos &p) {
+		return (char *) p.node;
+	}
+
+private:
+	char *Row(size_t i) const {
+		return (char *) rows_ + i * row_size_;
+	}
+
+	bool Less(uint64_t k1, const char *r1, uint64_t k2, const char *r2) const {
+		if (k1 != k2)
+			return k1 < k2;
+		if (cmp_.PrefixIsKey())
+			return false;
+		return cmp_.Less(r1, r2);
+	}
+
+	Compare cmp_;
+	const char *rows_;
+	size_t n_;
+	size_t row_size_;
+	const uint64_t *keys_;
+	size_t block_rows_;
+	size_t nblocks_;
+};
+
+template<class Compare>
+void MappedIndex<Compare>::Seek(IndexPos *p, const char *probe) {
+	uint64_t k = cmp_.Prefix(probe);
+	//first block whose first row is not less than the probe
+	size_t lo = 0, hi = nblocks_;
+	while (lo < hi) {
+		size_t mid = (lo + hi) / 2;
+		if (Less(keys_[mid], Row(mid * block_rows_), k, probe))
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo == 0) {
+		SeekToFirst(p);
+		return;
+	}
+	//the answer is in the block before, or starts block lo
+	size_t first = (lo - 1) * block_rows_;
+	size_t end = first + block_rows_ < n_ ? first + block_rows_ : n_;
+	while (first < end) {
+		size_t mid = (first + end) / 2;
+		char *r = Row(mid);
+		if (Less(cmp_.Prefix(r), r, k, probe))
+			first = mid + 1;
+		else
+			end = mid;
+	}
+	p->node = first < n_ ? Row(first) : NULL;
+}
+
+} //namespace memdb
+
+#endif
@@ -0,0 +1,311 @@
+/*
+ * columnar.cc
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: jinyang
+ */
+
+#include <assert.h>
+#include <limits.h>
+#include <string.h>
+#include "db/columnar.h"
+#include "db/rowformat.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MEMDB_X86_KERNELS 1
+#endif
+
+namespace memdb {
+
+/*-----------------scan kernels---------------*/
+//Every kernel handles rows [0, n) and has the same result at each level;
+//the vector ones leave the tail that does not fill a register to the
+//scalar one, starting at row start.
+
+static void FilterScalar(const int *v, size_t start, size_t n, int lo, int hi,
+		std::vector<uint32_t> *rows) {
+	for (size_t i = start; i < n; i++) {
+		if (v[i] >= lo && v[i] <= hi)
+			rows->push_back(i);
+	}
+}
+
+static void AggregateScalar(const int *agg, const int *f, size_t start,
+		size_t n, int lo, int hi, ColumnStats *s) {
+	for (size_t i = start; i < n; i++) {
+		if (f[i] < lo || f[i] > hi)
+			continue;
+		s->count++;
+		s->sum += agg[i];
+		if (agg[i] < s->min)
+			s->min = agg[i];
+		if (agg[i] > s->max)
+			s->max = agg[i];
+	}
+}
+
+#ifdef MEMDB_X86_KERNELS
+
+//x lies in [lo, hi] iff max(x, lo) == x and min(x, hi) == x, which cannot
+//overflow the way lo - 1 < x < hi + 1 would
+
+__attribute__((target("sse4.1")))
+static void FilterSse41(const int *v, size_t n, int lo, int hi,
+		std::vector<uint32_t> *rows) {
+	__m128i vlo = _mm_set1_epi32(lo), vhi = _mm_set1_epi32(hi);
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m128i x = _mm_loadu_si128((const __m128i *) (v + i));
+		__m128i in = _mm_and_si128(_mm_cmpeq_epi32(_mm_max_epi32(x, vlo), x),
+				_mm_cmpeq_epi32(_mm_min_epi32(x, vhi), x));
+		unsigned mask = _mm_movemask_ps(_mm_castsi128_ps(in));
+		while (mask) {
+			rows->push_back(i + __builtin_ctz(mask));
+			mask &= mask - 1;
+		}
+	}
+	FilterScalar(v, i, n, lo, hi, rows);
+}
+
+__attribute__((target("sse4.1")))
+static void AggregateSse41(const int *agg, const int *f, size_t n, int lo,
+		int hi, ColumnStats *s) {
+	__m128i vlo = _mm_set1_epi32(lo), vhi = _mm_set1_epi32(hi);
+	__m128i vmin = _mm_set1_epi32(INT_MAX), vmax = _mm_set1_epi32(INT_MIN);
+	__m128i sum = _mm_setzero_si128();
+	size_t count = 0, i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m128i x = _mm_loadu_si128((const __m128i *) (f + i));
+		__m128i in = _mm_and_si128(_mm_cmpeq_epi32(_mm_max_epi32(x, vlo), x),
+				_mm_cmpeq_epi32(_mm_min_epi32(x, vhi), x));
+		__m128i a = _mm_loadu_si128((const __m128i *) (agg + i));
+		count += __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(in)));
+		vmin = _mm_min_epi32(vmin, _mm_blendv_epi8(vmin, a, in));
+		vmax = _mm_max_epi32(vmax, _mm_blendv_epi8(vmax, a, in));
+		__m128i m = _mm_and_si128(a, in);
+		sum = _mm_add_epi64(sum, _mm_cvtepi32_epi64(m));
+		sum = _mm_add_epi64(sum, _mm_cvtepi32_epi64(_mm_srli_si128(m, 8)));
+	}
+	int64_t sums[2];
+	int mins[4], maxs[4];
+	_mm_storeu_si128((__m128i *) sums, sum);
+	_mm_storeu_si128((__m128i *) mins, vmin);
+	_mm_storeu_si128((__m128i *) maxs, vmax);
+	s->count += count;
+	s->sum += sums[0] + sums[1];
+	for (int j = 0; j < 4; j++) {
+		if (mins[j] < s->min)
+			s->min = mins[j];
+		if (maxs[j] > s->max)
+			s->max = maxs[j];
+	}
+	AggregateScalar(agg, f, i, n, lo, hi, s);
+}
+
+__attribute__((target("avx2")))
+static void FilterAvx2(const int *v, size_t n, int lo, int hi,
+		std::vector<uint32_t> *rows) {
+	__m256i vlo = _mm256_set1_epi32(lo), vhi = _mm256_set1_epi32(hi);
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m256i x = _mm256_loadu_si256((const __m256i *) (v + i));
+		__m256i in = _mm256_and_si256(
+				_mm256_cmpeq_epi32(_mm256_max_epi32(x, vlo), x),
+				_mm256_cmpeq_epi32(_mm256_min_epi32(x, vhi), x));
+		unsigned mask = _mm256_movemask_ps(_mm256_castsi256_ps(in));
+		while (mask) {
+			rows->push_back(i + __builtin_ctz(mask));
+			mask &= mask - 1;
+		}
+	}
+	FilterScalar(v, i, n, lo, hi, rows);
+}
+
+__attribute__((target("avx2")))
+static void AggregateAvx2(const int *agg, const int *f, size_t n, int lo,
+		int hi, ColumnStats *s) {
+	__m256i vlo = _mm256_set1_epi32(lo), vhi = _mm256_set1_epi32(hi);
+	__m256i vmin = _mm256_set1_epi32(INT_MAX);
+	__m256i vmax = _mm256_set1_epi32(INT_MIN);
+	__m256i sum = _mm256_setzero_si256();
+	size_t count = 0, i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m256i x = _mm256_loadu_si256((const __m256i *) (f + i));
+		__m256i in = _mm256_and_si256(
+				_mm256_cmpeq_epi32(_mm256_max_epi32(x, vlo), x),
+				_mm256_cmpeq_epi32(_mm256_min_epi32(x, vhi), x));
+		__m256i a = _mm256_loadu_si256((const __m256i *) (agg + i));
+		count += __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(in)));
+		vmin = _mm256_min_epi32(vmin, _mm256_blendv_epi8(vmin, a, in));
+		vmax = _mm256_max_epi32(vmax, _mm256_blendv_epi8(vmax, a, in));
+		__m256i m = _mm256_and_si256(a, in);
+		sum = _mm256_add_epi64(sum,
+				_mm256_cvtepi32_epi64(_mm256_castsi256_si128(m)));
+		sum = _mm256_add_epi64(sum,
+				_mm256_cvtepi32_epi64(_mm256_extracti128_si256(m, 1)));
+	}
+	int64_t sums[4];
+	int mins[8], maxs[8];
+	_mm256_storeu_si256((__m256i *) sums, sum);
+	_mm256_storeu_si256((__m256i *) mins, vmin);
+	_mm256_storeu_si256((__m256i *) maxs, vmax);
+	s->count += count;
+	s->sum += sums[0] + sums[1] + sums[2] + sums[3];
+	for (int j = 0; j < 8; j++) {
+		if (mins[j] < s->min)
+			s->min = mins[j];
+		if (maxs[j] > s->max)
+			s->max = maxs[j];
+	}
+	AggregateScalar(agg, f, i, n, lo, hi, s);
+}
+
+#endif
+
+SimdLevel ColumnarTable::SupportedSimdLevel() {
+#ifdef MEMDB_X86_KERNELS
+	if (__builtin_cpu_supports("avx2"))
+		return kSimdAvx2;
+	if (__builtin_cpu_supports("sse4.1"))
+		return kSimdSse41;
+#endif
+	return kSimdScalar;
+}
+
+/*-----------------ColumnarTable---------------*/
+ColumnarTable::ColumnarTable(TableSchema *schema) :
+		schema_(schema), nrows_(0), ints_(schema->NumColumns()),
+		fixed_(schema->NumColumns()), strs_(schema->NumColumns()), heaps_(schema->NumColumns()),
+		simd_(SupportedSimdLevel()) {
+}
+
+SimdLevel ColumnarTable::SetSimdLevel(SimdLevel level) {
+	SimdLevel best = SupportedSimdLevel();
+	simd_ = level < best ? level : best;
+	return simd_;
+}
+
+void ColumnarTable::Clear() {
+	for (int c = 0; c < schema_->NumColumns(); c++) {
+		ints_[c].clear();
+		fixed_[c].clear();
+		strs_[c].clear();
+		heaps_[c].clear();
+	}
+	nrows_ = 0;
+}
+
+void ColumnarTable::Append(const char *row) {
+	for (int c = 0; c < schema_->NumColumns(); c++) {
+		const char *col = row + schema_->GetColumnPos(c);
+		column_t t = schema_->GetColumnType(c);
+		if (t == cInt32) {
+			ints_[c].push_back(*(const int *) col);
+		} else if (t != cString) {
+			fixed_[c].insert(fixed_[c].end(), col,
+					col + schema_->GetColumnSize(c));
+		} else {
+			std::string &heap = heaps_[c];
+			assert(heap.size() + StrColumn::Length(col) < UINT32_MAX);
+			strs_[c].push_back(heap.size());
+			heap.append(StrColumn::Data(col), StrColumn::Length(col));
+			heap.push_back('\0');
+		}
+	}
+	nrows_++;
+}
+
+void ColumnarTable::Load(MemTable *table) {
+	assert(table->GetSchema() == schema_);
+	Clear();
+	for (int c = 0; c < schema_->NumColumns(); c++) {
+		column_t t = schema_->GetColumnType(c);
+		if (t == cInt32)
+			ints_[c].reserve(table->Size());
+		else if (t != cString)
+			fixed_[c].reserve(table->Size() * schema_->GetColumnSize(c));
+		else
+			strs_[c].reserve(table->Size());
+	}
+	MemTable::Iterator it(table);
+	RdOnlyRow r(table);
+	for (it.SeekToFirst(); it.Valid(); it.Next())
+		Append(it.RowAt(r).Buffer());
+}
+
+size_t ColumnarTable::Filter(int col, int lo, int hi,
+		std::vector<uint32_t> *rows) {
+	assert(schema_->GetColumnType(col) == cInt32);
+	size_t before = rows->size();
+	const int *v = ints_[col].data();
+	switch (simd_) {
+#ifdef MEMDB_X86_KERNELS
+	case kSimdAvx2:
+		FilterAvx2(v, nrows_, lo, hi, rows);
+		break;
+	case kSimdSse41:
+		FilterSse41(v, nrows_, lo, hi, rows);
+		break;
+#endif
+	default:
+		FilterScalar(v, 0, nrows_, lo, hi, rows);
+	}
+	return rows->size() - before;
+}
+
+ColumnStats ColumnarTable::Aggregate(int agg, int filter, int lo, int hi) {
+	assert(schema_->GetColumnType(agg) == cInt32);
+	assert(schema_->GetColumnType(filter) == cInt32);
+	ColumnStats s;
+	s.count = 0;
+	s.sum = 0;
+	s.min = INT_MAX;
+	s.max = INT_MIN;
+	const int *a = ints_[agg].data(), *f = ints_[filter].data();
+	switch (simd_) {
+#ifdef MEMDB_X86_KERNELS
+	case kSimdAvx2:
+		AggregateAvx2(a, f, nrows_, lo, hi, &s);
+		break;
+	case kSimdSse41:
+		AggregateSse41(a, f, nrows_, lo, hi, &s);
+		break;
+#endif
+	default:
+		AggregateScalar(a, f, 0, nrows_, lo, hi, &s);
+	}
+	return s;
+}
+
+/*-----------------ColumnarTable::Iterator---------------*/
+ColumnarTable::Iterator::Iterator(ColumnarTable *table) :
+		table_(table), pos_(0), buf_(table->schema_->RowSize()) {
+}
+
+RdOnlyRow &ColumnarTable::Iterator::RowAt(RdOnlyRow &r) {
+	TableSchema *s = table_->schema_;
+	char *row = buf_.data();
+	for (int c = 0; c < s->NumColumns(); c++) {
+		char *col = row + s->GetColumnPos(c);
+		column_t t = s->GetColumnType(c);
+		if (t == cInt32) {
+			*(int *) col = table_->ints_[c][pos_];
+		} else if (t != cString) {
+			int width = s->GetColumnSize(c);
+			memcpy(col, table_->fixed_[c].data() + pos_ * width, width);
+		} else {
+			const std::vector<uint32_t> &offs = table_->strs_[c];
+			const std::string &heap = table_->heaps_[c];
+			uint32_t start = offs[pos_];
+			uint32_t end = pos_ + 1 < table_->nrows_ ?
+					offs[pos_ + 1] : (uint32_t) heap.size();
+			//the next string starts after this one's NUL
+			StrColumn::SetView(col, heap.data() + start, end - start - 1);
+		}
+	}
+	r.ReplaceRowBuffer(row);
+	return r;
+}
+
+} //namespace memdb
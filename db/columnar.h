@@ -0,0 +1,129 @@
+/*
+ * columnar.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: jinyang
+ */
+
+#ifndef MEMDB_DB_COLUMNAR_H_
+#define MEMDB_DB_COLUMNAR_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "db/memtable.h"
+
+namespace memdb {
+
+// Instruction sets the scan kernels can use, best last
+enum SimdLevel {
+	kSimdScalar = 0, kSimdSse41 = 1, kSimdAvx2 = 2
+};
+
+// Result of ColumnarTable::Aggregate; min and max are meaningless when
+// count is 0
+struct ColumnStats {
+	size_t count;
+	int64_t sum;
+	int min;
+	int max;
+};
+
+// Read-optimized copy of a table stored column by column: each int column
+// is one contiguous array, each other fixed width column one packed array
+// of its values and each string column an array of offsets into its own
+// heap of NUL terminated strings. A scan that filters and
+// aggregates a couple of int columns streams through just those arrays,
+// several values per instruction.
+//
+// Rows keep the order they were loaded in, index order for Load(). The
+// table is not updated in place: reload it to pick up changes.
+class ColumnarTable {
+public:
+	explicit ColumnarTable(TableSchema *schema);
+
+	// Replaces the contents with the rows of table, in index order.
+	// REQUIRES: no writer runs on table meanwhile
+	void Load(MemTable *table);
+	void Append(const char *row);
+	void Clear();
+
+	size_t NumRows() {
+		return nrows_;
+	}
+	TableSchema *GetSchema() {
+		return schema_;
+	}
+
+	// Direct access to int column c
+	const int *IntColumn(int c) {
+		return ints_[c].data();
+	}
+	// Direct access to fixed width column c other than an int, as
+	// GetColumnSize(c) bytes per row
+	const char *FixedColumn(int c) {
+		return fixed_[c].data();
+	}
+
+	// Appends the numbers of the rows whose int column col lies in
+	// [lo, hi] to *rows, in order. Returns how many matched.
+	size_t Filter(int col, int lo, int hi, std::vector<uint32_t> *rows);
+	// count, sum, min and max of int column agg over the rows whose int
+	// column filter lies in [lo, hi], in one pass over both columns
+	ColumnStats Aggregate(int agg, int filter, int lo, int hi);
+
+	// The kernels use the best instruction set the CPU has; this caps it,
+	// for comparisons. Returns the level in effect.
+	SimdLevel SetSimdLevel(SimdLevel level);
+	static SimdLevel SupportedSimdLevel();
+
+	// Rebuilds rows in the usual buffer layout for RdOnlyRow consumers.
+	// Strings are not copied, a row stays readable while the table is
+	// neither reloaded nor destroyed, and until the iterator moves.
+	class Iterator {
+	public:
+		explicit Iterator(ColumnarTable *table);
+
+		bool Valid() {
+			return pos_ < table_->nrows_;
+		}
+		void SeekToFirst() {
+			pos_ = 0;
+		}
+		// Position at row number i
+		void Seek(size_t i) {
+			pos_ = i;
+		}
+		void Next() {
+			pos_++;
+		}
+		size_t Position() {
+			return pos_;
+		}
+		// REQUIRES: Valid()
+		RdOnlyRow &RowAt(RdOnlyRow &r);
+
+	private:
+		ColumnarTable *table_;
+		size_t pos_;
+		std::vector<char> buf_;
+	};
+
+private:
+	TableSchema *schema_;
+	size_t nrows_;
+	// indexed by column number, empty for columns of the other types
+	std::vector<std::vector<int> > ints_;
+	std::vector<std::vector<char> > fixed_;
+	std::vector<std::vector<uint32_t> > strs_; //offsets into heaps_
+	std::vector<std::string> heaps_;
+	SimdLevel simd_;
+
+	//no copying allowed
+	ColumnarTable(const ColumnarTable &);
+	void operator=(const ColumnarTable &);
+};
+
+} //namespace memdb
+
+#endif
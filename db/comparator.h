@@ -0,0 +1,456 @@
+/*
+ * comparator.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: jinyang
+ */
+
+#ifndef MEMDB_DB_COMPARATOR_H_
+#define MEMDB_DB_COMPARATOR_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include "db/tableschema.h"
+#include "db/rowformat.h"
+#include "util/hash.h"
+
+namespace memdb {
+
+// Per-type operations on one key column, given a pointer to the column
+// inside a row buffer.
+template<column_t T> struct KeyColumn;
+
+template<> struct KeyColumn<cInt32> {
+	static int Compare(const char *a, const char *b) {
+		int x = *(const int *) a;
+		int y = *(const int *) b;
+		return (x > y) - (x < y);
+	}
+	//flipping the sign bit makes int32 order match unsigned order,
+	//an int is always a 4 byte prefix
+	static uint64_t Prefix(const char *p, int nbytes) {
+		return (uint32_t) (*(const int *) p) ^ 0x80000000u;
+	}
+	static uint32_t Hash(const char *p, uint32_t seed) {
+		return memdb::Hash(p, sizeof(int), seed);
+	}
+};
+
+//Also for cTimestamp, which is stored the same way
+template<> struct KeyColumn<cInt64> {
+	static int Compare(const char *a, const char *b) {
+		int64_t x = *(const int64_t *) a;
+		int64_t y = *(const int64_t *) b;
+		return (x > y) - (x < y);
+	}
+	static uint64_t Prefix(const char *p, int nbytes) {
+		uint64_t k = (uint64_t) (*(const int64_t *) p) ^ (1ULL << 63);
+		return nbytes >= 8 ? k : k >> (8 * (8 - nbytes));
+	}
+	static uint32_t Hash(const char *p, uint32_t seed) {
+		return memdb::Hash(p, sizeof(int64_t), seed);
+	}
+};
+
+//Doubles are ordered by their bits made order preserving: negative
+//numbers flipped whole, positive ones with the sign bit set. That is the
+//numeric order, except that -0.0 sorts before 0.0 and NaNs at the ends.
+template<> struct KeyColumn<cDouble> {
+	static uint64_t Bits(const char *p) {
+		uint64_t b;
+		memcpy(&b, p, sizeof(b));
+		return (b >> 63) ? ~b : b | (1ULL << 63);
+	}
+	static int Compare(const char *a, const char *b) {
+		uint64_t x = Bits(a), y = Bits(b);
+		return (x > y) - (x < y);
+	}
+	static uint64_t Prefix(const char *p, int nbytes) {
+		return nbytes >= 8 ? Bits(p) : Bits(p) >> (8 * (8 - nbytes));
+	}
+	static uint32_t Hash(const char *p, uint32_t seed) {
+		return memdb::Hash(p, sizeof(double), seed);
+	}
+};
+
+template<> struct KeyColumn<cString> {
+	static int Compare(const char *a, const char *b) {
+		return StrColumn::Compare(a, b);
+	}
+	static uint64_t Prefix(const char *p, int nbytes) {
+		return StrColumn::Prefix(p, nbytes);
+	}
+	static uint32_t Hash(const char *p, uint32_t seed) {
+		return memdb::Hash(StrColumn::Data(p), StrColumn::Length(p), seed);
+	}
+};
+
+// The same operations dispatched on the column type at run time, for
+// every type; binary columns need their width
+struct ColumnOps {
+	static int Compare(column_t t, int width, const char *a, const char *b) {
+		switch (t) {
+		case cInt32:
+			return KeyColumn<cInt32>::Compare(a, b);
+		case cString:
+			return KeyColumn<cString>::Compare(a, b);
+		case cDouble:
+			return KeyColumn<cDouble>::Compare(a, b);
+		case cBinary:
+			return memcmp(a, b, width);
+		default:
+			return KeyColumn<cInt64>::Compare(a, b);
+		}
+	}
+	static uint64_t Prefix(column_t t, int width, const char *p, int nbytes) {
+		switch (t) {
+		case cInt32:
+			return KeyColumn<cInt32>::Prefix(p, nbytes);
+		case cString:
+			return KeyColumn<cString>::Prefix(p, nbytes);
+		case cDouble:
+			return KeyColumn<cDouble>::Prefix(p, nbytes);
+		case cBinary: {
+			uint64_t k = 0;
+			for (int i = 0; i < nbytes; i++)
+				k = (k << 8) | (i < width ? (unsigned char) p[i] : 0);
+			return k;
+		}
+		default:
+			return KeyColumn<cInt64>::Prefix(p, nbytes);
+		}
+	}
+	static uint32_t Hash(column_t t, int width, const char *p, uint32_t seed) {
+		if (t == cString)
+			return KeyColumn<cString>::Hash(p, seed);
+		return memdb::Hash(p, t == cInt32 ? 4 : t == cBinary ? width : 8, seed);
+	}
+	// Bytes of order preserving prefix a column provides: an int32 leaves
+	// room for 4 bytes of the next key column
+	static int PrefixBytes(column_t t) {
+		return t == cInt32 ? 4 : 8;
+	}
+};
+
+// Memcomparable encoding of a composite key (TableSchema::SetKey): the key
+// columns are encoded one after the other so that comparing two encoded
+// keys byte by byte, a key before any key it is a prefix of, orders them
+// column by column.
+//   int32, int64, timestamp, double: the order preserving bits of
+//       KeyColumn<T>::Prefix, big endian
+//   binary: its bytes
+//   string: its bytes with every 0x00 escaped as 0x00 0xff, then 0x00 0x01
+// The string terminator keeps one encoded column from being a prefix of
+// another. A descending column has every byte of its encoding inverted.
+// The encoding goes to any Dst with push_back(char): a std::string, or a
+// KeyWriter.
+struct KeyCoding {
+	template<class Dst>
+	static void AppendBigEndian(uint64_t v, int nbytes, bool desc,
+			Dst *dst) {
+		for (int i = nbytes - 1; i >= 0; i--) {
+			unsigned char b = v >> (8 * i);
+			dst->push_back(desc ? ~b : b);
+		}
+	}
+	template<class Dst>
+	static void AppendInt32(int x, bool desc, Dst *dst) {
+		AppendBigEndian(KeyColumn<cInt32>::Prefix((const char *) &x, 4), 4,
+				desc, dst);
+	}
+	template<class Dst>
+	static void AppendInt64(int64_t x, bool desc, Dst *dst) {
+		AppendBigEndian(KeyColumn<cInt64>::Prefix((const char *) &x, 8), 8,
+				desc, dst);
+	}
+	template<class Dst>
+	static void AppendDouble(double x, bool desc, Dst *dst) {
+		AppendBigEndian(KeyColumn<cDouble>::Bits((const char *) &x), 8, desc,
+				dst);
+	}
+	// n bytes, zero padded to width
+	template<class Dst>
+	static void AppendBinary(const char *p, size_t n, int width, bool desc,
+			Dst *dst) {
+		for (int i = 0; i < width; i++) {
+			unsigned char b = (size_t) i < n ? p[i] : 0;
+			dst->push_back(desc ? ~b : b);
+		}
+	}
+	template<class Dst>
+	static void AppendString(const char *p, size_t n, bool desc,
+			Dst *dst) {
+		unsigned char flip = desc ? 0xff : 0;
+		for (size_t i = 0; i < n; i++) {
+			dst->push_back(p[i] ^ flip);
+			if (p[i] == 0)
+				dst->push_back(0xff ^ flip);
+		}
+		dst->push_back(flip);
+		dst->push_back(0x01 ^ flip);
+	}
+	// Bytes AppendColumn appends for the column at col
+	static size_t ColumnSize(column_t t, int width, const char *col) {
+		switch (t) {
+		case cInt32:
+			return 4;
+		case cString: {
+			const char *p = StrColumn::Data(col);
+			uint32_t n = StrColumn::Length(col);
+			size_t size = n + 2;
+			for (uint32_t i = 0; i < n; i++)
+				size += p[i] == 0;
+			return size;
+		}
+		case cBinary:
+			return width;
+		default:
+			return 8;
+		}
+	}
+	// Appends the encoding of the column at col in a row buffer
+	template<class Dst>
+	static void AppendColumn(column_t t, int width, const char *col,
+			bool desc, Dst *dst) {
+		switch (t) {
+		case cInt32:
+			AppendInt32(*(const int *) col, desc, dst);
+			break;
+		case cString:
+			AppendString(StrColumn::Data(col), StrColumn::Length(col), desc,
+					dst);
+			break;
+		case cDouble:
+			AppendDouble(*(const double *) col, desc, dst);
+			break;
+		case cBinary:
+			AppendBinary(col, width, width, desc, dst);
+			break;
+		default:
+			AppendInt64(*(const int64_t *) col, desc, dst);
+		}
+	}
+};
+
+// A KeyCoding destination that writes to memory sized beforehand with
+// KeyCoding::ColumnSize, where a std::string would allocate
+struct KeyWriter {
+	explicit KeyWriter(char *dst) :
+			p(dst) {
+	}
+	void push_back(char c) {
+		*p++ = c;
+	}
+	char *p;
+};
+
+// Orders rows of a schema with a composite key by the encoded key column
+// alone: one byte string compare per comparison, with no column types
+// involved. The prefix is the first 8 bytes of the key.
+class EncodedKeyCompare {
+public:
+	explicit EncodedKeyCompare(int key_pos) :
+			pos_(key_pos) {
+	}
+
+	uint64_t Prefix(const char *r) const {
+		return StrColumn::Prefix(r + pos_, 8);
+	}
+
+	bool PrefixIsKey() const {
+		return false;
+	}
+
+	bool Less(const char *r1, const char *r2) const {
+		return StrColumn::Compare(r1 + pos_, r2 + pos_) < 0;
+	}
+
+	uint32_t Hash(const char *r) const {
+		return KeyColumn<cString>::Hash(r + pos_, 0);
+	}
+
+	bool Equal(const char *r1, const char *r2) const {
+		return StrColumn::Compare(r1 + pos_, r2 + pos_) == 0;
+	}
+
+private:
+	int pos_;
+};
+
+// Orders rows by (index column, primary column) with both column types
+// fixed at compile time and the column offsets cached, so the B+-tree can
+// inline the whole comparison. The 64-bit prefix is the index key followed
+// by as much of the primary key as fits; for RowCompareT<cInt32, cInt32>
+// that is the complete key and rows are never dereferenced.
+template<column_t I, column_t P>
+class RowCompareT {
+public:
+	RowCompareT(int index_pos, int primary_pos) :
+			ipos_(index_pos), ppos_(primary_pos) {
+	}
+
+	uint64_t Prefix(const char *r) const {
+		if (I != cInt32)
+			return KeyColumn<I>::Prefix(r + ipos_, 8);
+		return (KeyColumn<I>::Prefix(r + ipos_, 4) << 32)
+				| KeyColumn<P>::Prefix(r + ppos_, 4);
+	}
+
+	bool PrefixIsKey() const {
+		return I == cInt32 && P == cInt32;
+	}
+
+	bool Less(const char *r1, const char *r2) const {
+		int c = KeyColumn<I>::Compare(r1 + ipos_, r2 + ipos_);
+		if (c != 0)
+			return c < 0;
+		return KeyColumn<P>::Compare(r1 + ppos_, r2 + ppos_) < 0;
+	}
+
+	// For HashIndex, over the same key
+	uint32_t Hash(const char *r) const {
+		return KeyColumn<P>::Hash(r + ppos_, KeyColumn<I>::Hash(r + ipos_, 0));
+	}
+
+	bool Equal(const char *r1, const char *r2) const {
+		return KeyColumn<I>::Compare(r1 + ipos_, r2 + ipos_) == 0
+				&& KeyColumn<P>::Compare(r1 + ppos_, r2 + ppos_) == 0;
+	}
+
+private:
+	int ipos_;
+	int ppos_;
+};
+
+// Orders rows for a secondary index on column S by (S, primary column,
+// main index column); the last one makes the key unique whenever the
+// table's (index, primary) key is. The prefix is laid out as for
+// RowCompareT<S, P>.
+template<column_t S, column_t P, column_t I>
+class SecondaryCompareT {
+public:
+	SecondaryCompareT(int column_pos, int primary_pos, int index_pos) :
+			spos_(column_pos), ppos_(primary_pos), ipos_(index_pos) {
+	}
+
+	uint64_t Prefix(const char *r) const {
+		if (S != cInt32)
+			return KeyColumn<S>::Prefix(r + spos_, 8);
+		return (KeyColumn<S>::Prefix(r + spos_, 4) << 32)
+				| KeyColumn<P>::Prefix(r + ppos_, 4);
+	}
+
+	bool PrefixIsKey() const {
+		return false;
+	}
+
+	bool Less(const char *r1, const char *r2) const {
+		int c = KeyColumn<S>::Compare(r1 + spos_, r2 + spos_);
+		if (c != 0)
+			return c < 0;
+		c = KeyColumn<P>::Compare(r1 + ppos_, r2 + ppos_);
+		if (c != 0)
+			return c < 0;
+		return KeyColumn<I>::Compare(r1 + ipos_, r2 + ipos_) < 0;
+	}
+
+private:
+	int spos_;
+	int ppos_;
+	int ipos_;
+};
+
+// One key column of a schema, for the generic comparators
+struct KeyColumnAny {
+	KeyColumnAny(TableSchema *s, int c) :
+			type(s->GetColumnType(c)), pos(s->GetColumnPos(c)),
+			width(s->GetColumnSize(c)) {
+	}
+	int Compare(const char *r1, const char *r2) const {
+		return ColumnOps::Compare(type, width, r1 + pos, r2 + pos);
+	}
+	uint64_t Prefix(const char *r, int nbytes) const {
+		return ColumnOps::Prefix(type, width, r + pos, nbytes);
+	}
+	column_t type;
+	int pos;
+	int width;
+};
+
+// RowCompareT for key types it is not specialized for (doubles and binary
+// columns), which pays a switch on the column type per comparison
+class RowCompareAny {
+public:
+	explicit RowCompareAny(TableSchema *s) :
+			i_(s, s->GetIndexNumber()), p_(s, s->GetPrimaryNumber()) {
+	}
+
+	uint64_t Prefix(const char *r) const {
+		if (ColumnOps::PrefixBytes(i_.type) == 8)
+			return i_.Prefix(r, 8);
+		return (i_.Prefix(r, 4) << 32) | p_.Prefix(r, 4);
+	}
+
+	bool PrefixIsKey() const {
+		return false;
+	}
+
+	bool Less(const char *r1, const char *r2) const {
+		int c = i_.Compare(r1, r2);
+		if (c != 0)
+			return c < 0;
+		return p_.Compare(r1, r2) < 0;
+	}
+
+	uint32_t Hash(const char *r) const {
+		return ColumnOps::Hash(p_.type, p_.width, r + p_.pos,
+				ColumnOps::Hash(i_.type, i_.width, r + i_.pos, 0));
+	}
+
+	bool Equal(const char *r1, const char *r2) const {
+		return i_.Compare(r1, r2) == 0 && p_.Compare(r1, r2) == 0;
+	}
+
+private:
+	KeyColumnAny i_;
+	KeyColumnAny p_;
+};
+
+// SecondaryCompareT for the same key types as RowCompareAny
+class SecondaryCompareAny {
+public:
+	SecondaryCompareAny(TableSchema *s, int index) :
+			s_(s, s->GetIndexNumber(index)), p_(s, s->GetPrimaryNumber()),
+			i_(s, s->GetIndexNumber()) {
+	}
+
+	uint64_t Prefix(const char *r) const {
+		if (ColumnOps::PrefixBytes(s_.type) == 8)
+			return s_.Prefix(r, 8);
+		return (s_.Prefix(r, 4) << 32) | p_.Prefix(r, 4);
+	}
+
+	bool PrefixIsKey() const {
+		return false;
+	}
+
+	bool Less(const char *r1, const char *r2) const {
+		int c = s_.Compare(r1, r2);
+		if (c != 0)
+			return c < 0;
+		c = p_.Compare(r1, r2);
+		if (c != 0)
+			return c < 0;
+		return i_.Compare(r1, r2) < 0;
+	}
+
+private:
+	KeyColumnAny s_;
+	KeyColumnAny p_;
+	KeyColumnAny i_;
+};
+
+} //namespace memdb
+
+#endif
@@ -0,0 +1,71 @@
+/*
+ * dictionary.cc
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: jinyang
+ */
+
+#include "db/dictionary.h"
+
+#include <string.h>
+#include "util/hash.h"
+
+namespace memdb {
+
+StringDict::StringDict() :
+		heap_(0), slots_(64), size_(0) {
+	memset(slots_.data(), 0, slots_.size() * sizeof(Entry));
+}
+
+StringDict::~StringDict() {
+}
+
+//Linear probing, kept at most half full
+const char *StringDict::Intern(const Slice &s) {
+	uint32_t h = Hash(s.data(), s.size(), 0);
+	std::lock_guard<std::mutex> l(mu_);
+	size_t mask = slots_.size() - 1;
+	size_t i = h & mask;
+	for (; slots_[i].data != NULL; i = (i + 1) & mask) {
+		const Entry &e = slots_[i];
+		if (e.hash == h && e.len == s.size()
+				&& memcmp(e.data, s.data(), s.size()) == 0)
+			return e.data;
+	}
+	char *d = heap_.Allocate(s.size() + 1);
+	memcpy(d, s.data(), s.size());
+	d[s.size()] = '\0';
+	slots_[i].data = d;
+	slots_[i].len = s.size();
+	slots_[i].hash = h;
+	if (++size_ * 2 > slots_.size())
+		Grow();
+	return d;
+}
+
+void StringDict::Grow() {
+	std::vector<Entry> old(slots_.size() * 2);
+	memset(old.data(), 0, old.size() * sizeof(Entry));
+	old.swap(slots_);
+	size_t mask = slots_.size() - 1;
+	for (size_t j = 0; j < old.size(); j++) {
+		if (old[j].data == NULL)
+			continue;
+		size_t i = old[j].hash & mask;
+		while (slots_[i].data != NULL)
+			i = (i + 1) & mask;
+		slots_[i] = old[j];
+	}
+}
+
+size_t StringDict::Size() {
+	std::lock_guard<std::mutex> l(mu_);
+	return size_;
+}
+
+size_t StringDict::MemoryUsage() {
+	std::lock_guard<std::mutex> l(mu_);
+	return heap_.MemoryReserved() + slots_.size() * sizeof(Entry);
+}
+
+} //namespace memdb
@@ -0,0 +1,60 @@
+/*
+ * dictionary.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: jinyang
+ */
+
+#ifndef MEMDB_DB_DICTIONARY_H_
+#define MEMDB_DB_DICTIONARY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <mutex>
+#include <vector>
+#include "util/arena.h"
+#include "util/slice.h"
+
+namespace memdb {
+
+// The distinct values of a string column with few of them
+// (TableSchema::EnableDictionary): every row holding a value points at the
+// one interned copy, so equal strings also have equal addresses. Values
+// get no integer codes and no order of their own; the rows still hold a
+// StrColumn and compare through it. Interned strings are never freed
+// before the dictionary, which is safe to use from several threads.
+class StringDict {
+public:
+	StringDict();
+	~StringDict();
+
+	// Returns the interned copy of s, NUL terminated, adding it if new
+	const char *Intern(const Slice &s);
+
+	// Number of distinct strings
+	size_t Size();
+	// Bytes of heap the strings and the hash table take
+	size_t MemoryUsage();
+
+private:
+	struct Entry {
+		const char *data; //NULL for an empty slot
+		uint32_t len;
+		uint32_t hash;
+	};
+
+	void Grow();
+
+	std::mutex mu_;
+	Arena heap_; //strings only, no rows
+	std::vector<Entry> slots_; //open addressing, a power of two of them
+	size_t size_;
+
+	//no copying allowed
+	StringDict(const StringDict &);
+	void operator=(const StringDict &);
+};
+
+} //namespace memdb
+
+#endif
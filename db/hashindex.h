@@ -0,0 +1,175 @@
+/*
+ * hashindex.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: jinyang
+ */
+
+#ifndef MEMDB_DB_HASHINDEX_H_
+#define MEMDB_DB_HASHINDEX_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <assert.h>
+
+namespace memdb {
+
+// Unordered map from the full (index, primary) key of a row to its buffer,
+// for point lookups that need no order. Like RowIndex it never owns rows.
+class HashIndex {
+public:
+	virtual ~HashIndex() {
+	}
+
+	// Adds row, or replaces the row with an equal key and returns it
+	// through *old (NULL if there was none)
+	virtual void Insert(char *row, char **old) = 0;
+	// Removes the row whose key equals that of probe, NULL if none
+	virtual char *Remove(const char *probe) = 0;
+	virtual void Clear() = 0;
+	// Bytes the index itself holds, not counting the rows
+	virtual size_t MemoryUsage() = 0;
+
+	virtual uint32_t Hash(const char *probe) = 0;
+	// Starts loading the slot a lookup with hash h reads first
+	virtual void Prefetch(uint32_t h) = 0;
+	// Starts loading the row that lookup will compare against first, best
+	// issued once the slot has arrived
+	virtual void PrefetchRow(uint32_t h) = 0;
+	// The row whose key equals that of probe, NULL if none.
+	// REQUIRES: h == Hash(probe)
+	virtual char *Find(const char *probe, uint32_t h) = 0;
+};
+
+// Open addressing with linear probing, each slot keeps the row's full hash
+// so probing only dereferences rows whose hash matches. Removal shifts the
+// rest of the probe run back instead of leaving tombstones. Compare must
+// provide
+//   uint32_t Hash(const char *row) const;
+//   bool Equal(const char *r1, const char *r2) const;
+template<class Compare>
+class OpenHashIndex: public HashIndex {
+public:
+	explicit OpenHashIndex(const Compare &cmp) :
+			cmp_(cmp), slots_(NULL), mask_(0), size_(0) {
+		Resize(kMinSlots);
+	}
+	virtual ~OpenHashIndex() {
+		free(slots_);
+	}
+
+	virtual void Insert(char *row, char **old);
+	virtual char *Remove(const char *probe);
+	virtual void Clear() {
+		free(slots_);
+		slots_ = NULL;
+		size_ = 0;
+		Resize(kMinSlots);
+	}
+	virtual size_t MemoryUsage() {
+		return sizeof(*this) + (mask_ + 1) * sizeof(Slot);
+	}
+
+	virtual uint32_t Hash(const char *probe) {
+		return cmp_.Hash(probe);
+	}
+	virtual void Prefetch(uint32_t h) {
+		__builtin_prefetch(&slots_[h & mask_]);
+	}
+	virtual void PrefetchRow(uint32_t h) {
+		const Slot &s = slots_[h & mask_];
+		if (s.row && s.hash == h)
+			__builtin_prefetch(s.row);
+	}
+	virtual char *Find(const char *probe, uint32_t h) {
+		for (size_t i = h & mask_; slots_[i].row; i = (i + 1) & mask_) {
+			if (slots_[i].hash == h && cmp_.Equal(slots_[i].row, probe))
+				return slots_[i].row;
+		}
+		return NULL;
+	}
+
+private:
+	enum {
+		kMinSlots = 1024
+	};
+
+	struct Slot {
+		uint32_t hash;
+		char *row; //NULL if empty
+	};
+
+	void Resize(size_t n);
+
+	Compare cmp_;
+	Slot *slots_;
+	size_t mask_; //number of slots - 1, a power of two
+	size_t size_;
+};
+
+template<class Compare>
+void OpenHashIndex<Compare>::Resize(size_t n) {
+	Slot *old = slots_;
+	size_t nold = old ? mask_ + 1 : 0;
+	slots_ = (Slot *) calloc(n, sizeof(Slot));
+	assert(slots_);
+	mask_ = n - 1;
+	for (size_t j = 0; j < nold; j++) {
+		if (old[j].row == NULL)
+			continue;
+		size_t i = old[j].hash & mask_;
+		while (slots_[i].row)
+			i = (i + 1) & mask_;
+		slots_[i] = old[j];
+	}
+	free(old);
+}
+
+template<class Compare>
+void OpenHashIndex<Compare>::Insert(char *row, char **old) {
+	uint32_t h = cmp_.Hash(row);
+	size_t i = h & mask_;
+	for (; slots_[i].row; i = (i + 1) & mask_) {
+		if (slots_[i].hash == h && cmp_.Equal(slots_[i].row, row)) {
+			*old = slots_[i].row;
+			slots_[i].row = row;
+			return;
+		}
+	}
+	*old = NULL;
+	slots_[i].hash = h;
+	slots_[i].row = row;
+	//keep the load factor under 3/4 so probe runs stay short
+	if (++size_ * 4 > (mask_ + 1) * 3)
+		Resize((mask_ + 1) * 2);
+}
+
+template<class Compare>
+char *OpenHashIndex<Compare>::Remove(const char *probe) {
+	uint32_t h = cmp_.Hash(probe);
+	size_t i = h & mask_;
+	for (; slots_[i].row; i = (i + 1) & mask_) {
+		if (slots_[i].hash == h && cmp_.Equal(slots_[i].row, probe))
+			break;
+	}
+	char *row = slots_[i].row;
+	if (row == NULL)
+		return NULL;
+	//move back every later entry of the run that may sit at or before the
+	//hole, so lookups never stop early at it
+	size_t hole = i;
+	for (size_t j = (i + 1) & mask_; slots_[j].row; j = (j + 1) & mask_) {
+		size_t home = slots_[j].hash & mask_;
+		if (((j - home) & mask_) >= ((j - hole) & mask_)) {
+			slots_[hole] = slots_[j];
+			hole = j;
+		}
+	}
+	slots_[hole].row = NULL;
+	size_--;
+	return row;
+}
+
+} //namespace memdb
+
+#endif
@@ -0,0 +1,290 @@
+/*
+ * lsm_table.cc
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: jinyang
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <unistd.h>
+#include "db/lsm_table.h"
+#include "db/checkpoint.h"
+#include "db/rowformat.h"
+
+namespace memdb {
+
+//true if both rows have the same (index, primary) key
+static bool SameKey(TableSchema *s, char *r1, char *r2) {
+	return !RdOnlyRow::LessThan(r1, r2, s) && !RdOnlyRow::LessThan(r2, r1, s);
+}
+
+LsmTable::LsmTable(TableSchema *schema, const LsmOptions &options) :
+		schema_(schema), options_(options), next_run_(0),
+		busy_(false), shutdown_(false), failed_(false) {
+	assert(!options_.dir.empty());
+	//frozen tables outlive their turn as the active one
+	assert(schema_->GetArena() == NULL);
+	assert(options_.table.wal_path.empty());
+	active_.reset(new MemTable(schema_, options_.table));
+	bg_ = std::thread(&LsmTable::BackgroundLoop, this);
+}
+
+LsmTable::~LsmTable() {
+	{
+		std::lock_guard<std::mutex> l(mu_);
+		shutdown_ = true;
+	}
+	bg_cv_.notify_one();
+	bg_.join();
+	for (size_t i = 0; i < run_paths_.size(); i++)
+		unlink(run_paths_[i].c_str());
+}
+
+bool LsmTable::InsertRow(RwRow &row, bool update) {
+	std::lock_guard<std::mutex> w(write_mu_);
+	if (!update && OlderTiersHave(row))
+		return false;
+	if (!active_->InsertRow(row, update))
+		return false;
+	if (active_->ApproximateMemoryUsage() >= options_.memtable_bytes) {
+		std::lock_guard<std::mutex> l(mu_);
+		frozen_.insert(frozen_.begin(), active_);
+		active_.reset(new MemTable(schema_, options_.table));
+		bg_cv_.notify_one();
+	}
+	return true;
+}
+
+//Whether a frozen table or a run has the key of row. Tables() takes every
+//tier at once, so a table the background thread is flushing is seen in
+//one place or the other.
+bool LsmTable::OlderTiersHave(RwRow &row) {
+	row.EncodeKey();
+	TableList all;
+	Tables(&all);
+	for (size_t i = 1; i < all.size(); i++) {
+		MemTable::Iterator it(all[i].get());
+		it.SeekRow(row);
+		RdOnlyRow r(schema_);
+		if (it.Valid() && SameKey(schema_, row.Buffer(), it.RowAt(r).Buffer()))
+			return true;
+	}
+	return false;
+}
+
+size_t LsmTable::NumFrozen() {
+	std::lock_guard<std::mutex> l(mu_);
+	return frozen_.size();
+}
+
+size_t LsmTable::NumRuns() {
+	std::lock_guard<std::mutex> l(mu_);
+	return runs_.size();
+}
+
+bool LsmTable::WaitForBackgroundWork() {
+	std::unique_lock<std::mutex> l(mu_);
+	while (!failed_
+			&& (busy_ || !frozen_.empty() || runs_.size() > options_.max_runs))
+		idle_cv_.wait(l);
+	return !failed_;
+}
+
+//Every table, newest first
+void LsmTable::Tables(TableList *all) {
+	std::lock_guard<std::mutex> l(mu_);
+	all->clear();
+	all->push_back(active_);
+	all->insert(all->end(), frozen_.begin(), frozen_.end());
+	all->insert(all->end(), runs_.begin(), runs_.end());
+}
+
+std::string LsmTable::RunPath(uint64_t number) {
+	char name[32];
+	snprintf(name, sizeof(name), "/%06llu.run", (unsigned long long) number);
+	return options_.dir + name;
+}
+
+void LsmTable::BackgroundLoop() {
+	std::unique_lock<std::mutex> l(mu_);
+	while (true) {
+		while (!shutdown_ && frozen_.empty()
+				&& runs_.size() <= options_.max_runs)
+			bg_cv_.wait(l);
+		if (shutdown_)
+			break;
+		busy_ = true;
+		l.unlock();
+		//flushes come first, they free memory
+		bool ok = FlushOldest() || MergeRuns();
+		l.lock();
+		busy_ = false;
+		if (!ok) {
+			//out of disk space or the like: frozen tables stay in memory
+			perror("lsm background work");
+			failed_ = true;
+		}
+		idle_cv_.notify_all();
+		if (failed_)
+			break;
+	}
+}
+
+//Writes the oldest frozen table out as the newest run. Returns false if
+//there was nothing to flush or it failed.
+bool LsmTable::FlushOldest() {
+	std::shared_ptr<MemTable> table;
+	uint64_t number;
+	{
+		std::lock_guard<std::mutex> l(mu_);
+		if (frozen_.empty())
+			return false;
+		table = frozen_.back();
+		number = next_run_++;
+	}
+	std::string path = RunPath(number);
+	if (!table->WriteCheckpoint(path))
+		return false;
+	std::shared_ptr<MemTable> run(MemTable::OpenCheckpoint(schema_, path));
+	if (!run)
+		return false;
+	std::lock_guard<std::mutex> l(mu_);
+	frozen_.pop_back();
+	runs_.insert(runs_.begin(), run);
+	run_paths_.insert(run_paths_.begin(), path);
+	return true;
+}
+
+namespace {
+
+//The newest version of every key of some tables, for WriteCheckpoint
+class MergeCursor: public RowCursor {
+public:
+	MergeCursor(LsmTable::Iterator *it, MemTable *table) :
+			it_(it), table_(table), r_(table->GetSchema()) {
+	}
+	virtual void SeekToFirst() {
+		it_->SeekToFirst();
+	}
+	virtual bool Valid() {
+		return it_->Valid();
+	}
+	virtual void Next() {
+		it_->Next();
+	}
+	virtual const char *Row() {
+		return it_->RowAt(r_).Buffer();
+	}
+	virtual uint64_t KeyPrefix(const char *row) {
+		return table_->KeyPrefix(row);
+	}
+
+private:
+	LsmTable::Iterator *it_;
+	MemTable *table_;
+	RdOnlyRow r_;
+};
+
+} //namespace
+
+//Merges every run into one, while flushes wait: only this thread changes
+//runs_. Returns false if there was nothing to merge or it failed.
+bool LsmTable::MergeRuns() {
+	TableList runs;
+	std::vector<std::string> paths;
+	uint64_t number;
+	{
+		std::lock_guard<std::mutex> l(mu_);
+		if (runs_.size() <= options_.max_runs)
+			return false;
+		runs = runs_;
+		paths = run_paths_;
+		number = next_run_++;
+	}
+	std::string path = RunPath(number);
+	Iterator it(this, runs);
+	MergeCursor rows(&it, runs[0].get());
+	if (!WriteCheckpoint(schema_, &rows, path))
+		return false;
+	std::shared_ptr<MemTable> merged(MemTable::OpenCheckpoint(schema_, path));
+	if (!merged)
+		return false;
+	{
+		std::lock_guard<std::mutex> l(mu_);
+		runs_.assign(1, merged);
+		run_paths_.assign(1, path);
+	}
+	//iterators still reading the old runs keep their mappings
+	for (size_t i = 0; i < paths.size(); i++)
+		unlink(paths[i].c_str());
+	return true;
+}
+
+/*-----------------LsmTable::Iterator---------------*/
+LsmTable::Iterator::Iterator(LsmTable *table) :
+		table_(table), current_(-1), fixed_(false) {
+	SeekToFirst();
+}
+
+LsmTable::Iterator::Iterator(LsmTable *table, const TableList &tables) :
+		table_(table), tables_(tables), current_(-1), fixed_(true) {
+	for (size_t i = 0; i < tables_.size(); i++)
+		children_.push_back(MemTable::Iterator(tables_[i].get()));
+	FindSmallest();
+}
+
+void LsmTable::Iterator::RefreshTables() {
+	if (fixed_)
+		return;
+	TableList tables;
+	table_->Tables(&tables);
+	if (tables == tables_)
+		return;
+	children_.clear();
+	tables_.swap(tables);
+	for (size_t i = 0; i < tables_.size(); i++)
+		children_.push_back(MemTable::Iterator(tables_[i].get()));
+}
+
+//The smallest key wins, and among equal keys the newest table
+void LsmTable::Iterator::FindSmallest() {
+	current_ = -1;
+	for (size_t i = 0; i < children_.size(); i++) {
+		if (!children_[i].Valid())
+			continue;
+		if (current_ < 0
+				|| RdOnlyRow::LessThan(Current(i), Current(current_),
+						table_->schema_))
+			current_ = i;
+	}
+}
+
+//Older tables holding the same key step past it too
+void LsmTable::Iterator::Next() {
+	assert(Valid());
+	char *key = Current(current_);
+	for (size_t i = 0; i < children_.size(); i++) {
+		if ((int) i != current_ && children_[i].Valid()
+				&& SameKey(table_->schema_, Current(i), key))
+			children_[i].Next();
+	}
+	children_[current_].Next();
+	FindSmallest();
+}
+
+void LsmTable::Iterator::SeekRow(RdOnlyRow &r) {
+	RefreshTables();
+	for (size_t i = 0; i < children_.size(); i++)
+		children_[i].SeekRow(r);
+	FindSmallest();
+}
+
+void LsmTable::Iterator::SeekToFirst() {
+	RefreshTables();
+	for (size_t i = 0; i < children_.size(); i++)
+		children_[i].SeekToFirst();
+	FindSmallest();
+}
+
+} //namespace memdb
@@ -0,0 +1,156 @@
+/*
+ * lsm_table.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: jinyang
+ */
+
+#ifndef MEMDB_DB_LSM_TABLE_H_
+#define MEMDB_DB_LSM_TABLE_H_
+
+#include <stdint.h>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "db/memtable.h"
+
+namespace memdb {
+
+struct LsmOptions {
+	LsmOptions() :
+			memtable_bytes(64 << 20), max_runs(4) {
+	}
+
+	// Directory for the sorted runs
+	std::string dir;
+	// The active table is frozen and flushed once its
+	// ApproximateMemoryUsage() reaches this many bytes
+	size_t memtable_bytes;
+	// The background thread merges the runs into one when there are more
+	size_t max_runs;
+	// For the active tables. With concurrent set, iterators may run while
+	// rows are inserted, as for MemTable.
+	MemTableOptions table;
+};
+
+// A table that holds more rows than fit in memory, after leveldb: writes go
+// to an active MemTable; a full one is frozen and a background thread
+// writes it out as a sorted run, a checkpoint file that is then mapped
+// (see db/checkpoint.h), and merges runs once there are too many. Reads
+// merge the active table, the frozen ones and the runs, newest first, so
+// a row replaced by a later InsertRow is never seen twice.
+//
+// Rows can be inserted and replaced but not deleted. The runs are spill
+// files for this table only: they are removed when it is destroyed.
+class LsmTable {
+public:
+	LsmTable(TableSchema *schema, const LsmOptions &options);
+	~LsmTable();
+
+	// As MemTable::InsertRow. A row with update false is refused if any
+	// tier has its key, which takes a lookup in every frozen table and run.
+	bool InsertRow(RwRow &row, bool update = true);
+
+	TableSchema *GetSchema() {
+		return schema_;
+	}
+	size_t NumFrozen();
+	size_t NumRuns();
+	// Blocks until the background thread has nothing to flush or merge.
+	// Returns false if it stopped on an I/O error.
+	bool WaitForBackgroundWork();
+
+	// Forward only version of MemTable::Iterator over every tier. It sees
+	// the tables that exist when it is created or last Seek'd.
+	class Iterator {
+	public:
+		explicit Iterator(LsmTable *table);
+
+		bool Valid() {
+			return current_ >= 0;
+		}
+		template<class T> bool Valid(const T &key) {
+			return current_ >= 0 && children_[current_].Valid(key);
+		}
+		template<class T, class U> bool Valid(const T &key, const U &primary) {
+			return current_ >= 0 && children_[current_].Valid(key, primary);
+		}
+		// REQUIRES: Valid()
+		RdOnlyRow &RowAt(RdOnlyRow &r) {
+			return children_[current_].RowAt(r);
+		}
+		void Next();
+
+		template<class T> void Seek(const T &key) {
+			RefreshTables();
+			for (size_t i = 0; i < children_.size(); i++)
+				children_[i].Seek(key);
+			FindSmallest();
+		}
+		template<class T, class U> void Seek(const T &key, const U &primary) {
+			RefreshTables();
+			for (size_t i = 0; i < children_.size(); i++)
+				children_[i].Seek(key, primary);
+			FindSmallest();
+		}
+		void SeekRow(RdOnlyRow &r);
+		void SeekToFirst();
+
+	private:
+		friend class LsmTable;
+		typedef std::vector<std::shared_ptr<MemTable> > TableList;
+		// Over just these tables, for good
+		Iterator(LsmTable *table, const TableList &tables);
+
+		char *Current(int i) {
+			RdOnlyRow r(table_->schema_);
+			return children_[i].RowAt(r).Buffer();
+		}
+		void RefreshTables();
+		void FindSmallest();
+
+		LsmTable *table_;
+		//newest first; the tables stay alive while the iterator uses them
+		TableList tables_;
+		std::vector<MemTable::Iterator> children_;
+		int current_; //-1 when not Valid()
+		bool fixed_; //tables_ never refreshed
+	};
+
+private:
+	typedef std::vector<std::shared_ptr<MemTable> > TableList;
+
+	void Tables(TableList *all);
+	bool OlderTiersHave(RwRow &row);
+	void BackgroundLoop();
+	bool FlushOldest();
+	bool MergeRuns();
+	std::string RunPath(uint64_t number);
+
+	TableSchema *schema_;
+	LsmOptions options_;
+	std::mutex write_mu_; //serializes writers
+	std::mutex mu_; //protects the lists below
+	std::shared_ptr<MemTable> active_;
+	TableList frozen_; //newest first
+	TableList runs_; //newest first
+	std::vector<std::string> run_paths_; //of runs_
+	uint64_t next_run_;
+	std::condition_variable bg_cv_; //work for the background thread
+	std::condition_variable idle_cv_; //it has none
+	bool busy_;
+	bool shutdown_;
+	bool failed_; //the background thread gave up
+	std::thread bg_;
+
+	//no copying allowed
+	LsmTable(const LsmTable &);
+	void operator=(const LsmTable &);
+};
+
+} //namespace memdb
+
+#endif
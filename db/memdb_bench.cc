@@ -0,0 +1,468 @@
+/*
+ * memdb_bench.cc
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: jinyang
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include <algorithm>
+#include <atomic>
+#include <random>
+#include <string>
+#include <vector>
+#include "db/memtable.h"
+
+// Comma-separated list of workloads to run, in order. The fill ones start
+// from an empty table, the others run on the table left behind and fill it
+// in key order first (untimed) if it is empty.
+//   fillseq       -- insert --num rows in key order
+//   fillrandom    -- insert --num rows in random key order
+//   readseq       -- point lookups of every key in order
+//   readrandom    -- point lookups of uniformly random keys
+//   readzipf      -- point lookups of zipfian keys, a few of them hot
+//   scanrandom    -- Seek to a random key, read --scan_length rows
+//   scanzipf      -- the same from zipfian keys
+//   mixedrandom   -- --read_ratio percent lookups, --scan_ratio percent
+//                    scans, the rest overwrites, of random keys
+//   mixedzipf     -- the same with zipfian keys
+static const char *FLAGS_benchmarks =
+		"fillseq,fillrandom,readseq,readrandom,readzipf,scanrandom,"
+		"scanzipf,mixedrandom,mixedzipf";
+
+// Rows in the table
+static int FLAGS_num = 1000000;
+// Operations per read, scan or mixed workload, --num if negative
+static int FLAGS_ops = -1;
+// Type of the key column, "int" or "string" (16 digits)
+static const char *FLAGS_key = "int";
+// Bytes in the string payload of each row
+static int FLAGS_value_size = 100;
+// Rows read per scan
+static int FLAGS_scan_length = 100;
+// Percentages of lookups and scans in the mixed workloads
+static int FLAGS_read_ratio = 80;
+static int FLAGS_scan_ratio = 0;
+// Skew of the zipfian keys, 0.99 as in YCSB
+static double FLAGS_zipf_theta = 0.99;
+// Output as "text", "csv" or "json"
+static const char *FLAGS_format = "text";
+static int FLAGS_seed = 301;
+// Use a concurrent MemTable (lock-free skiplist) instead of the B-tree
+static bool FLAGS_concurrent = false;
+
+// Heap allocations so far, to report allocations per operation. With glibc
+// the program interposes malloc and friends, everything else reports none.
+static std::atomic<uint64_t> allocations(0);
+
+#ifdef __GLIBC__
+#define MEMDB_COUNT_ALLOCATIONS 1
+extern "C" {
+void *__libc_malloc(size_t n);
+void *__libc_calloc(size_t n, size_t size);
+void *__libc_realloc(void *p, size_t n);
+
+void *malloc(size_t n) {
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	return __libc_malloc(n);
+}
+
+void *calloc(size_t n, size_t size) {
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	return __libc_calloc(n, size);
+}
+
+void *realloc(void *p, size_t n) {
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	return __libc_realloc(p, n);
+}
+}
+#endif
+
+namespace memdb {
+
+namespace {
+
+uint64_t NowNanos() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Ranks in [0, n) where rank i has probability proportional to
+// 1 / (i+1)^theta, after Gray et al., "Quickly generating billion-record
+// synthetic databases", as in YCSB. Ranks are scrambled into keys so the
+// hot keys are spread over the table instead of sitting at its start.
+class ZipfGenerator {
+public:
+	ZipfGenerator(uint64_t n, double theta) :
+			n_(n), theta_(theta) {
+		zetan_ = Zeta(n, theta);
+		double zeta2 = Zeta(2, theta);
+		alpha_ = 1.0 / (1.0 - theta);
+		eta_ = (1 - pow(2.0 / n, 1 - theta)) / (1 - zeta2 / zetan_);
+	}
+
+	uint64_t Next(std::mt19937_64 *rnd) {
+		double u = std::uniform_real_distribution<double>(0, 1)(*rnd);
+		double uz = u * zetan_;
+		uint64_t rank;
+		if (uz < 1.0)
+			rank = 0;
+		else if (uz < 1.0 + pow(0.5, theta_))
+			rank = 1;
+		else
+			rank = (uint64_t) (n_ * pow(eta_ * u - eta_ + 1, alpha_));
+		if (rank >= n_)
+			rank = n_ - 1;
+		return (rank * 0x9E3779B97F4A7C15ULL) % n_;
+	}
+
+private:
+	static double Zeta(uint64_t n, double theta) {
+		double sum = 0;
+		for (uint64_t i = 1; i <= n; i++)
+			sum += 1.0 / pow((double) i, theta);
+		return sum;
+	}
+
+	uint64_t n_;
+	double theta_;
+	double zetan_;
+	double alpha_;
+	double eta_;
+};
+
+struct Result {
+	std::string name;
+	size_t ops;
+	double seconds;
+	uint64_t p50, p99, p999, max; //nanoseconds per operation
+	double allocs; //heap allocations per operation
+};
+
+class Benchmark {
+public:
+	Benchmark() :
+			schema_(NULL), table_(NULL), rnd_(FLAGS_seed), zipf_(NULL),
+			string_keys_(strcmp(FLAGS_key, "string") == 0),
+			value_(FLAGS_value_size, 'v'), printed_(false), sink_(0) {
+		std::string cnames[3] = { "key", "value", "payload" };
+		column_t ctypes[3] = { string_keys_ ? cString : cInt32, cInt32,
+				cString };
+		schema_ = new TableSchema(3, cnames, ctypes, "key");
+		options_.concurrent = FLAGS_concurrent;
+		table_ = new MemTable(schema_, options_);
+	}
+
+	~Benchmark() {
+		delete zipf_;
+		delete table_;
+		delete schema_;
+	}
+
+	void Run() {
+		PrintHeader();
+		std::string list(FLAGS_benchmarks);
+		size_t start = 0;
+		while (start <= list.size()) {
+			size_t end = list.find(',', start);
+			if (end == std::string::npos)
+				end = list.size();
+			std::string name = list.substr(start, end - start);
+			start = end + 1;
+			if (name.empty())
+				continue;
+			if (!RunOne(name))
+				fprintf(stderr, "unknown benchmark '%s'\n", name.c_str());
+		}
+		PrintFooter();
+	}
+
+private:
+	enum Dist {
+		kSequential, kRandom, kZipf
+	};
+
+	bool RunOne(const std::string &name) {
+		size_t ops = FLAGS_ops < 0 ? FLAGS_num : FLAGS_ops;
+		std::vector<uint64_t> lat;
+		uint64_t start, allocs;
+		if (name == "fillseq" || name == "fillrandom") {
+			table_->Clear();
+			std::vector<int> keys(FLAGS_num);
+			for (int i = 0; i < FLAGS_num; i++)
+				keys[i] = i;
+			if (name == "fillrandom")
+				std::shuffle(keys.begin(), keys.end(), rnd_);
+			lat.reserve(FLAGS_num);
+			allocs = allocations.load();
+			start = NowNanos();
+			for (int i = 0; i < FLAGS_num; i++) {
+				uint64_t t = NowNanos();
+				Write(keys[i]);
+				lat.push_back(NowNanos() - t);
+			}
+		} else {
+			Dist dist;
+			if (!ParseDist(name, &dist))
+				return false;
+			if (table_->Size() == 0) {
+				for (int i = 0; i < FLAGS_num; i++)
+					Write(i);
+			}
+			if (dist == kZipf && zipf_ == NULL)
+				zipf_ = new ZipfGenerator(FLAGS_num, FLAGS_zipf_theta);
+			bool scan = name.compare(0, 4, "scan") == 0;
+			bool mixed = name.compare(0, 5, "mixed") == 0;
+			lat.reserve(ops);
+			allocs = allocations.load();
+			start = NowNanos();
+			for (size_t i = 0; i < ops; i++) {
+				int key = NextKey(dist, i);
+				int kind = scan ? 1 : 0;
+				if (mixed) {
+					int r = rnd_() % 100;
+					kind = r < FLAGS_read_ratio ? 0 :
+							r < FLAGS_read_ratio + FLAGS_scan_ratio ? 1 : 2;
+				}
+				uint64_t t = NowNanos();
+				if (kind == 0)
+					Read(key);
+				else if (kind == 1)
+					Scan(key);
+				else
+					Write(key);
+				lat.push_back(NowNanos() - t);
+			}
+		}
+		Result r;
+		r.name = name;
+		r.ops = lat.size();
+		r.seconds = (NowNanos() - start) / 1e9;
+		r.allocs = r.ops ? (double) (allocations.load() - allocs) / r.ops : 0;
+		std::sort(lat.begin(), lat.end());
+		r.p50 = Percentile(lat, 0.5);
+		r.p99 = Percentile(lat, 0.99);
+		r.p999 = Percentile(lat, 0.999);
+		r.max = lat.empty() ? 0 : lat.back();
+		Print(r);
+		return true;
+	}
+
+	static bool ParseDist(const std::string &name, Dist *dist) {
+		static const char *prefixes[3] = { "read", "scan", "mixed" };
+		for (int i = 0; i < 3; i++) {
+			size_t n = strlen(prefixes[i]);
+			if (name.compare(0, n, prefixes[i]) != 0)
+				continue;
+			std::string d = name.substr(n);
+			if (d == "seq" && i == 0)
+				*dist = kSequential;
+			else if (d == "random")
+				*dist = kRandom;
+			else if (d == "zipf")
+				*dist = kZipf;
+			else
+				return false;
+			return true;
+		}
+		return false;
+	}
+
+	int NextKey(Dist dist, size_t i) {
+		switch (dist) {
+		case kSequential:
+			return i % FLAGS_num;
+		case kRandom:
+			return rnd_() % FLAGS_num;
+		default:
+			return zipf_->Next(&rnd_);
+		}
+	}
+
+	static uint64_t Percentile(const std::vector<uint64_t> &sorted, double q) {
+		if (sorted.empty())
+			return 0;
+		size_t i = (size_t) (q * sorted.size());
+		return sorted[i < sorted.size() ? i : sorted.size() - 1];
+	}
+
+	//into buf, which holds 17 bytes, so that reads allocate nothing
+	//themselves
+	static Slice StringKey(int key, char *buf) {
+		snprintf(buf, 17, "%016d", key);
+		return Slice(buf, 16);
+	}
+
+	void Write(int key) {
+		RwRow r(table_);
+		char buf[17];
+		if (string_keys_)
+			r << StringKey(key, buf);
+		else
+			r << key;
+		r << (int) rnd_() << value_;
+		table_->InsertRow(r);
+	}
+
+	//A fresh iterator per operation: in a concurrent table an iterator pins
+	//every row it has read until it is destroyed
+	void Read(int key) {
+		MemTable::Iterator it(table_);
+		bool found;
+		if (string_keys_) {
+			char buf[17];
+			Slice k = StringKey(key, buf);
+			it.Seek(k, k);
+			found = it.Valid(k, k);
+		} else {
+			it.Seek(key, key);
+			found = it.Valid(key, key);
+		}
+		if (!found) {
+			fprintf(stderr, "key %d not found\n", key);
+			exit(1);
+		}
+	}
+
+	void Scan(int key) {
+		MemTable::Iterator it(table_);
+		if (string_keys_) {
+			char buf[17];
+			Slice k = StringKey(key, buf);
+			it.Seek(k, k);
+		} else {
+			it.Seek(key, key);
+		}
+		RdOnlyRow r(table_);
+		for (int n = 0; n < FLAGS_scan_length && it.Valid(); n++) {
+			it.RowAt(r);
+			sink_ += r.GetIntColumn(1);
+			it.Next();
+		}
+	}
+
+	void PrintHeader() {
+#if !defined(__OPTIMIZE__)
+		fprintf(stderr, "WARNING: built without optimization; "
+				"make clean; make OPT=-O2 memdb_bench\n");
+#endif
+#ifndef MEMDB_COUNT_ALLOCATIONS
+		fprintf(stderr, "WARNING: heap allocations are not counted here\n");
+#endif
+		if (strcmp(FLAGS_format, "csv") == 0) {
+			printf("benchmark,key,rows,ops,seconds,ops_per_sec,"
+					"p50_ns,p99_ns,p999_ns,max_ns,allocs_per_op\n");
+		} else if (strcmp(FLAGS_format, "json") == 0) {
+			printf("[");
+		} else {
+			printf("rows: %d, key: %s, payload: %d bytes, %s table\n",
+					FLAGS_num, FLAGS_key, FLAGS_value_size,
+					FLAGS_concurrent ? "concurrent" : "plain");
+			printf("-------------------------------------------------------"
+					"-------------------------\n");
+		}
+	}
+
+	void PrintFooter() {
+		if (strcmp(FLAGS_format, "json") == 0)
+			printf("\n]\n");
+	}
+
+	void Print(const Result &r) {
+		double rate = r.seconds > 0 ? r.ops / r.seconds : 0;
+		if (strcmp(FLAGS_format, "csv") == 0) {
+			printf("%s,%s,%d,%zu,%.6f,%.0f,%llu,%llu,%llu,%llu,%.2f\n",
+					r.name.c_str(), FLAGS_key, FLAGS_num, r.ops, r.seconds, rate,
+					(unsigned long long) r.p50, (unsigned long long) r.p99,
+					(unsigned long long) r.p999, (unsigned long long) r.max,
+					r.allocs);
+		} else if (strcmp(FLAGS_format, "json") == 0) {
+			printf("%s\n  {\"benchmark\": \"%s\", \"key\": \"%s\", "
+					"\"rows\": %d, \"ops\": %zu, \"seconds\": %.6f, "
+					"\"ops_per_sec\": %.0f, \"p50_ns\": %llu, "
+					"\"p99_ns\": %llu, \"p999_ns\": %llu, \"max_ns\": %llu, "
+					"\"allocs_per_op\": %.2f}",
+					printed_ ? "," : "", r.name.c_str(), FLAGS_key, FLAGS_num,
+					r.ops, r.seconds, rate, (unsigned long long) r.p50,
+					(unsigned long long) r.p99, (unsigned long long) r.p999,
+					(unsigned long long) r.max, r.allocs);
+		} else {
+			printf("%-12s : %10.0f ops/sec; p50 %6llu ns, p99 %7llu ns, "
+					"p999 %8llu ns; %5.2f allocs/op\n", r.name.c_str(), rate,
+					(unsigned long long) r.p50, (unsigned long long) r.p99,
+					(unsigned long long) r.p999, r.allocs);
+		}
+		printed_ = true;
+		fflush(stdout);
+	}
+
+	TableSchema *schema_;
+	MemTableOptions options_;
+	MemTable *table_;
+	std::mt19937_64 rnd_;
+	ZipfGenerator *zipf_; //built before the first zipfian run, untimed
+	bool string_keys_;
+	std::string value_;
+	bool printed_;
+	long sink_; //keeps scans from being optimized away
+};
+
+} //namespace
+
+} //namespace memdb
+
+int main(int argc, char **argv) {
+	for (int i = 1; i < argc; i++) {
+		int n;
+		double d;
+		char junk;
+		const char *a = argv[i];
+		if (strncmp(a, "--benchmarks=", 13) == 0) {
+			FLAGS_benchmarks = a + 13;
+		} else if (sscanf(a, "--num=%d%c", &n, &junk) == 1) {
+			FLAGS_num = n;
+		} else if (sscanf(a, "--ops=%d%c", &n, &junk) == 1) {
+			FLAGS_ops = n;
+		} else if (strncmp(a, "--key=", 6) == 0) {
+			FLAGS_key = a + 6;
+		} else if (sscanf(a, "--value_size=%d%c", &n, &junk) == 1) {
+			FLAGS_value_size = n;
+		} else if (sscanf(a, "--scan_length=%d%c", &n, &junk) == 1) {
+			FLAGS_scan_length = n;
+		} else if (sscanf(a, "--read_ratio=%d%c", &n, &junk) == 1) {
+			FLAGS_read_ratio = n;
+		} else if (sscanf(a, "--scan_ratio=%d%c", &n, &junk) == 1) {
+			FLAGS_scan_ratio = n;
+		} else if (sscanf(a, "--zipf_theta=%lf%c", &d, &junk) == 1) {
+			FLAGS_zipf_theta = d;
+		} else if (strncmp(a, "--format=", 9) == 0) {
+			FLAGS_format = a + 9;
+		} else if (sscanf(a, "--seed=%d%c", &n, &junk) == 1) {
+			FLAGS_seed = n;
+		} else if (sscanf(a, "--concurrent=%d%c", &n, &junk) == 1
+				&& (n == 0 || n == 1)) {
+			FLAGS_concurrent = n;
+		} else {
+			fprintf(stderr, "invalid flag '%s'\n", a);
+			exit(1);
+		}
+	}
+	if (strcmp(FLAGS_key, "int") != 0 && strcmp(FLAGS_key, "string") != 0) {
+		fprintf(stderr, "--key must be int or string\n");
+		exit(1);
+	}
+	if (FLAGS_num <= 0 || FLAGS_zipf_theta <= 0 || FLAGS_zipf_theta >= 1) {
+		fprintf(stderr, "--num must be positive and --zipf_theta in (0, 1)\n");
+		exit(1);
+	}
+	memdb::Benchmark benchmark;
+	benchmark.Run();
+	return 0;
+}
@@ -1,7 +1,21 @@
 #include <stdio.h>
 #include <time.h>
 #include <assert.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <vector>
+#include <atomic>
+#include <thread>
 #include "memtable.h"
+#include "sharded_memtable.h"
+#include "columnar.h"
+#include "lsm_table.h"
+#include "db/dictionary.h"
+#include "util/arena.h"
 #include "util/testharness.h"
 
 namespace memdb {
@@ -148,6 +162,7 @@ TEST(MemdbTest, InsertSpeed) {
 	const int N = 1000000;
 	InitTestRows(N);
 	struct timespec start, end;
+	table_->Clear();
 	clock_gettime(CLOCK_REALTIME, &start);
 	DumpToTable(N);
 	clock_gettime(CLOCK_REALTIME, &end);
@@ -155,6 +170,1912 @@ TEST(MemdbTest, InsertSpeed) {
 			test::timediff(&end, &start) / N);
 }
 
+TEST(MemdbTest, ArenaInsertSpeed) {
+	const int N = 1000000;
+	InitTestRows(N);
+	schema_->EnableArena();
+	Arena *arena = schema_->GetArena();
+
+	struct timespec start, end;
+	table_->Clear();
+	clock_gettime(CLOCK_REALTIME, &start);
+	DumpToTable(N);
+	clock_gettime(CLOCK_REALTIME, &end);
+	printf("inserting %d rows into arena, %lu usec per row\n", N,
+			test::timediff(&end, &start) / N);
+	printf("arena %lu bytes used, %lu bytes reserved\n",
+			arena->MemoryUsed(), arena->MemoryReserved());
+	ASSERT_LE(arena->MemoryUsed(), arena->MemoryReserved());
+
+	qsort(allrows_, N, sizeof(test_row), row_compare);
+	MemTable::Iterator it(table_);
+	RdOnlyRow r(table_);
+	int i = 0;
+	for (it.SeekToFirst(); it.Valid(); it.Next()) {
+		r = it.RowAt(r);
+		ASSERT_EQ(allrows_[i].to_id, r.GetIntColumn(2));
+		ASSERT_EQ(*(allrows_[i].to_name), r.GetStrColumn(3));
+		i++;
+	}
+	ASSERT_EQ(N, i);
+
+	clock_gettime(CLOCK_REALTIME, &start);
+	table_->Clear();
+	clock_gettime(CLOCK_REALTIME, &end);
+	printf("clearing arena table, %lu usec\n", test::timediff(&end, &start));
+	ASSERT_EQ(0u, arena->MemoryUsed());
+	ASSERT_EQ(0u, arena->MemoryReserved());
+}
+
+TEST(MemdbTest, BulkLoad) {
+	const int N = 1000000;
+	InitTestRows(N);
+	std::vector<RwRow *> rows(N);
+	for (int i = 0; i < N; i++) {
+		rows[i] = new RwRow(table_);
+		*rows[i] << allrows_[i].from_id << *(allrows_[i].from_name)
+				<< allrows_[i].to_id << *(allrows_[i].to_name);
+	}
+	struct timespec start, end;
+	clock_gettime(CLOCK_REALTIME, &start);
+	ASSERT_EQ(N, table_->BulkLoad(rows.begin(), rows.end()));
+	clock_gettime(CLOCK_REALTIME, &end);
+	printf("bulk loading %d rows, %lu usec total\n", N,
+			test::timediff(&end, &start));
+
+	qsort(allrows_, N, sizeof(test_row), row_compare);
+	MemTable::Iterator it(table_);
+	RdOnlyRow r(table_);
+	int i = 0;
+	for (it.SeekToFirst(); it.Valid(); it.Next(), i++) {
+		r = it.RowAt(r);
+		ASSERT_EQ(allrows_[i].from_id, r.GetIntColumn(0));
+		ASSERT_EQ(allrows_[i].to_id, r.GetIntColumn(2));
+	}
+	ASSERT_EQ(N, i);
+	for (i = 0; i < N; i++)
+		delete rows[i];
+
+	//same rows again, one by one
+	table_->Clear();
+	for (i = 0; i < N; i++) {
+		rows[i] = new RwRow(table_);
+		*rows[i] << allrows_[i].from_id << *(allrows_[i].from_name)
+				<< allrows_[i].to_id << *(allrows_[i].to_name);
+	}
+	clock_gettime(CLOCK_REALTIME, &start);
+	for (i = 0; i < N; i++)
+		table_->InsertRow(*rows[i]);
+	clock_gettime(CLOCK_REALTIME, &end);
+	printf("inserting the same %d rows, %lu usec total\n", N,
+			test::timediff(&end, &start));
+	for (i = 0; i < N; i++)
+		delete rows[i];
+}
+
+TEST(MemdbTest, BulkLoadDuplicates) {
+	RwRow a(table_), b(table_), c(table_), d(table_), e(table_);
+	a << 1 << std::string("a") << 1 << std::string("x");
+	b << 1 << std::string("b") << 2 << std::string("x");
+	ASSERT_TRUE(table_->InsertRow(a));
+	ASSERT_TRUE(table_->InsertRow(b));
+
+	//c replaces a, d replaces c, e is new
+	c << 1 << std::string("c") << 1 << std::string("x");
+	d << 1 << std::string("d") << 1 << std::string("x");
+	e << 0 << std::string("e") << 5 << std::string("x");
+	RwRow *batch[3] = { &c, &d, &e };
+	ASSERT_EQ(3, table_->BulkLoad(batch, batch + 3));
+	ASSERT_TRUE(c.Buffer() == NULL);
+
+	RwRow f(table_), g(table_), h(table_);
+	f << 1 << std::string("f") << 2 << std::string("x");
+	g << 2 << std::string("g") << 0 << std::string("x");
+	h << 2 << std::string("h") << 0 << std::string("x");
+	RwRow *batch2[3] = { &f, &g, &h };
+	ASSERT_EQ(1, table_->BulkLoad(batch2, batch2 + 3, false));
+	ASSERT_TRUE(f.Buffer() != NULL);
+	ASSERT_TRUE(g.Buffer() == NULL);
+	ASSERT_TRUE(h.Buffer() != NULL);
+
+	const char *expected[4] = { "e", "d", "b", "g" };
+	MemTable::Iterator it(table_);
+	RdOnlyRow r(table_);
+	int i = 0;
+	for (it.SeekToFirst(); it.Valid(); it.Next(), i++) {
+		r = it.RowAt(r);
+		ASSERT_EQ(std::string(expected[i]), r.GetStrColumn(1));
+	}
+	ASSERT_EQ(4, i);
+}
+
+//Writers insert rows from allrows_ and then rewrite every tenth one while
+//readers seek to random keys and check that what they see is in order.
+TEST(MemdbTest, ConcurrentSpeed) {
+	const int N = 1000000;
+	const int kWriters = 2, kReaders = 2, kScan = 10;
+	InitTestRows(N);
+	MemTableOptions options;
+	options.concurrent = true;
+	MemTable table(schema_, options);
+
+	std::atomic<bool> done(false);
+	std::atomic<long> seeks(0);
+	std::atomic<int> errors(0);
+	std::vector<std::thread> threads;
+	for (int t = 0; t < kReaders; t++) {
+		threads.push_back(std::thread([&, t]() {
+			unsigned seed = t;
+			long n = 0;
+			RdOnlyRow r(&table);
+			while (!done.load()) {
+				int x = rand_r(&seed) % N;
+				MemTable::Iterator it(&table);
+				it.Seek(allrows_[x].from_id, allrows_[x].to_id);
+				long last = -1;
+				for (int i = 0; i < kScan && it.Valid(); i++, it.Next()) {
+					it.RowAt(r);
+					long k = ((long) r.GetIntColumn(0) << 32) | r.GetIntColumn(2);
+					if (k <= last || strlen(r.GetStrColumn(1)) > 20)
+						errors++;
+					last = k;
+				}
+				n++;
+			}
+			seeks += n;
+		}));
+	}
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_REALTIME, &start);
+	std::vector<std::thread> writers;
+	for (int t = 0; t < kWriters; t++) {
+		writers.push_back(std::thread([&, t]() {
+			for (int i = t; i < N; i += kWriters) {
+				RwRow r(&table);
+				r << allrows_[i].from_id << *(allrows_[i].from_name)
+						<< allrows_[i].to_id << *(allrows_[i].to_name);
+				table.InsertRow(r);
+			}
+			for (int i = t; i < N; i += 10 * kWriters) {
+				RwRow r(&table);
+				r << allrows_[i].from_id << std::string("updated")
+						<< allrows_[i].to_id << *(allrows_[i].to_name);
+				table.InsertRow(r, true);
+			}
+		}));
+	}
+	for (int t = 0; t < kWriters; t++)
+		writers[t].join();
+	clock_gettime(CLOCK_REALTIME, &end);
+	done = true;
+	for (int t = 0; t < kReaders; t++)
+		threads[t].join();
+
+	long usec = test::timediff(&end, &start);
+	int writes = N + N / 10;
+	printf("%d writers, %d readers: %ld inserts/sec, %ld seeks/sec "
+			"(%u hardware threads)\n", kWriters, kReaders,
+			writes * 1000000L / usec, seeks.load() * 1000000L / usec,
+			std::thread::hardware_concurrency());
+	ASSERT_EQ(0, errors.load());
+
+	qsort(allrows_, N, sizeof(test_row), row_compare);
+	MemTable::Iterator it(&table);
+	RdOnlyRow r(&table);
+	int i = 0, updated = 0;
+	for (it.SeekToFirst(); it.Valid(); it.Next(), i++) {
+		it.RowAt(r);
+		ASSERT_EQ(allrows_[i].from_id, r.GetIntColumn(0));
+		ASSERT_EQ(allrows_[i].to_id, r.GetIntColumn(2));
+		if (std::string("updated") == r.GetStrColumn(1))
+			updated++;
+	}
+	ASSERT_EQ(N, i);
+	ASSERT_EQ(N / 10, updated);
+}
+
+//Writers insert the same rows into tables with one shard and with several,
+//then scans and seeks over the merged shards are checked against the sorted
+//rows.
+TEST(MemdbTest, ShardedInsertSpeed) {
+	const int N = 500000;
+	const int kWriters = 4;
+	InitTestRows(N);
+	int nshards[2] = { 1, kWriters };
+	ShardedMemTable *tables[2];
+	for (int s = 0; s < 2; s++) {
+		ShardedMemTable *table = new ShardedMemTable(schema_, nshards[s]);
+		struct timespec start, end;
+		clock_gettime(CLOCK_REALTIME, &start);
+		std::vector<std::thread> writers;
+		for (int t = 0; t < kWriters; t++) {
+			writers.push_back(std::thread([&, t]() {
+				for (int i = t; i < N; i += kWriters) {
+					RwRow r(schema_);
+					r << allrows_[i].from_id << *(allrows_[i].from_name)
+							<< allrows_[i].to_id << *(allrows_[i].to_name);
+					table->InsertRow(r);
+				}
+			}));
+		}
+		for (int t = 0; t < kWriters; t++)
+			writers[t].join();
+		clock_gettime(CLOCK_REALTIME, &end);
+		printf("%d writers, %d shards: %ld inserts/sec (%u hardware threads)\n",
+				kWriters, nshards[s],
+				N * 1000000L / test::timediff(&end, &start),
+				std::thread::hardware_concurrency());
+		tables[s] = table;
+	}
+
+	qsort(allrows_, N, sizeof(test_row), row_compare);
+	ShardedMemTable *table = tables[1];
+	size_t total = 0;
+	for (int s = 0; s < table->NumShards(); s++)
+		total += table->Shard(s)->Size();
+	ASSERT_EQ(N, (int) total);
+
+	ShardedMemTable::Iterator it(table);
+	RdOnlyRow r(schema_);
+	int i = 0;
+	for (it.SeekToFirst(); it.Valid(); it.Next(), i++) {
+		it.RowAt(r);
+		ASSERT_EQ(allrows_[i].from_id, r.GetIntColumn(0));
+		ASSERT_EQ(allrows_[i].to_id, r.GetIntColumn(2));
+	}
+	ASSERT_EQ(N, i);
+	for (it.SeekToLast(); it.Valid(); it.Prev()) {
+		i--;
+		ASSERT_EQ(allrows_[i].from_id, it.RowAt(r).GetIntColumn(0));
+		ASSERT_EQ(allrows_[i].to_id, r.GetIntColumn(2));
+	}
+	ASSERT_EQ(0, i);
+
+	for (int q = 0; q < 1000; q++) {
+		int x = random() % N;
+		it.Seek(allrows_[x].from_id, allrows_[x].to_id);
+		ASSERT_TRUE(it.Valid(allrows_[x].from_id, allrows_[x].to_id));
+		//walk off the index key in both directions
+		for (int j = x + 1; j < x + 5 && j < N; j++) {
+			it.Next();
+			ASSERT_EQ(allrows_[j].to_id, it.RowAt(r).GetIntColumn(2));
+		}
+		it.Seek(allrows_[x].from_id, allrows_[x].to_id);
+		for (int j = x - 1; j > x - 5 && j >= 0; j--) {
+			it.Prev();
+			ASSERT_EQ(allrows_[j].to_id, it.RowAt(r).GetIntColumn(2));
+		}
+		//a key no row has lands on its successor in another shard
+		it.Seek(allrows_[x].from_id, allrows_[x].to_id + 1);
+		if (x + 1 < N && !(allrows_[x + 1].from_id == allrows_[x].from_id
+				&& allrows_[x + 1].to_id == allrows_[x].to_id + 1)) {
+			ASSERT_TRUE(it.Valid());
+			ASSERT_EQ(allrows_[x + 1].from_id, it.RowAt(r).GetIntColumn(0));
+			ASSERT_EQ(allrows_[x + 1].to_id, r.GetIntColumn(2));
+		}
+	}
+	delete tables[0];
+	delete tables[1];
+}
+
+//Every tenth row is rewritten with a new from_name, which has to move its
+//entry in the from_name index while the to_id index entry is swapped in place
+TEST(MemdbTest, SecondaryIndex) {
+	const int N = 100000;
+	InitTestRows(N);
+	std::string cnames[4] = { "from_id", "from_name", "to_id", "to_name" };
+	column_t ctypes[4] = { cInt32, cString, cInt32, cString };
+	TableSchema schema(4, cnames, ctypes, "to_id");
+	int by_to = schema.AddIndex("to_id");
+	int by_name = schema.AddIndex("from_name");
+	ASSERT_EQ(3, schema.NumIndexes());
+
+	for (int mode = 0; mode < 3; mode++) {
+		MemTableOptions options;
+		options.concurrent = (mode == 1);
+		MemTable table(&schema, options);
+		if (mode == 2) {
+			std::vector<RwRow *> rows;
+			for (int i = 0; i < N; i++) {
+				rows.push_back(new RwRow(&table));
+				*rows.back() << allrows_[i].from_id << *(allrows_[i].from_name)
+						<< allrows_[i].to_id << *(allrows_[i].to_name);
+			}
+			ASSERT_EQ(N, table.BulkLoad(rows.begin(), rows.end()));
+			for (int i = 0; i < N; i++)
+				delete rows[i];
+		} else {
+			for (int i = 0; i < N; i++) {
+				RwRow r(&table);
+				r << allrows_[i].from_id << *(allrows_[i].from_name)
+						<< allrows_[i].to_id << *(allrows_[i].to_name);
+				table.InsertRow(r);
+			}
+		}
+		std::vector<RwRow *> updates;
+		for (int i = 0; i < N; i += 10) {
+			char name[32];
+			sprintf(name, "updated%d", i);
+			updates.push_back(new RwRow(&table));
+			*updates.back() << allrows_[i].from_id << std::string(name)
+					<< allrows_[i].to_id << *(allrows_[i].to_name);
+		}
+		if (mode == 2) {
+			table.BulkLoad(updates.begin(), updates.end());
+		} else {
+			for (size_t i = 0; i < updates.size(); i++)
+				table.InsertRow(*updates[i]);
+		}
+		for (size_t i = 0; i < updates.size(); i++)
+			delete updates[i];
+
+		RdOnlyRow r(&table);
+		MemTable::Iterator it(&table, by_to);
+		int n = 0;
+		long last = -1;
+		for (it.SeekToFirst(); it.Valid(); it.Next(), n++) {
+			it.RowAt(r);
+			long k = ((long) r.GetIntColumn(2) << 32) | r.GetIntColumn(0);
+			ASSERT_TRUE(k > last);
+			last = k;
+		}
+		ASSERT_EQ(N, n);
+		for (int q = 0; q < 1000; q++) {
+			int x = random() % N;
+			it.Seek(allrows_[x].to_id);
+			bool found = false;
+			for (; it.Valid(allrows_[x].to_id); it.Next()) {
+				ASSERT_EQ(allrows_[x].to_id, it.RowAt(r).GetIntColumn(2));
+				if (r.GetIntColumn(0) == allrows_[x].from_id)
+					found = true;
+			}
+			ASSERT_TRUE(found);
+		}
+
+		MemTable::Iterator nit(&table, by_name);
+		std::string prev;
+		n = 0;
+		int updated = 0;
+		for (nit.SeekToFirst(); nit.Valid(); nit.Next(), n++) {
+			std::string name = nit.RowAt(r).GetStrColumn(1);
+			ASSERT_TRUE(prev <= name);
+			prev = name;
+			if (name.compare(0, 7, "updated") == 0)
+				updated++;
+		}
+		ASSERT_EQ(N, n);
+		ASSERT_EQ(N / 10, updated);
+		//names repeat, look for the row itself among those with its name
+		for (int x = 0; x < N; x++) {
+			bool found = false;
+			for (nit.Seek(*allrows_[x].from_name);
+					nit.Valid(*allrows_[x].from_name); nit.Next()) {
+				nit.RowAt(r);
+				if (*allrows_[x].from_name == r.GetStrColumn(1)
+						&& r.GetIntColumn(0) == allrows_[x].from_id
+						&& r.GetIntColumn(2) == allrows_[x].to_id)
+					found = true;
+			}
+			ASSERT_EQ(x % 10 != 0, found);
+		}
+	}
+	printf("kept 2 secondary indexes on %d rows in sync\n", N);
+}
+
+//Point lookups of the same keys through Seek, Get and MultiGet
+TEST(MemdbTest, HashGet) {
+	const int N = 1000000, Q = 100000;
+	InitTestRows(N);
+	MemTableOptions options;
+	options.hash_index = true;
+	MemTable table(schema_, options);
+	for (int i = 0; i < N; i++) {
+		RwRow r(&table);
+		r << allrows_[i].from_id << *(allrows_[i].from_name)
+				<< allrows_[i].to_id << *(allrows_[i].to_name);
+		table.InsertRow(r);
+	}
+	RwRow u(&table);
+	u << allrows_[0].from_id << std::string("updated") << allrows_[0].to_id
+			<< *(allrows_[0].to_name);
+	table.InsertRow(u);
+
+	std::vector<int> from(Q), to(Q);
+	for (int i = 0; i < Q; i++) {
+		int x = random() % N;
+		from[i] = allrows_[x].from_id;
+		to[i] = allrows_[x].to_id;
+	}
+	struct timespec start, end;
+	clock_gettime(CLOCK_REALTIME, &start);
+	for (int i = 0; i < Q; i++) {
+		MemTable::Iterator it(&table);
+		it.Seek(from[i], to[i]);
+		ASSERT_TRUE(it.Valid(from[i], to[i]));
+	}
+	clock_gettime(CLOCK_REALTIME, &end);
+	long seek = test::timediff(&end, &start);
+
+	RdOnlyRow r(&table);
+	clock_gettime(CLOCK_REALTIME, &start);
+	for (int i = 0; i < Q; i++) {
+		ASSERT_TRUE(table.Get(from[i], to[i], &r));
+		ASSERT_EQ(to[i], r.GetIntColumn(2));
+	}
+	clock_gettime(CLOCK_REALTIME, &end);
+	long get = test::timediff(&end, &start);
+
+	std::vector<RdOnlyRow> rows(Q, RdOnlyRow(&table));
+	clock_gettime(CLOCK_REALTIME, &start);
+	ASSERT_EQ(Q, (int) table.MultiGet(from.data(), to.data(), Q, rows.data()));
+	clock_gettime(CLOCK_REALTIME, &end);
+	long multiget = test::timediff(&end, &start);
+	for (int i = 0; i < Q; i++) {
+		ASSERT_EQ(from[i], rows[i].GetIntColumn(0));
+		ASSERT_EQ(to[i], rows[i].GetIntColumn(2));
+	}
+	printf("%d lookups: Seek %ld ns, Get %ld ns, MultiGet %ld ns each\n", Q,
+			seek * 1000 / Q, get * 1000 / Q, multiget * 1000 / Q);
+
+	ASSERT_TRUE(table.Get(allrows_[0].from_id, allrows_[0].to_id, &r));
+	ASSERT_EQ(std::string("updated"), r.GetStrColumn(1));
+	ASSERT_TRUE(!table.Get(allrows_[0].from_id, -1, &r));
+	ASSERT_TRUE(r.Buffer() == NULL);
+	table.Clear();
+	ASSERT_TRUE(!table.Get(allrows_[0].from_id, allrows_[0].to_id, &r));
+}
+
+//Concurrent writers under each sync policy, then the log of the last run
+//is replayed into fresh tables, also after a torn write at its end
+TEST(MemdbTest, WalSpeed) {
+	const int N = 20000, kWriters = 4;
+	const char *path = "/tmp/memdb_test_wal";
+	InitTestRows(N + 1000);
+	WalSync policies[3] = { kSyncEveryWrite, kSyncPeriodic, kSyncNone };
+	const char *names[3] = { "every write", "every 10ms", "none" };
+	MemTableOptions options;
+	options.concurrent = true;
+	options.wal_path = path;
+	options.wal_sync_ms = 10;
+	for (int p = 0; p < 3; p++) {
+		unlink(path);
+		options.wal_sync = policies[p];
+		MemTable table(schema_, options);
+		struct timespec start, end;
+		clock_gettime(CLOCK_REALTIME, &start);
+		std::vector<std::thread> writers;
+		for (int t = 0; t < kWriters; t++) {
+			writers.push_back(std::thread([&, t]() {
+				for (int i = t; i < N; i += kWriters) {
+					RwRow r(&table);
+					r << allrows_[i].from_id << *(allrows_[i].from_name)
+							<< allrows_[i].to_id << *(allrows_[i].to_name);
+					table.InsertRow(r);
+				}
+			}));
+		}
+		for (int t = 0; t < kWriters; t++)
+			writers[t].join();
+		clock_gettime(CLOCK_REALTIME, &end);
+		printf("wal sync %s, %d writers: %ld inserts/sec\n", names[p],
+				kWriters, N * 1000000L / test::timediff(&end, &start));
+		ASSERT_EQ(N, (int) table.Size());
+	}
+
+	{
+		options.concurrent = false;
+		MemTable table(schema_, options);
+		ASSERT_EQ(N, (int) table.Size());
+		for (int i = 0; i < N; i += 10) {
+			RwRow r(&table);
+			r << allrows_[i].from_id << std::string("updated")
+					<< allrows_[i].to_id << *(allrows_[i].to_name);
+			table.InsertRow(r);
+		}
+		std::vector<RwRow *> rows;
+		for (int i = N; i < N + 1000; i++) {
+			rows.push_back(new RwRow(&table));
+			*rows.back() << allrows_[i].from_id << *(allrows_[i].from_name)
+					<< allrows_[i].to_id << *(allrows_[i].to_name);
+		}
+		ASSERT_EQ(1000, table.BulkLoad(rows.begin(), rows.end()));
+		for (size_t i = 0; i < rows.size(); i++)
+			delete rows[i];
+	}
+	//a record cut short by a crash
+	FILE *f = fopen(path, "a");
+	fwrite("\x11\x22\x33\x44\x40\0\0\0abc", 1, 11, f);
+	fclose(f);
+	for (int round = 0; round < 2; round++) {
+		MemTable table(schema_, options);
+		ASSERT_EQ(N + 1000, (int) table.Size());
+		qsort(allrows_, N + 1000, sizeof(test_row), row_compare);
+		MemTable::Iterator it(&table);
+		RdOnlyRow r(&table);
+		int updated = 0;
+		for (int i = 0; i < N + 1000; i++, it.Next()) {
+			it.RowAt(r);
+			ASSERT_EQ(allrows_[i].from_id, r.GetIntColumn(0));
+			ASSERT_EQ(allrows_[i].to_id, r.GetIntColumn(2));
+			ASSERT_EQ(*allrows_[i].to_name, r.GetStrColumn(3));
+			if (std::string("updated") == r.GetStrColumn(1))
+				updated++;
+		}
+		ASSERT_EQ(N / 10, updated);
+	}
+	{
+		MemTable table(schema_, options);
+		table.Clear();
+		RwRow r(&table);
+		r << 1 << std::string("a") << 2 << std::string("b");
+		table.InsertRow(r);
+	}
+	MemTable table(schema_, options);
+	ASSERT_EQ(1, (int) table.Size());
+	unlink(path);
+}
+
+TEST(MemdbTest, Checkpoint) {
+	const int N = 500000;
+	const char *path = "/tmp/memdb_test_checkpoint";
+	InitTestRows(N);
+	DumpToTable(N);
+	struct timespec start, end;
+	clock_gettime(CLOCK_REALTIME, &start);
+	ASSERT_TRUE(table_->WriteCheckpoint(path));
+	clock_gettime(CLOCK_REALTIME, &end);
+	long write = test::timediff(&end, &start);
+
+	clock_gettime(CLOCK_REALTIME, &start);
+	MemTable *table = MemTable::OpenCheckpoint(schema_, path);
+	clock_gettime(CLOCK_REALTIME, &end);
+	ASSERT_TRUE(table != NULL);
+	printf("checkpoint of %d rows: written in %ld usec, opened in %ld usec\n",
+			N, write, test::timediff(&end, &start));
+	ASSERT_EQ(N, (int) table->Size());
+
+	qsort(allrows_, N, sizeof(test_row), row_compare);
+	MemTable::Iterator it(table);
+	RdOnlyRow r(table);
+	int i = 0;
+	for (it.SeekToFirst(); it.Valid(); it.Next(), i++) {
+		it.RowAt(r);
+		ASSERT_EQ(allrows_[i].from_id, r.GetIntColumn(0));
+		ASSERT_EQ(*allrows_[i].from_name, r.GetStrColumn(1));
+		ASSERT_EQ(allrows_[i].to_id, r.GetIntColumn(2));
+		ASSERT_EQ(*allrows_[i].to_name, r.GetStrColumn(3));
+	}
+	ASSERT_EQ(N, i);
+	for (it.SeekToLast(); it.Valid(); it.Prev())
+		ASSERT_EQ(allrows_[--i].to_id, it.RowAt(r).GetIntColumn(2));
+	ASSERT_EQ(0, i);
+	for (int q = 0; q < 10000; q++) {
+		int x = random() % N;
+		it.Seek(allrows_[x].from_id, allrows_[x].to_id);
+		ASSERT_TRUE(it.Valid(allrows_[x].from_id, allrows_[x].to_id));
+		ASSERT_EQ(*allrows_[x].to_name, it.RowAt(r).GetStrColumn(3));
+		//between two rows
+		it.Seek(allrows_[x].from_id, allrows_[x].to_id + 1);
+		if (x + 1 < N && allrows_[x + 1].from_id == allrows_[x].from_id
+				&& allrows_[x + 1].to_id == allrows_[x].to_id + 1)
+			continue;
+		if (x + 1 == N) {
+			ASSERT_TRUE(!it.Valid());
+		} else {
+			ASSERT_EQ(allrows_[x + 1].from_id, it.RowAt(r).GetIntColumn(0));
+			ASSERT_EQ(allrows_[x + 1].to_id, r.GetIntColumn(2));
+		}
+	}
+	delete table;
+
+	std::string cnames[2] = { "from_id", "to_id" };
+	column_t ctypes[2] = { cInt32, cInt32 };
+	TableSchema other(2, cnames, ctypes, "to_id");
+	ASSERT_TRUE(MemTable::OpenCheckpoint(&other, path) == NULL);
+	//the same columns, keyed differently
+	std::string names[4] = { "from_id", "from_name", "to_id", "to_name" };
+	column_t types[4] = { cInt32, cString, cInt32, cString };
+	TableSchema rekeyed(4, names, types, "from_id");
+	ASSERT_TRUE(MemTable::OpenCheckpoint(&rekeyed, path) == NULL);
+	TableSchema same(4, names, types, "to_id");
+	table = MemTable::OpenCheckpoint(&same, path);
+	ASSERT_TRUE(table != NULL);
+	delete table;
+	unlink(path);
+}
+
+TEST(MemdbTest, ColumnarScan) {
+	const int N = 1000000;
+	InitTestRows(N);
+	DumpToTable(N);
+	ColumnarTable ct(schema_);
+	struct timespec start, end;
+	clock_gettime(CLOCK_REALTIME, &start);
+	ct.Load(table_);
+	clock_gettime(CLOCK_REALTIME, &end);
+	printf("columnar load of %d rows: %ld usec\n", N,
+			test::timediff(&end, &start));
+	ASSERT_EQ(N, (int) ct.NumRows());
+
+	//reconstructed rows match the table, strings included
+	qsort(allrows_, N, sizeof(test_row), row_compare);
+	ColumnarTable::Iterator cit(&ct);
+	RdOnlyRow r(table_);
+	int i = 0;
+	for (cit.SeekToFirst(); cit.Valid(); cit.Next(), i++) {
+		cit.RowAt(r);
+		ASSERT_EQ(allrows_[i].from_id, r.GetIntColumn(0));
+		ASSERT_EQ(*allrows_[i].from_name, r.GetStrColumn(1));
+		ASSERT_EQ(allrows_[i].to_id, r.GetIntColumn(2));
+		ASSERT_EQ(*allrows_[i].to_name, r.GetStrColumn(3));
+	}
+	ASSERT_EQ(N, i);
+
+	int ranges[4][2] = { { 0, 999999 }, { 250000, 260000 }, { 5, 4 },
+			{ INT_MIN, INT_MAX } };
+	for (int q = 0; q < 4; q++) {
+		int lo = ranges[q][0], hi = ranges[q][1];
+		ColumnStats want;
+		want.count = 0;
+		want.sum = 0;
+		want.min = INT_MAX;
+		want.max = INT_MIN;
+		std::vector<uint32_t> want_rows;
+		MemTable::Iterator it(table_);
+		clock_gettime(CLOCK_REALTIME, &start);
+		for (it.SeekToFirst(); it.Valid(); it.Next()) {
+			int f = it.RowAt(r).GetIntColumn(0), t = r.GetIntColumn(2);
+			if (f < lo || f > hi)
+				continue;
+			want.count++;
+			want.sum += t;
+			want.min = std::min(want.min, t);
+			want.max = std::max(want.max, t);
+		}
+		clock_gettime(CLOCK_REALTIME, &end);
+		printf("[%d, %d] row scan: %ld usec", lo, hi,
+				test::timediff(&end, &start));
+		for (size_t k = 0; k < ct.NumRows(); k++) {
+			int f = ct.IntColumn(0)[k];
+			if (f >= lo && f <= hi)
+				want_rows.push_back(k);
+		}
+
+		const char *names[3] = { "scalar", "sse4.1", "avx2" };
+		for (int level = kSimdScalar; level <= kSimdAvx2; level++) {
+			if (ct.SetSimdLevel((SimdLevel) level) != level)
+				continue;
+			clock_gettime(CLOCK_REALTIME, &start);
+			ColumnStats s = ct.Aggregate(2, 0, lo, hi);
+			clock_gettime(CLOCK_REALTIME, &end);
+			printf(", %s: %ld usec", names[level],
+					test::timediff(&end, &start));
+			ASSERT_EQ(want.count, s.count);
+			ASSERT_EQ(want.sum, s.sum);
+			if (want.count) {
+				ASSERT_EQ(want.min, s.min);
+				ASSERT_EQ(want.max, s.max);
+			}
+			std::vector<uint32_t> rows;
+			ASSERT_EQ(want_rows.size(), ct.Filter(0, lo, hi, &rows));
+			ASSERT_TRUE(want_rows == rows);
+		}
+		printf("\n");
+	}
+}
+
+TEST(MemdbTest, ScanPushdown) {
+	const int N = 500000;
+	InitTestRows(N);
+	DumpToTable(N);
+	qsort(allrows_, N, sizeof(test_row), row_compare);
+	RdOnlyRow r(table_);
+	struct timespec start, end;
+
+	for (int q = 0; q < 4; q++) {
+		int lo = random() % 1000000, hi = lo + 50000;
+		int to_lo = random() % 1000000;
+		std::string name = test::RandomStr(20).substr(0, 1);
+		std::vector<ColumnPredicate> preds;
+		preds.push_back(ColumnPredicate(schema_, 2, ColumnPredicate::kGe, to_lo));
+		preds.push_back(ColumnPredicate(schema_, 3, ColumnPredicate::kGt,
+				Slice(name)));
+
+		std::vector<int> want;
+		clock_gettime(CLOCK_REALTIME, &start);
+		MemTable::Iterator it(table_);
+		for (it.Seek(lo); it.Valid(hi); it.Next()) {
+			it.RowAt(r);
+			std::string to_name;
+			r.GetColumn(3, &to_name);
+			if (r.GetIntColumn(2) >= to_lo && to_name > name)
+				want.push_back(r.GetIntColumn(2));
+		}
+		clock_gettime(CLOCK_REALTIME, &end);
+		long iter = test::timediff(&end, &start);
+
+		std::vector<int> got;
+		size_t batches = 0;
+		clock_gettime(CLOCK_REALTIME, &start);
+		size_t n = table_->Scan(lo, hi, preds,
+				[&](char * const *rows, size_t n) {
+					ASSERT_TRUE(n > 0 && n <= MemTable::kScanBatch);
+					for (size_t i = 0; i < n; i++) {
+						RdOnlyRow row(table_, rows[i]);
+						ASSERT_TRUE(row.GetIntColumn(0) >= lo);
+						ASSERT_TRUE(row.GetIntColumn(0) <= hi);
+						got.push_back(row.GetIntColumn(2));
+					}
+					batches++;
+					return true;
+				});
+		clock_gettime(CLOCK_REALTIME, &end);
+		printf("scan [%d, %d]: %zu rows in %zu batches, %ld usec, "
+				"iterator %ld usec\n", lo, hi, n, batches,
+				test::timediff(&end, &start), iter);
+		ASSERT_EQ(want.size(), n);
+		ASSERT_TRUE(want == got);
+	}
+
+	//negative primaries sort before the 0 a plain Seek probes with
+	RwRow neg(table_);
+	neg << allrows_[0].from_id << "x" << -5 << "y";
+	ASSERT_TRUE(table_->InsertRow(neg));
+	std::vector<ColumnPredicate> none;
+	int first = 0;
+	table_->Scan(allrows_[0].from_id, allrows_[0].from_id, none,
+			[&](char * const *rows, size_t n) {
+				first = RdOnlyRow(table_, rows[0]).GetIntColumn(2);
+				return false;
+			});
+	ASSERT_EQ(-5, first);
+
+	//the callback ends the scan
+	size_t calls = 0;
+	size_t n = table_->Scan(INT_MIN, INT_MAX, none,
+			[&](char * const *rows, size_t n) {
+				calls++;
+				return calls < 3;
+			});
+	ASSERT_EQ(3u, calls);
+	ASSERT_EQ(3 * MemTable::kScanBatch, n);
+}
+
+TEST(MemdbTest, Snapshots) {
+	const int N = 10000, kRounds = 20, kReaders = 2;
+	std::string cnames[3] = { "id", "round", "name" };
+	column_t ctypes[3] = { cInt32, cInt32, cString };
+	TableSchema schema(3, cnames, ctypes, "id");
+	schema.EnableVersions();
+	MemTableOptions options;
+	options.concurrent = true;
+	options.snapshots = true;
+	MemTable table(&schema, options);
+	for (int i = 0; i < N; i++) {
+		RwRow r(&table);
+		r << i << 0 << std::string("round 0 of a long name");
+		table.InsertRow(r);
+	}
+	const Snapshot *first = table.GetSnapshot();
+
+	//a writer bumps the round of row 0, 1, ... in turn, so a consistent
+	//view has rows 0..j at some round and the rest one round behind
+	std::atomic<bool> done(false);
+	std::atomic<int> errors(0), views(0);
+	std::vector<std::thread> readers;
+	for (int t = 0; t < kReaders; t++) {
+		readers.push_back(std::thread([&]() {
+			RdOnlyRow r(&table);
+			while (!done.load()) {
+				const Snapshot *snap = table.GetSnapshot();
+				MemTable::Iterator it(&table, snap);
+				int n = 0, top = -1, prev = INT_MAX;
+				for (it.SeekToFirst(); it.Valid(); it.Next(), n++) {
+					int round = it.RowAt(r).GetIntColumn(1);
+					if (r.GetIntColumn(0) != n
+							|| atoi(r.GetStrColumn(2) + 6) != round)
+						errors++;
+					if (n >= N) {
+						//added at the end of each round
+						if (round != n - N + 1)
+							errors++;
+						continue;
+					}
+					if (top < 0)
+						top = round;
+					if (round > prev || round < top - 1)
+						errors++;
+					prev = round;
+				}
+				//keys added after the snapshot do not show
+				if (n != N + (top > 0 ? top - 1 : 0) && n != N + top)
+					errors++;
+				table.ReleaseSnapshot(snap);
+				views++;
+			}
+		}));
+	}
+
+	for (int k = 1; k <= kRounds; k++) {
+		char name[64];
+		snprintf(name, sizeof(name), "round %d of a long name", k);
+		for (int i = 0; i < N; i++) {
+			RwRow r(&table);
+			r << i << k << std::string(name);
+			table.InsertRow(r);
+		}
+		RwRow r(&table);
+		r << N + k - 1 << k << std::string(name);
+		table.InsertRow(r);
+	}
+	done = true;
+	for (int t = 0; t < kReaders; t++)
+		readers[t].join();
+	printf("%d consistent views during %d rounds of updates\n", views.load(),
+			kRounds);
+	ASSERT_EQ(0, errors.load());
+
+	//the first snapshot still sees the table as loaded, even after a Clear
+	table.Clear();
+	ASSERT_EQ(0, (int) table.Size());
+	MemTable::Iterator it(&table, first);
+	RdOnlyRow r(&table);
+	int n = 0;
+	for (it.SeekToFirst(); it.Valid(); it.Next(), n++) {
+		ASSERT_EQ(n, it.RowAt(r).GetIntColumn(0));
+		ASSERT_EQ(0, r.GetIntColumn(1));
+		ASSERT_EQ(std::string("round 0 of a long name"), r.GetStrColumn(2));
+	}
+	ASSERT_EQ(N, n);
+	it.Seek(N / 2);
+	ASSERT_TRUE(it.Valid(N / 2));
+	for (it.SeekToLast(); it.Valid(); it.Prev())
+		n--;
+	ASSERT_EQ(0, n);
+	table.ReleaseSnapshot(first);
+}
+
+//Checks table against model, through the main index and through index 1
+//on to_name if the schema has it
+static void CheckTable(MemTable *table,
+		const std::map<std::pair<int, int>, std::pair<std::string, std::string> > &model) {
+	ASSERT_EQ(model.size(), table->Size());
+	MemTable::Iterator it(table);
+	RdOnlyRow r(table);
+	std::map<std::pair<int, int>, std::pair<std::string, std::string> >::const_iterator m =
+			model.begin();
+	for (it.SeekToFirst(); it.Valid(); it.Next(), ++m) {
+		ASSERT_TRUE(m != model.end());
+		it.RowAt(r);
+		ASSERT_EQ(m->first.first, r.GetIntColumn(0));
+		ASSERT_EQ(m->first.second, r.GetIntColumn(2));
+		ASSERT_EQ(m->second.first, r.GetStrColumn(1));
+		ASSERT_EQ(m->second.second, r.GetStrColumn(3));
+	}
+	ASSERT_TRUE(m == model.end());
+	if (table->GetSchema()->NumIndexes() < 2)
+		return;
+	size_t n = 0;
+	std::string last;
+	MemTable::Iterator sit(table, 1);
+	for (sit.SeekToFirst(); sit.Valid(); sit.Next(), n++) {
+		sit.RowAt(r);
+		ASSERT_TRUE(last <= r.GetStrColumn(3));
+		last = r.GetStrColumn(3);
+		m = model.find(std::make_pair(r.GetIntColumn(0), r.GetIntColumn(2)));
+		ASSERT_TRUE(m != model.end());
+		ASSERT_EQ(m->second.second, last);
+	}
+	ASSERT_EQ(model.size(), n);
+}
+
+TEST(MemdbTest, DeleteAndUpdate) {
+	const int N = 200000, kOps = 400000;
+	const char *path = "/tmp/memdb_test_delete";
+	std::string cnames[4] = { "from_id", "from_name", "to_id", "to_name" };
+	column_t ctypes[4] = { cInt32, cString, cInt32, cString };
+	TableSchema schema(4, cnames, ctypes, "to_id");
+	schema.AddIndex("to_name");
+	InitTestRows(N);
+	typedef std::map<std::pair<int, int>, std::pair<std::string, std::string> > Model;
+
+	//the mixed workload: a third each of inserts, column updates and
+	//deletes of random keys, half of which exist
+	const char *modes[3] = { "plain", "concurrent", "snapshots" };
+	for (int mode = 0; mode < 3; mode++) {
+		TableSchema versioned(4, cnames, ctypes, "to_id");
+		versioned.AddIndex("to_name");
+		MemTableOptions options;
+		if (mode > 0) {
+			options.concurrent = true;
+			options.snapshots = mode == 2;
+			versioned.EnableVersions();
+		}
+		MemTable table(mode > 0 ? &versioned : &schema, options);
+		Model model;
+		for (int i = 0; i < N / 2; i++) {
+			RwRow r(&table);
+			r << allrows_[i].from_id << *(allrows_[i].from_name)
+					<< allrows_[i].to_id << *(allrows_[i].to_name);
+			table.InsertRow(r);
+			model[std::make_pair(allrows_[i].from_id, allrows_[i].to_id)] =
+					std::make_pair(*allrows_[i].from_name, *allrows_[i].to_name);
+		}
+		const Snapshot *snap = options.snapshots ? table.GetSnapshot() : NULL;
+		Model before(model);
+
+		unsigned seed = 1;
+		struct timespec start, end;
+		clock_gettime(CLOCK_REALTIME, &start);
+		for (int op = 0; op < kOps; op++) {
+			test_row &t = allrows_[rand_r(&seed) % N];
+			std::pair<int, int> key(t.from_id, t.to_id);
+			switch (op % 3) {
+			case 0: {
+				RwRow r(&table);
+				r << t.from_id << *t.from_name << t.to_id << *t.to_name;
+				table.InsertRow(r);
+				model[key] = std::make_pair(*t.from_name, *t.to_name);
+				break;
+			}
+			case 1: {
+				std::string name = test::RandomStr(20);
+				int col = (op / 3) % 2 ? 1 : 3;
+				bool found = model.find(key) != model.end();
+				ASSERT_EQ(found, table.UpdateColumn(t.from_id, t.to_id, col, name));
+				if (found)
+					(col == 1 ? model[key].first : model[key].second) = name;
+				break;
+			}
+			default:
+				ASSERT_EQ(model.erase(key) == 1, table.Delete(t.from_id, t.to_id));
+			}
+		}
+		clock_gettime(CLOCK_REALTIME, &end);
+		printf("%s: %ld mixed ops/sec\n", modes[mode],
+				kOps * 1000000L / test::timediff(&end, &start));
+		CheckTable(&table, model);
+
+		if (snap) {
+			//deleted and updated rows still show as they were
+			MemTable::Iterator it(&table, snap);
+			RdOnlyRow r(&table);
+			Model::iterator m = before.begin();
+			for (it.SeekToFirst(); it.Valid(); it.Next(), ++m) {
+				ASSERT_TRUE(m != before.end());
+				it.RowAt(r);
+				ASSERT_EQ(m->first.first, r.GetIntColumn(0));
+				ASSERT_EQ(m->first.second, r.GetIntColumn(2));
+				ASSERT_EQ(m->second.first, r.GetStrColumn(1));
+				ASSERT_EQ(m->second.second, r.GetStrColumn(3));
+			}
+			ASSERT_TRUE(m == before.end());
+			table.ReleaseSnapshot(snap);
+			CheckTable(&table, model);
+		}
+	}
+
+	//an update in place against reinserting the whole row
+	MemTable table(&schema);
+	for (int i = 0; i < N; i++) {
+		RwRow r(&table);
+		r << allrows_[i].from_id << *(allrows_[i].from_name)
+				<< allrows_[i].to_id << *(allrows_[i].to_name);
+		table.InsertRow(r);
+	}
+	struct timespec start, end;
+	clock_gettime(CLOCK_REALTIME, &start);
+	for (int i = 0; i < N; i++)
+		table.UpdateColumn(allrows_[i].from_id, allrows_[i].to_id, 1,
+				*allrows_[i].to_name);
+	clock_gettime(CLOCK_REALTIME, &end);
+	long inplace = test::timediff(&end, &start);
+	clock_gettime(CLOCK_REALTIME, &start);
+	for (int i = 0; i < N; i++) {
+		RwRow r(&table);
+		r << allrows_[i].from_id << *(allrows_[i].from_name)
+				<< allrows_[i].to_id << *(allrows_[i].to_name);
+		table.InsertRow(r);
+	}
+	clock_gettime(CLOCK_REALTIME, &end);
+	printf("%d string column updates: %ld usec in place, %ld usec by "
+			"reinsert\n", N, inplace, test::timediff(&end, &start));
+
+	//deletes and updates come back from the log
+	unlink(path);
+	MemTableOptions options;
+	options.wal_path = path;
+	Model model;
+	{
+		MemTable logged(&schema, options);
+		for (int i = 0; i < 1000; i++) {
+			RwRow r(&logged);
+			r << allrows_[i].from_id << *(allrows_[i].from_name)
+					<< allrows_[i].to_id << *(allrows_[i].to_name);
+			logged.InsertRow(r);
+			std::pair<int, int> key(allrows_[i].from_id, allrows_[i].to_id);
+			if (i % 3 == 0) {
+				ASSERT_TRUE(logged.Delete(key.first, key.second));
+			} else if (i % 3 == 1) {
+				ASSERT_TRUE(logged.UpdateColumn(key.first, key.second, 3,
+						std::string("updated")));
+				model[key] = std::make_pair(*allrows_[i].from_name, "updated");
+			} else {
+				model[key] = std::make_pair(*allrows_[i].from_name,
+						*allrows_[i].to_name);
+			}
+		}
+	}
+	MemTable replayed(&schema, options);
+	CheckTable(&replayed, model);
+	unlink(path);
+}
+
+TEST(MemdbTest, LsmTier) {
+	const int N = 300000;
+	InitTestRows(N);
+	LsmOptions options;
+	options.dir = "/tmp/memdb_test_lsm";
+	options.memtable_bytes = 2 << 20;
+	options.max_runs = 3;
+	options.table.concurrent = true;
+	mkdir(options.dir.c_str(), 0755);
+	LsmTable lsm(schema_, options);
+
+	//every third write replaces an earlier row, likely in an older tier
+	std::map<std::pair<int, int>, std::string> model;
+	struct timespec start, end;
+	clock_gettime(CLOCK_REALTIME, &start);
+	for (int i = 0; i < N; i++) {
+		test_row &t = i % 3 == 2 ? allrows_[random() % i] : allrows_[i];
+		std::string name = i % 3 == 2 ? test::RandomStr(20) : *t.to_name;
+		RwRow r(schema_);
+		r << t.from_id << *t.from_name << t.to_id << name;
+		ASSERT_TRUE(lsm.InsertRow(r));
+		model[std::make_pair(t.from_id, t.to_id)] = name;
+	}
+	clock_gettime(CLOCK_REALTIME, &end);
+	long usec = test::timediff(&end, &start);
+	printf("lsm: %ld inserts/sec, %zu frozen tables and %zu runs behind\n",
+			N * 1000000L / usec, lsm.NumFrozen(), lsm.NumRuns());
+
+	//a key in any tier, not just the active table, refuses an insert
+	ASSERT_TRUE(lsm.NumFrozen() + lsm.NumRuns() > 0);
+	for (int q = 0; q < 1000; q++) {
+		test_row &t = allrows_[random() % (N / 3) * 3];
+		RwRow r(schema_);
+		r << t.from_id << *t.from_name << t.to_id << std::string("again");
+		ASSERT_TRUE(!lsm.InsertRow(r, false));
+	}
+	{
+		RwRow r(schema_);
+		r << -1 << std::string("new") << -1 << std::string("new");
+		ASSERT_TRUE(lsm.InsertRow(r, false));
+		model[std::make_pair(-1, -1)] = "new";
+	}
+
+	for (int round = 0; round < 2; round++) {
+		//first while the background thread may still be at work
+		if (round == 1) {
+			ASSERT_TRUE(lsm.WaitForBackgroundWork());
+			ASSERT_EQ(0u, lsm.NumFrozen());
+			ASSERT_TRUE(lsm.NumRuns() <= options.max_runs);
+		}
+		LsmTable::Iterator it(&lsm);
+		RdOnlyRow r(schema_);
+		std::map<std::pair<int, int>, std::string>::iterator m = model.begin();
+		clock_gettime(CLOCK_REALTIME, &start);
+		for (it.SeekToFirst(); it.Valid(); it.Next(), ++m) {
+			ASSERT_TRUE(m != model.end());
+			it.RowAt(r);
+			ASSERT_EQ(m->first.first, r.GetIntColumn(0));
+			ASSERT_EQ(m->first.second, r.GetIntColumn(2));
+			ASSERT_EQ(m->second, r.GetStrColumn(3));
+		}
+		clock_gettime(CLOCK_REALTIME, &end);
+		ASSERT_TRUE(m == model.end());
+		printf("lsm: merged scan of %zu rows over %zu runs in %ld usec\n",
+				model.size(), lsm.NumRuns(), test::timediff(&end, &start));
+
+		for (int q = 0; q < 1000; q++) {
+			test_row &t = allrows_[random() % (N / 3) * 3];
+			it.Seek(t.from_id, t.to_id);
+			ASSERT_TRUE(it.Valid(t.from_id, t.to_id));
+			ASSERT_EQ(model[std::make_pair(t.from_id, t.to_id)],
+					it.RowAt(r).GetStrColumn(3));
+		}
+	}
+	rmdir(options.dir.c_str());
+}
+
+//a dictionary outlives the tables on its schema and is no reason to
+//freeze or refuse one
+TEST(MemdbTest, LsmDictionary) {
+	const int kNames = 40000, N = 1000;
+	std::string cnames[4] = { "from_id", "from_name", "to_id", "to_name" };
+	column_t ctypes[4] = { cInt32, cString, cInt32, cString };
+	TableSchema schema(4, cnames, ctypes, "to_id");
+	schema.EnableDictionary("from_name");
+	schema.EnableDictionary("to_name");
+	LsmOptions options;
+	options.dir = "/tmp/memdb_test_lsm_dict";
+	options.memtable_bytes = 1 << 20;
+	mkdir(options.dir.c_str(), 0755);
+
+	//names interned by rows that were never inserted
+	std::vector<std::string> names;
+	for (int i = 0; i < kNames; i++) {
+		char name[32];
+		snprintf(name, sizeof(name), "user-name-%08d", i);
+		names.push_back(name);
+		RwRow r(&schema);
+		r << i << names.back() << i << names.back();
+	}
+	ASSERT_TRUE(schema.DictionaryBytes() > options.memtable_bytes);
+
+	LsmTable lsm(&schema, options);
+	for (int i = 0; i < N; i++) {
+		RwRow r(&schema);
+		r << i << names[i] << i << names[kNames - 1 - i];
+		ASSERT_TRUE(lsm.InsertRow(r));
+	}
+	ASSERT_TRUE(lsm.WaitForBackgroundWork());
+	ASSERT_EQ(0u, lsm.NumFrozen());
+	ASSERT_EQ(0u, lsm.NumRuns());
+	LsmTable::Iterator it(&lsm);
+	RdOnlyRow r(&schema);
+	int n = 0;
+	for (it.SeekToFirst(); it.Valid(); it.Next(), n++) {
+		it.RowAt(r);
+		ASSERT_EQ(names[kNames - 1 - r.GetIntColumn(0)], r.GetStrColumn(3));
+	}
+	ASSERT_EQ(N, n);
+	rmdir(options.dir.c_str());
+
+	//nor does it count against a table's memory limit
+	MemTableOptions limited;
+	limited.memory_limit = 1 << 20;
+	MemTable table(&schema, limited);
+	for (int i = 0; i < N; i++) {
+		RwRow w(&table);
+		w << i << names[i] << i << names[i];
+		ASSERT_TRUE(table.InsertRow(w));
+	}
+	ASSERT_EQ(N, (int) table.Size());
+}
+
+TEST(MemdbTest, MemoryAccounting) {
+	const int N = 20000;
+	std::string cnames[3] = { "id", "name", "group" };
+	column_t ctypes[3] = { cInt32, cString, cInt32 };
+	TableSchema schema(3, cnames, ctypes, "id");
+	schema.AddIndex("name");
+	MemTableOptions options;
+	options.hash_index = true;
+	MemTable table(&schema, options);
+	MemTableStats s = table.GetStats();
+	ASSERT_EQ(0u, s.rows);
+	ASSERT_EQ(0u, s.row_bytes + s.string_bytes);
+	size_t empty = s.index_bytes;
+
+	//strings of 20 bytes live outside the row, those of 5 inside
+	size_t strings = 0;
+	for (int i = 0; i < N; i++) {
+		RwRow r(&table);
+		std::string name(i % 2 ? 20 : 5, 'a' + i % 26);
+		r << i << name << i % 10;
+		ASSERT_TRUE(table.InsertRow(r));
+		strings += i % 2 ? 21 : 0;
+	}
+	s = table.GetStats();
+	ASSERT_EQ((size_t) N, s.rows);
+	ASSERT_EQ(N * (size_t) schema.RowSize(), s.row_bytes);
+	ASSERT_EQ(strings, s.string_bytes);
+	ASSERT_TRUE(s.index_bytes > empty);
+	ASSERT_EQ(s.row_bytes + s.string_bytes + s.index_bytes,
+			table.ApproximateMemoryUsage());
+	printf("memory: %zu rows take %zu row, %zu string and %zu index bytes\n",
+			s.rows, s.row_bytes, s.string_bytes, s.index_bytes);
+
+	//replacing, updating in place and deleting keep the counts exact
+	for (int i = 0; i < N; i += 4) {
+		RwRow r(&table);
+		r << i << std::string(30, 'z') << 0; //was 5 bytes
+		ASSERT_TRUE(table.InsertRow(r));
+		strings += 31;
+	}
+	for (int i = 1; i < N; i += 4) {
+		ASSERT_TRUE(table.UpdateColumn(i, i, 1, Slice("short"))); //was 20
+		strings -= 21;
+	}
+	for (int i = 3; i < N; i += 4) {
+		ASSERT_TRUE(table.Delete(i, i));
+		strings -= 21;
+	}
+	s = table.GetStats();
+	ASSERT_EQ((size_t) N * 3 / 4, s.rows);
+	ASSERT_EQ(s.rows * schema.RowSize(), s.row_bytes);
+	ASSERT_EQ(strings, s.string_bytes);
+	table.Clear();
+	s = table.GetStats();
+	ASSERT_EQ(0u, s.row_bytes + s.string_bytes);
+
+	//versions kept for a snapshot are charged until they are freed
+	{
+		TableSchema versioned(3, cnames, ctypes, "id");
+		versioned.EnableVersions();
+		MemTableOptions vopts;
+		vopts.concurrent = vopts.snapshots = true;
+		MemTable vt(&versioned, vopts);
+		for (int round = 0; round < 2; round++) {
+			for (int i = 0; i < N; i++) {
+				RwRow r(&vt);
+				r << i << std::string(20, 'v') << round;
+				ASSERT_TRUE(vt.InsertRow(r));
+			}
+			if (round == 0) {
+				const Snapshot *snap = vt.GetSnapshot();
+				for (int i = 0; i < N; i++) {
+					RwRow r(&vt);
+					r << i << std::string(20, 'w') << 1;
+					ASSERT_TRUE(vt.InsertRow(r));
+				}
+				s = vt.GetStats();
+				ASSERT_EQ(2 * N * (size_t) versioned.RowSize(), s.row_bytes);
+				ASSERT_EQ(2 * N * 21u, s.string_bytes);
+				vt.ReleaseSnapshot(snap);
+			}
+		}
+		//nothing pins the old versions any more, all but one per key
+		//are gone once the epoch manager has run
+		s = vt.GetStats();
+		ASSERT_EQ((size_t) N, s.rows);
+		ASSERT_TRUE(s.row_bytes < 3 * N * (size_t) versioned.RowSize());
+	}
+
+	//a table at its limit refuses rows until the callback makes room
+	size_t limit = 0;
+	for (int i = 0; i < N / 2; i++) {
+		RwRow r(&table);
+		r << i << std::string(20, 'x') << 0;
+		ASSERT_TRUE(table.InsertRow(r));
+	}
+	limit = table.ApproximateMemoryUsage();
+	table.Clear();
+	MemTableOptions limited;
+	limited.memory_limit = limit;
+	int calls = 0;
+	bool clear = false;
+	limited.on_memory_limit = [&](MemTable *t) {
+		calls++;
+		if (clear)
+			t->Clear();
+		return false;
+	};
+	MemTable capped(&schema, limited);
+	int taken = 0;
+	for (int i = 0; i < N; i++) {
+		RwRow r(&capped);
+		r << i << std::string(20, 'x') << 0;
+		if (capped.InsertRow(r))
+			taken++;
+	}
+	ASSERT_TRUE(taken > 0 && taken < N);
+	ASSERT_EQ(N - taken, calls);
+	//index nodes the next row adds are not foreseen
+	s = capped.GetStats();
+	ASSERT_TRUE(s.row_bytes + s.string_bytes <= limit);
+	std::vector<RwRow *> batch;
+	for (int i = 0; i < 10; i++) {
+		batch.push_back(new RwRow(&capped));
+		*batch.back() << N + i << std::string(20, 'y') << 0;
+	}
+	ASSERT_EQ(0, capped.BulkLoad(batch.begin(), batch.end()));
+	clear = true;
+	ASSERT_EQ(10, capped.BulkLoad(batch.begin(), batch.end()));
+	ASSERT_EQ(10u, capped.Size());
+	for (int i = 0; i < 10; i++)
+		delete batch[i];
+}
+
+//Every column type through the row layout, typed indexes, predicates, the
+//log and the columnar copy
+TEST(MemdbTest, ColumnTypes) {
+	{
+		//the int64 is aligned, the second int fills the hole before it
+		std::string cnames[3] = { "a", "b", "c" };
+		column_t ctypes[3] = { cInt32, cInt64, cInt32 };
+		TableSchema schema(3, cnames, ctypes, "a");
+		ASSERT_EQ(0, schema.GetColumnPos(0));
+		ASSERT_EQ(8, schema.GetColumnPos(1));
+		ASSERT_EQ(4, schema.GetColumnPos(2));
+		ASSERT_EQ(16, schema.RowSize());
+	}
+
+	const int N = 20000, kTagWidth = 6;
+	const int64_t kEpoch = 1700000000000000LL;
+	const char *path = "/tmp/memdb_test_types_wal";
+	std::vector<std::string> cnames;
+	cnames.push_back("count");
+	cnames.push_back("id");
+	cnames.push_back("name");
+	cnames.push_back("price");
+	cnames.push_back("tag");
+	cnames.push_back("ts");
+	std::vector<column_t> ctypes;
+	ctypes.push_back(cInt64);
+	ctypes.push_back(cInt32);
+	ctypes.push_back(cString);
+	ctypes.push_back(cDouble);
+	ctypes.push_back(cBinary);
+	ctypes.push_back(cTimestamp);
+	std::vector<int> widths(6, 0);
+	widths[4] = kTagWidth;
+	TableSchema schema(cnames, ctypes, widths, "id");
+	int price_index = schema.AddIndex("price");
+	int tag_index = schema.AddIndex("tag");
+	ASSERT_EQ(0, schema.GetColumnPos(0));
+	ASSERT_EQ(8, schema.GetColumnPos(1));
+	for (int c = 0; c < schema.NumColumns(); c++) {
+		ASSERT_EQ(0, schema.GetColumnPos(c) % TableSchema::Alignment(ctypes[c]));
+		for (int d = 0; d < c; d++) {
+			ASSERT_TRUE(schema.GetColumnPos(c) + schema.GetColumnSize(c)
+					<= schema.GetColumnPos(d)
+					|| schema.GetColumnPos(d) + schema.GetColumnSize(d)
+							<= schema.GetColumnPos(c));
+		}
+	}
+	ASSERT_EQ(0, schema.RowSize() % 8);
+
+	unlink(path);
+	MemTableOptions options;
+	options.wal_path = path;
+	std::vector<std::pair<int64_t, int> > keys;
+	std::vector<std::string> tags;
+	{
+		MemTable table(&schema, options);
+		for (int i = 0; i < N; i++) {
+			//tags shorter than the column are zero padded
+			char tag[kTagWidth];
+			int len = 1 + i % kTagWidth;
+			for (int j = 0; j < len; j++)
+				tag[j] = (char) ((i * 7 + j * 13) % 256);
+			RwRow r(&table);
+			r << (int64_t) ((i % 100 - 50) * 10000000000LL) << i
+					<< std::string("n") + std::to_string(i)
+					<< (i % 37 - 18) * 1.5 << Slice(tag, len)
+					<< Timestamp(kEpoch + i);
+			ASSERT_TRUE(table.InsertRow(r));
+			keys.push_back(std::make_pair((i % 100 - 50) * 10000000000LL, i));
+			tags.push_back(std::string(tag, len) + std::string(kTagWidth - len,
+					'\0'));
+		}
+	}
+
+	MemTable table(&schema, options);
+	ASSERT_EQ(N, (int) table.Size());
+	std::sort(keys.begin(), keys.end());
+	MemTable::Iterator it(&table);
+	RdOnlyRow r(&table);
+	int n = 0;
+	for (it.SeekToFirst(); it.Valid(); it.Next(), n++) {
+		r = it.RowAt(r);
+		int id = r.GetIntColumn(1);
+		ASSERT_EQ(keys[n].first, r.GetInt64Column(0));
+		ASSERT_EQ(keys[n].second, id);
+		ASSERT_EQ(std::string("n") + std::to_string(id),
+				std::string(r.GetStrColumn(2)));
+		ASSERT_TRUE(r.GetDoubleColumn(3) == (id % 37 - 18) * 1.5);
+		ASSERT_EQ(tags[id], r.GetSliceColumn(4).ToString());
+		ASSERT_TRUE(r.GetTimestampColumn(5) == Timestamp(kEpoch + id));
+	}
+	ASSERT_EQ(N, n);
+
+	//a double key, ordered through the generic comparator
+	MemTable::Iterator pit(&table, price_index);
+	double last = -1e300;
+	n = 0;
+	for (pit.Seek(-3.0); pit.Valid(); pit.Next(), n++) {
+		r = pit.RowAt(r);
+		ASSERT_TRUE(r.GetDoubleColumn(3) >= last);
+		ASSERT_TRUE(r.GetDoubleColumn(3) >= -3.0);
+		last = r.GetDoubleColumn(3);
+	}
+	int want = 0;
+	for (int i = 0; i < N; i++)
+		want += (i % 37 - 18) * 1.5 >= -3.0;
+	ASSERT_EQ(want, n);
+
+	MemTable::Iterator tit(&table, tag_index);
+	std::string prev;
+	n = 0;
+	for (tit.SeekToFirst(); tit.Valid(); tit.Next(), n++) {
+		r = tit.RowAt(r);
+		std::string tag = r.GetSliceColumn(4).ToString();
+		ASSERT_TRUE(prev <= tag);
+		prev = tag;
+	}
+	ASSERT_EQ(N, n);
+
+	std::vector<ColumnPredicate> preds;
+	preds.push_back(ColumnPredicate(&schema, 5, ColumnPredicate::kGe,
+			Timestamp(kEpoch + N / 2)));
+	preds.push_back(ColumnPredicate(&schema, 0, ColumnPredicate::kLt,
+			(int64_t) 0));
+	std::vector<int> got;
+	table.Scan(-6.0, 6.0, preds, [&](char * const *rows, size_t n) {
+		for (size_t i = 0; i < n; i++)
+			got.push_back(RdOnlyRow(&table, rows[i]).GetIntColumn(1));
+		return true;
+	}, price_index);
+	std::vector<int> expected;
+	for (int i = N / 2; i < N; i++) {
+		double price = (i % 37 - 18) * 1.5;
+		if (price >= -6.0 && price <= 6.0 && i % 100 < 50)
+			expected.push_back(i);
+	}
+	std::sort(got.begin(), got.end());
+	ASSERT_TRUE(got == expected);
+
+	ColumnPredicate tag_eq(&schema, 4, ColumnPredicate::kEq, Slice(tags[0]
+			.data(), 1));
+	ColumnarTable columns(&schema);
+	columns.Load(&table);
+	ColumnarTable::Iterator cit(&columns);
+	n = 0;
+	for (cit.SeekToFirst(); cit.Valid(); cit.Next(), n++) {
+		r = cit.RowAt(r);
+		int id = r.GetIntColumn(1);
+		ASSERT_EQ(keys[n].first, r.GetInt64Column(0));
+		ASSERT_TRUE(r.GetDoubleColumn(3) == (id % 37 - 18) * 1.5);
+		ASSERT_TRUE(r.GetTimestampColumn(5) == Timestamp(kEpoch + id));
+		ASSERT_EQ(tags[id] == tags[0], tag_eq.Matches(r.Buffer()));
+	}
+	ASSERT_EQ(N, n);
+	unlink(path);
+	printf("stored and ordered every column type correctly\n");
+}
+
+//a composite key value: (region ascending, day descending, id ascending)
+struct composite_key {
+	std::string region;
+	int day;
+	int64_t id;
+	bool operator<(const composite_key &o) const {
+		if (region != o.region)
+			return region < o.region;
+		if (day != o.day)
+			return day > o.day;
+		return id < o.id;
+	}
+};
+
+TEST(MemdbTest, CompositeKey) {
+	const int N = 20000;
+	std::string cnames[4] = { "region", "day", "id", "score" };
+	column_t ctypes[4] = { cString, cInt32, cInt64, cDouble };
+	TableSchema schema(4, cnames, ctypes, "id");
+	std::vector<std::string> key;
+	key.push_back("region");
+	key.push_back("day");
+	key.push_back("id");
+	std::vector<bool> descending(3, false);
+	descending[1] = true;
+	schema.SetKey(key, descending);
+	int score_index = schema.AddIndex("score");
+	ASSERT_EQ(5, schema.NumColumns());
+	ASSERT_EQ(4, schema.GetIndexNumber());
+	ASSERT_EQ(4, schema.GetPrimaryNumber());
+	ASSERT_EQ(0, schema.GetIndexPos());
+
+	//regions that are prefixes of each other or hold NULs
+	std::string regions[6] = { "", "a", std::string("a\0", 2),
+			std::string("a\0b", 3), "ab", "a long region name past inline" };
+	MemTableOptions options;
+	options.hash_index = true;
+	MemTable table(&schema, options);
+	std::map<composite_key, double> expected;
+	for (int i = 0; i < N; i++) {
+		composite_key k;
+		k.region = regions[random() % 6];
+		k.day = random() % 11 - 5;
+		k.id = (int64_t) (random() % 1000) - 500;
+		double score = (random() % 2000) / 8.0;
+		RwRow r(&table);
+		r << k.region << k.day << k.id << score;
+		table.InsertRow(r);
+		expected[k] = score;
+	}
+	ASSERT_EQ(expected.size(), table.Size());
+
+	MemTable::Iterator it(&table);
+	RdOnlyRow r(&table);
+	std::map<composite_key, double>::iterator e = expected.begin();
+	for (it.SeekToFirst(); it.Valid(); it.Next(), ++e) {
+		ASSERT_TRUE(e != expected.end());
+		r = it.RowAt(r);
+		ASSERT_EQ(e->first.region, r.GetSliceColumn(0).ToString());
+		ASSERT_EQ(e->first.day, r.GetIntColumn(1));
+		ASSERT_EQ(e->first.id, r.GetInt64Column(2));
+		ASSERT_TRUE(e->second == r.GetDoubleColumn(3));
+	}
+	ASSERT_TRUE(e == expected.end());
+
+	//a key of the first two columns is a prefix of the keys that start
+	//with them
+	for (int i = 0; i < 100; i++) {
+		composite_key k;
+		k.region = regions[i % 6];
+		k.day = i % 11 - 5;
+		k.id = INT64_MIN;
+		KeyBuilder prefix(&schema);
+		prefix.Add(Slice(k.region)).Add(k.day);
+		it.Seek(prefix.Key());
+		e = expected.lower_bound(k);
+		if (e == expected.end()) {
+			ASSERT_TRUE(!it.Valid());
+			continue;
+		}
+		ASSERT_TRUE(it.Valid());
+		r = it.RowAt(r);
+		ASSERT_EQ(e->first.region, r.GetSliceColumn(0).ToString());
+		ASSERT_EQ(e->first.day, r.GetIntColumn(1));
+		ASSERT_EQ(e->first.id, r.GetInt64Column(2));
+		//and scanning while ValidPrefix visits every row that does
+		size_t want = 0;
+		for (; e != expected.end() && e->first.region == k.region
+				&& e->first.day == k.day; ++e)
+			want++;
+		size_t got = 0;
+		for (; it.ValidPrefix(prefix.Key()); it.Next(), got++) {
+			r = it.RowAt(r);
+			ASSERT_EQ(k.region, r.GetSliceColumn(0).ToString());
+			ASSERT_EQ(k.day, r.GetIntColumn(1));
+		}
+		ASSERT_EQ(want, got);
+	}
+
+	//point operations take the full key as both index and primary
+	e = expected.begin();
+	for (int i = 0; i < 1000; i++, ++e) {
+		KeyBuilder k(&schema);
+		k.Add(Slice(e->first.region)).Add(e->first.day).Add(e->first.id);
+		ASSERT_TRUE(table.Get(k.Key(), k.Key(), &r));
+		ASSERT_TRUE(e->second == r.GetDoubleColumn(3));
+		//the columns of the key would move the row
+		ASSERT_TRUE(!table.UpdateColumn(k.Key(), k.Key(), 1,
+				e->first.day + 1));
+		ASSERT_TRUE(!table.UpdateColumn(k.Key(), k.Key(), 0, Slice("zz")));
+		ASSERT_TRUE(table.Get(k.Key(), k.Key(), &r));
+		ASSERT_EQ(e->first.day, r.GetIntColumn(1));
+		if (i % 2) {
+			ASSERT_TRUE(table.UpdateColumn(k.Key(), k.Key(), 3, -1.0));
+			e->second = -1.0;
+		} else {
+			ASSERT_TRUE(table.Delete(k.Key(), k.Key()));
+			ASSERT_TRUE(!table.Get(k.Key(), k.Key(), &r));
+		}
+	}
+	size_t left = expected.size() - 500;
+	ASSERT_EQ(left, table.Size());
+
+	MemTable::Iterator sit(&table, score_index);
+	double last = -2.0;
+	size_t n = 0;
+	for (sit.SeekToFirst(); sit.Valid(); sit.Next(), n++) {
+		r = sit.RowAt(r);
+		ASSERT_TRUE(r.GetDoubleColumn(3) >= last);
+		last = r.GetDoubleColumn(3);
+	}
+	ASSERT_EQ(left, n);
+	printf("ordered %d rows by a composite key correctly\n", (int) left);
+}
+
+//Seek(key) lands before every row with the key, whatever their primaries,
+//also for probes too wide for the stack
+TEST(MemdbTest, SeekProbe) {
+	for (int wide = 0; wide < 2; wide++) {
+		std::vector<std::string> cnames;
+		std::vector<column_t> ctypes;
+		std::vector<int> widths;
+		cnames.push_back("key");
+		ctypes.push_back(cString);
+		widths.push_back(0);
+		cnames.push_back("primary");
+		ctypes.push_back(cInt32);
+		widths.push_back(0);
+		cnames.push_back("blob");
+		ctypes.push_back(cBinary);
+		widths.push_back(wide ? 1000 : 8);
+		TableSchema schema(cnames, ctypes, widths, "primary");
+		MemTable table(&schema);
+		for (int k = 0; k < 10; k++) {
+			for (int p = -3; p <= 3; p++) {
+				RwRow r(&table);
+				r << std::string("key") + std::to_string(k) << p << Slice("b");
+				ASSERT_TRUE(table.InsertRow(r));
+			}
+		}
+		MemTable::Iterator it(&table);
+		RdOnlyRow r(&table);
+		it.Seek(Slice("key4"));
+		ASSERT_TRUE(it.Valid(Slice("key4")));
+		ASSERT_TRUE(!it.Valid(Slice("key3")));
+		r = it.RowAt(r);
+		ASSERT_EQ(-3, r.GetIntColumn(1));
+		it.Seek(std::string("key4"), 1);
+		ASSERT_TRUE(it.Valid(std::string("key4"), 1));
+		ASSERT_TRUE(!it.Valid(std::string("key4"), 0));
+		ASSERT_EQ(1, it.RowAt(r).GetIntColumn(1));
+		it.Seek("key45");
+		ASSERT_EQ("key5", it.RowAt(r).GetSliceColumn(0).ToString());
+		ASSERT_EQ(-3, r.GetIntColumn(1));
+	}
+}
+
+//InsertBatch against InsertRow on the same rows, duplicates included, then
+//the DumpToTable loop against a reused row and against batches
+TEST(MemdbTest, InsertBatch) {
+	const int N = 200000, kBatch = 1000;
+	InitTestRows(N);
+	for (int update = 0; update < 2; update++) {
+		MemTableOptions options;
+		options.hash_index = true;
+		MemTable one(schema_, options), batched(schema_, options);
+		std::vector<RwRow> rows;
+		int taken = 0;
+		for (int i = 0; i < 20000; i++) {
+			//every key three times over, with a different payload
+			test_row &t = allrows_[i % 5000];
+			std::string payload = std::to_string(i);
+			RwRow r(&one);
+			r << t.from_id << payload << t.to_id << *t.to_name;
+			one.InsertRow(r, update);
+			rows.push_back(RwRow(&batched));
+			rows.back() << t.from_id << payload << t.to_id << *t.to_name;
+			if (rows.size() == 700) {
+				taken += batched.InsertBatch(rows.begin(), rows.end(), update);
+				rows.clear();
+			}
+		}
+		taken += batched.InsertBatch(rows.begin(), rows.end(), update);
+		ASSERT_EQ(update ? 20000 : 5000, taken);
+		ASSERT_EQ(one.Size(), batched.Size());
+		MemTable::Iterator a(&one), b(&batched);
+		RdOnlyRow ra(&one), rb(&batched);
+		for (a.SeekToFirst(), b.SeekToFirst(); a.Valid(); a.Next(), b.Next()) {
+			ASSERT_TRUE(b.Valid());
+			a.RowAt(ra);
+			b.RowAt(rb);
+			for (int c = 0; c < 4; c += 2)
+				ASSERT_EQ(ra.GetIntColumn(c), rb.GetIntColumn(c));
+			ASSERT_EQ(std::string(ra.GetStrColumn(1)),
+					std::string(rb.GetStrColumn(1)));
+			ASSERT_TRUE(batched.Get(rb.GetIntColumn(0), rb.GetIntColumn(2),
+					&ra));
+			ASSERT_EQ(rb.Buffer(), ra.Buffer());
+		}
+		ASSERT_TRUE(!b.Valid());
+	}
+
+	//a refused row keeps its buffer for the next one
+	{
+		RwRow r(table_);
+		r << allrows_[0].from_id << *allrows_[0].from_name
+				<< allrows_[0].to_id << *allrows_[0].to_name;
+		ASSERT_TRUE(table_->InsertRow(r));
+		ASSERT_TRUE(r.Buffer() == NULL);
+		r.Reset();
+		r << allrows_[0].from_id << *allrows_[0].from_name
+				<< allrows_[0].to_id << *allrows_[0].to_name;
+		char *buf = r.Buffer();
+		ASSERT_TRUE(!table_->InsertRow(r, false));
+		r.Reset();
+		ASSERT_EQ(buf, r.Buffer());
+		ASSERT_EQ(0, (int) r.GetSliceColumn(1).size());
+		RwRow moved(std::move(r));
+		ASSERT_EQ(buf, moved.Buffer());
+		ASSERT_TRUE(r.Buffer() == NULL);
+	}
+
+	//rows reused one at a time and in batches, against DumpToTable
+	MemTable one(schema_), batched(schema_);
+	DumpToTable(N);
+	RwRow r(&one);
+	for (int i = 0; i < N; i++) {
+		r.Reset();
+		r << allrows_[i].from_id << *(allrows_[i].from_name)
+				<< allrows_[i].to_id << *(allrows_[i].to_name);
+		ASSERT_TRUE(one.InsertRow(r));
+	}
+	std::vector<RwRow> batch;
+	for (int i = 0; i < kBatch; i++)
+		batch.push_back(RwRow(&batched));
+	for (int i = 0; i < N; i += kBatch) {
+		for (int j = 0; j < kBatch; j++) {
+			batch[j].Reset();
+			test_row &t = allrows_[i + j];
+			batch[j] << t.from_id << *t.from_name << t.to_id << *t.to_name;
+		}
+		ASSERT_EQ(kBatch,
+				batched.InsertBatch(batch.begin(), batch.end()));
+	}
+	ASSERT_EQ(N, (int) table_->Size());
+	ASSERT_EQ(N, (int) one.Size());
+	ASSERT_EQ(N, (int) batched.Size());
+
+	//keys that arrive in order, past the end of a full table, go in next
+	//to the row before them
+	for (int i = 0; i < N; i += kBatch) {
+		for (int j = 0; j < kBatch; j++) {
+			batch[j].Reset();
+			test_row &t = allrows_[i + j];
+			batch[j] << 1000000 + i + j << *t.from_name << t.to_id
+					<< *t.to_name;
+		}
+		ASSERT_EQ(kBatch,
+				batched.InsertBatch(batch.begin(), batch.end()));
+	}
+	ASSERT_EQ(2 * N, (int) batched.Size());
+
+	MemTable::Iterator d(table_), o(&one), b(&batched);
+	RdOnlyRow rd(table_), ro(&one), rb(&batched);
+	for (; d.Valid(); d.Next(), o.Next(), b.Next()) {
+		ASSERT_TRUE(o.Valid() && b.Valid());
+		d.RowAt(rd);
+		o.RowAt(ro);
+		b.RowAt(rb);
+		for (int c = 0; c < 4; c += 2) {
+			ASSERT_EQ(rd.GetIntColumn(c), ro.GetIntColumn(c));
+			ASSERT_EQ(rd.GetIntColumn(c), rb.GetIntColumn(c));
+		}
+		for (int c = 1; c < 4; c += 2) {
+			ASSERT_EQ(std::string(rd.GetStrColumn(c)), ro.GetStrColumn(c));
+			ASSERT_EQ(std::string(rd.GetStrColumn(c)), rb.GetStrColumn(c));
+		}
+	}
+	ASSERT_TRUE(!o.Valid());
+	for (int i = 0; i < N; i++, b.Next()) {
+		ASSERT_TRUE(b.Valid());
+		b.RowAt(rb);
+		ASSERT_EQ(1000000 + i, rb.GetIntColumn(0));
+		ASSERT_EQ(*allrows_[i].to_name, rb.GetStrColumn(3));
+	}
+	ASSERT_TRUE(!b.Valid());
+}
+
+TEST(MemdbTest, Dictionary) {
+	const int N = 1000000, kNames = 5000;
+	InitTestRows(N);
+	std::vector<std::string> names;
+	std::set<std::string> interned; //the ones too long to stay in a row
+	for (int i = 0; i < kNames; i++) {
+		names.push_back("user" + test::RandomStr(20));
+		if (names.back().size() >= StrColumn::kInline)
+			interned.insert(names.back());
+	}
+	std::vector<int> from(N), to(N);
+	for (int i = 0; i < N; i++) {
+		from[i] = random() % kNames;
+		to[i] = random() % kNames;
+	}
+
+	size_t bytes[2];
+	for (int dict = 0; dict < 2; dict++) {
+		std::string cnames[4] = { "from_id", "from_name", "to_id", "to_name" };
+		column_t ctypes[4] = { cInt32, cString, cInt32, cString };
+		TableSchema schema(4, cnames, ctypes, "to_id");
+		int by_name = schema.AddIndex("to_name");
+		if (dict) {
+			schema.EnableDictionary("from_name");
+			schema.EnableDictionary("to_name");
+		}
+		MemTable table(&schema);
+		for (int i = 0; i < N; i++) {
+			RwRow r(&table);
+			r << allrows_[i].from_id << names[from[i]] << allrows_[i].to_id
+					<< names[to[i]];
+			ASSERT_TRUE(table.InsertRow(r));
+		}
+		MemTableStats s = table.GetStats();
+		ASSERT_EQ(s.row_bytes + s.string_bytes + s.index_bytes,
+				table.ApproximateMemoryUsage());
+		bytes[dict] = table.ApproximateMemoryUsage() + s.dict_bytes;
+		printf("%d rows %s dictionaries: %zu row, %zu string, %zu dictionary "
+				"bytes\n", N, dict ? "with" : "without", s.row_bytes,
+				s.string_bytes, s.dict_bytes);
+		if (dict) {
+			ASSERT_EQ(0u, s.string_bytes);
+			ASSERT_EQ(interned.size(), schema.GetDictionary(3)->Size());
+			ASSERT_TRUE(schema.GetDictionary(0) == NULL);
+		}
+
+		//the same values, the same order
+		RdOnlyRow r(&table);
+		MemTable::Iterator it(&table, by_name);
+		std::map<std::string, const char *> seen;
+		std::string last;
+		int n = 0;
+		for (it.SeekToFirst(); it.Valid(); it.Next(), n++) {
+			it.RowAt(r);
+			std::string name = r.GetStrColumn(3);
+			ASSERT_TRUE(last <= name);
+			last = name;
+			if (dict && name.size() >= StrColumn::kInline) {
+				const char *&p = seen[name];
+				ASSERT_TRUE(p == NULL || p == r.GetStrColumn(3));
+				p = r.GetStrColumn(3);
+			}
+		}
+		ASSERT_EQ(N, n);
+
+		//updates, replacements and deletes leave the interned copies be
+		for (int i = 0; i < 1000; i++) {
+			test_row &t = allrows_[i];
+			ASSERT_TRUE(table.UpdateColumn(t.from_id, t.to_id, 1,
+					names[to[i]]));
+			RwRow w(&table);
+			w << t.from_id << names[from[i]] << t.to_id << names[i];
+			ASSERT_TRUE(table.InsertRow(w));
+			ASSERT_TRUE(table.Delete(allrows_[N - 1 - i].from_id,
+					allrows_[N - 1 - i].to_id));
+		}
+		MemTable::Iterator main(&table);
+		for (int i = 0; i < 1000; i++) {
+			test_row &t = allrows_[i];
+			main.Seek(t.from_id, t.to_id);
+			ASSERT_TRUE(main.Valid(t.from_id, t.to_id));
+			main.RowAt(r);
+			ASSERT_EQ(names[from[i]], r.GetStrColumn(1));
+			ASSERT_EQ(names[i], r.GetStrColumn(3));
+		}
+		ASSERT_EQ(N - 1000, (int) table.Size());
+	}
+	printf("dictionaries save %zu of %zu bytes\n", bytes[0] - bytes[1],
+			bytes[0]);
+	ASSERT_TRUE(bytes[1] < bytes[0]);
+}
+
+//more readers than an epoch manager starts out with slots for, on one
+//thread, which would wait on itself for a slot to free up
+TEST(MemdbTest, ManyIterators) {
+	const int N = 1000, kIterators = 300;
+	InitTestRows(N);
+	MemTableOptions options;
+	options.concurrent = true;
+	MemTable table(schema_, options);
+	for (int i = 0; i < N; i++) {
+		RwRow r(&table);
+		r << allrows_[i].from_id << *allrows_[i].from_name
+				<< allrows_[i].to_id << *allrows_[i].to_name;
+		ASSERT_TRUE(table.InsertRow(r));
+	}
+	std::vector<MemTable::Iterator *> its;
+	for (int i = 0; i < kIterators; i++) {
+		test_row &t = allrows_[i % N];
+		its.push_back(new MemTable::Iterator(&table));
+		its.back()->Seek(t.from_id, t.to_id);
+		its.push_back(new MemTable::Iterator(*its.back()));
+	}
+	//the rows replaced under the iterators are retired, not freed
+	for (int i = 0; i < N; i++) {
+		RwRow r(&table);
+		r << allrows_[i].from_id << std::string("replaced")
+				<< allrows_[i].to_id << *allrows_[i].to_name;
+		ASSERT_TRUE(table.InsertRow(r));
+	}
+	RdOnlyRow r(&table);
+	for (size_t i = 0; i < its.size(); i++) {
+		test_row &t = allrows_[i / 2 % N];
+		ASSERT_TRUE(its[i]->Valid(t.from_id, t.to_id));
+		ASSERT_EQ(*t.to_name, its[i]->RowAt(r).GetStrColumn(3));
+		delete its[i];
+	}
+	MemTable::Iterator it(&table);
+	ASSERT_TRUE(it.Valid());
+}
+
 TEST(MemdbTest, QuerySmall) {
 	const int N = 5;
 	allrows_ = (test_row *) malloc(sizeof(test_row) * 5);
@@ -193,6 +2114,142 @@ TEST(MemdbTest, QuerySmall) {
 	printf("querying a small table correctly\n");
 }
 
+TEST(MemdbTest, UpdateAndReverse) {
+	const int N = 10000;
+	//insert in scrambled order so that leaves split all over the tree
+	for (int i = 0; i < N; i++) {
+		int k = (i * 7919) % N;
+		RwRow r(table_);
+		r << k / 10 << std::string("old") << k % 10 << std::string("x");
+		ASSERT_TRUE(table_->InsertRow(r));
+	}
+	for (int i = 0; i < N; i++) {
+		RwRow r(table_);
+		r << i / 10 << std::string("new") << i % 10 << std::string("y");
+		ASSERT_TRUE(!table_->InsertRow(r, false));
+		ASSERT_TRUE(table_->InsertRow(r, true));
+	}
+
+	MemTable::Iterator it(table_);
+	RdOnlyRow r(table_);
+	int i = N;
+	for (it.SeekToLast(); it.Valid(); it.Prev()) {
+		i--;
+		r = it.RowAt(r);
+		ASSERT_EQ(i / 10, r.GetIntColumn(0));
+		ASSERT_EQ(i % 10, r.GetIntColumn(2));
+		ASSERT_EQ(std::string("new"), r.GetStrColumn(1));
+	}
+	ASSERT_EQ(0, i);
+
+	it.Seek(N / 20, 5);
+	ASSERT_TRUE(it.Valid(N / 20, 5));
+	r = it.RowAt(r);
+	ASSERT_EQ(N / 20, r.GetIntColumn(0));
+	ASSERT_EQ(5, r.GetIntColumn(2));
+	printf("updated and reverse scanned %d rows correctly\n", N);
+}
+
+TEST(MemdbTest, ZeroCopyColumns) {
+	const int N = 1000;
+	for (int i = 0; i < N; i++) {
+		RwRow r(table_);
+		r << i << std::string(i % 30, 'a' + i % 26) << -i
+				<< test::RandomStr(20);
+		table_->InsertRow(r);
+	}
+
+	ColumnRef<int> from_id = schema_->GetColumnRef<int>(0);
+	ColumnRef<Slice> from_name = schema_->GetColumnRef<Slice>(1);
+	MemTable::Iterator it(table_);
+	RdOnlyRow r(table_);
+	int i = 0;
+	for (it.SeekToFirst(); it.Valid(); it.Next(), i++) {
+		r = it.RowAt(r);
+		ASSERT_EQ(i, r.Get(from_id));
+		Slice name = r.Get(from_name);
+		ASSERT_EQ(std::string(i % 30, 'a' + i % 26), name.ToString());
+		ASSERT_TRUE(name == r.GetSliceColumn(1));
+		ASSERT_EQ(name.data(), r.GetStrColumn(1));
+		if (name.size() < StrColumn::kInline) {
+			//short strings are read straight out of the row buffer
+			ASSERT_TRUE(name.data() > r.Buffer());
+			ASSERT_TRUE(name.data() < r.Buffer() + schema_->GetColumnPos(1)
+					+ StrColumn::kSize);
+		}
+	}
+	ASSERT_EQ(N, i);
+
+	it.Seek(N / 2, -N / 2);
+	ASSERT_TRUE(it.Valid(N / 2, -N / 2));
+	r = it.RowAt(r);
+	ASSERT_EQ(N / 2, r.Get(from_id));
+	ASSERT_TRUE(r.Get(from_name) < Slice("zz"));
+}
+
+//a key column value, only the field matching the column type is used
+struct key_val {
+	int i;
+	std::string s;
+	bool operator<(const key_val &o) const {
+		return i < o.i || (i == o.i && s < o.s);
+	}
+};
+
+TEST(MemdbTest, KeyTypes) {
+	const int N = 20000;
+	column_t types[2] = { cInt32, cString };
+	for (int a = 0; a < 2; a++) {
+		for (int b = 0; b < 2; b++) {
+			std::string cnames[3] = { "key", "primary", "payload" };
+			column_t ctypes[3] = { types[a], types[b], cInt32 };
+			TableSchema schema(3, cnames, ctypes, "primary");
+			MemTable table(&schema);
+			std::set<std::pair<key_val, key_val> > expected;
+			for (int i = 0; i < N; i++) {
+				key_val k[2];
+				RwRow r(&table);
+				for (int c = 0; c < 2; c++) {
+					k[c].i = 0;
+					if (ctypes[c] == cInt32) {
+						k[c].i = (random() % 2000) - 1000;
+						r.PutColumn(k[c].i, c);
+					} else {
+						//shared prefixes force comparisons past the inline bytes
+						k[c].s = std::string(random() % 2 ? "user_" : "")
+								+ test::RandomStr(20);
+						r.PutColumn(k[c].s, c);
+					}
+				}
+				r.PutColumn(i, 2);
+				expected.insert(std::make_pair(k[0], k[1]));
+				ASSERT_TRUE(table.InsertRow(r));
+			}
+
+			MemTable::Iterator it(&table);
+			RdOnlyRow r(&table);
+			std::set<std::pair<key_val, key_val> >::iterator e =
+					expected.begin();
+			for (it.SeekToFirst(); it.Valid(); it.Next(), ++e) {
+				ASSERT_TRUE(e != expected.end());
+				r = it.RowAt(r);
+				key_val k[2];
+				for (int c = 0; c < 2; c++) {
+					k[c].i = 0;
+					if (ctypes[c] == cInt32)
+						k[c].i = r.GetIntColumn(c);
+					else
+						k[c].s = r.GetStrColumn(c);
+				}
+				ASSERT_TRUE(!(k[0] < e->first) && !(e->first < k[0]));
+				ASSERT_TRUE(!(k[1] < e->second) && !(e->second < k[1]));
+			}
+			ASSERT_TRUE(e == expected.end());
+		}
+	}
+	printf("ordered all key type combinations correctly\n");
+}
+
 TEST(MemdbTest, QueryBig) {
 	const int N = 1000000;
 	InitTestRows(N);
@@ -228,7 +2285,36 @@ TEST(MemdbTest, QueryBig) {
 
 	}
 	clock_gettime(CLOCK_REALTIME, &end);
-	printf("%lu usec per query\n", test::timediff(&end, &start) / NUM_QUERIES);
+	long seq = test::timediff(&end, &start);
+	printf("%lu usec per query\n", seq / NUM_QUERIES);
+
+	//the same number of lookups, interleaved
+	std::vector<int> from(NUM_QUERIES), to(NUM_QUERIES);
+	for (int i = 0; i < NUM_QUERIES; i++) {
+		int x = random() % N;
+		from[i] = allrows_[x].from_id;
+		to[i] = allrows_[x].to_id;
+	}
+	std::vector<RdOnlyRow> rows(NUM_QUERIES, RdOnlyRow(table_));
+	clock_gettime(CLOCK_REALTIME, &start);
+	ASSERT_EQ((size_t) NUM_QUERIES, table_->MultiSeek(from.data(), to.data(),
+			NUM_QUERIES, rows.data()));
+	clock_gettime(CLOCK_REALTIME, &end);
+	long batched = test::timediff(&end, &start);
+	for (int i = 0; i < NUM_QUERIES; i++) {
+		ASSERT_EQ(from[i], rows[i].GetIntColumn(0));
+		ASSERT_EQ(to[i], rows[i].GetIntColumn(2));
+	}
+	printf("MultiSeek: %ld usec for %d queries, %.1fx sequential Seek\n",
+			batched, NUM_QUERIES, (double) seq / (batched ? batched : 1));
+
+	//keys that are absent land on the next row, or past the end
+	int last = allrows_[N - 1].from_id;
+	int probe[3] = { INT_MIN, last, INT_MAX };
+	int prim[3] = { INT_MIN, INT_MAX, 0 };
+	ASSERT_EQ(0u, table_->MultiSeek(probe, prim, 3, rows.data()));
+	ASSERT_EQ(allrows_[0].from_id, rows[0].GetIntColumn(0));
+	ASSERT_TRUE(rows[1].Buffer() == NULL && rows[2].Buffer() == NULL);
 }
 
 } //namespace memdb
@@ -7,44 +7,773 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <algorithm>
 #include <string>
+#include <set>
 #include <assert.h>
-#include <map>
+#include <limits.h>
+#include <stdint.h>
 #include "db/memtable.h"
+#include "db/btree.h"
+#include "db/skiplist.h"
+#include "db/comparator.h"
+#include "db/hashindex.h"
+#include "db/checkpoint.h"
+#include "db/rowformat.h"
+#include "util/epoch.h"
 
 namespace memdb {
 
 bool RowCompare::operator()(char * const r1, char * const r2) const {
-	RdOnlyRow::LessThan(r1,r2,s_);
+	return RdOnlyRow::LessThan(r1, r2, s_);
 }
 
-MemTable::MemTable(TableSchema *schema) :
-		schema_(schema) {
-	RowCompare compr(schema_);
-	content_ = new std::map<char *, int, RowCompare>(compr);
-	assert(content_);
+//The key types the comparators are specialized for, a timestamp being an
+//int64; keys of other types go through the generic comparators
+static column_t KeyKind(column_t t) {
+	return t == cTimestamp ? cInt64 : t;
 }
 
+static bool Specialized(column_t t) {
+	t = KeyKind(t);
+	return t == cInt32 || t == cInt64 || t == cString;
+}
+
+template<class Base, template<class > class Index, column_t I, column_t P,
+		class ... Args>
+static Base *NewIndexFor(int ipos, int ppos, Args ... args) {
+	return new Index<RowCompareT<I, P> >(RowCompareT<I, P>(ipos, ppos),
+			args...);
+}
+
+template<class Base, template<class > class Index, column_t I, class ... Args>
+static Base *NewIndexOn(column_t ptype, int ipos, int ppos, Args ... args) {
+	switch (KeyKind(ptype)) {
+	case cInt32:
+		return NewIndexFor<Base, Index, I, cInt32>(ipos, ppos, args...);
+	case cInt64:
+		return NewIndexFor<Base, Index, I, cInt64>(ipos, ppos, args...);
+	default:
+		return NewIndexFor<Base, Index, I, cString>(ipos, ppos, args...);
+	}
+}
+
+//Picks the comparator specialization for the key types once, so the index
+//never dispatches on column types while it searches
+template<template<class > class Index, class Base = RowIndex, class ... Args>
+static Base *NewRowIndex(TableSchema *s, Args ... args) {
+	column_t itype = s->GetIndexType(), ptype = s->GetPrimaryType();
+	int ipos = s->GetIndexPos(), ppos = s->GetPrimaryPos();
+	if (s->HasCompositeKey())
+		return new Index<EncodedKeyCompare>(EncodedKeyCompare(ipos), args...);
+	if (!Specialized(itype) || !Specialized(ptype))
+		return new Index<RowCompareAny>(RowCompareAny(s), args...);
+	switch (KeyKind(itype)) {
+	case cInt32:
+		return NewIndexOn<Base, Index, cInt32>(ptype, ipos, ppos, args...);
+	case cInt64:
+		return NewIndexOn<Base, Index, cInt64>(ptype, ipos, ppos, args...);
+	default:
+		return NewIndexOn<Base, Index, cString>(ptype, ipos, ppos, args...);
+	}
+}
+
+template<template<class > class Index, column_t S, column_t P, column_t I,
+		class ... Args>
+static RowIndex *NewSecondaryFor(int spos, int ppos, int ipos,
+		Args ... args) {
+	typedef SecondaryCompareT<S, P, I> Compare;
+	return new Index<Compare>(Compare(spos, ppos, ipos), args...);
+}
+
+template<template<class > class Index, column_t S, column_t P,
+		class ... Args>
+static RowIndex *NewSecondaryWith(int spos, int ppos, column_t itype,
+		int ipos, Args ... args) {
+	switch (KeyKind(itype)) {
+	case cInt32:
+		return NewSecondaryFor<Index, S, P, cInt32>(spos, ppos, ipos, args...);
+	case cInt64:
+		return NewSecondaryFor<Index, S, P, cInt64>(spos, ppos, ipos, args...);
+	default:
+		return NewSecondaryFor<Index, S, P, cString>(spos, ppos, ipos, args...);
+	}
+}
+
+template<template<class > class Index, column_t S, class ... Args>
+static RowIndex *NewSecondaryOn(int spos, column_t ptype, int ppos,
+		column_t itype, int ipos, Args ... args) {
+	switch (KeyKind(ptype)) {
+	case cInt32:
+		return NewSecondaryWith<Index, S, cInt32>(spos, ppos, itype, ipos,
+				args...);
+	case cInt64:
+		return NewSecondaryWith<Index, S, cInt64>(spos, ppos, itype, ipos,
+				args...);
+	default:
+		return NewSecondaryWith<Index, S, cString>(spos, ppos, itype, ipos,
+				args...);
+	}
+}
+
+template<template<class > class Index, class ... Args>
+static RowIndex *NewSecondaryIndex(TableSchema *s, int index, Args ... args) {
+	column_t stype = s->GetIndexType(index), ptype = s->GetPrimaryType();
+	column_t itype = s->GetIndexType();
+	int spos = s->GetIndexPos(index), ppos = s->GetPrimaryPos();
+	int ipos = s->GetIndexPos();
+	if (!Specialized(stype) || !Specialized(ptype) || !Specialized(itype))
+		return new Index<SecondaryCompareAny>(SecondaryCompareAny(s, index),
+				args...);
+	switch (KeyKind(stype)) {
+	case cInt32:
+		return NewSecondaryOn<Index, cInt32>(spos, ptype, ppos, itype, ipos,
+				args...);
+	case cInt64:
+		return NewSecondaryOn<Index, cInt64>(spos, ptype, ppos, itype, ipos,
+				args...);
+	default:
+		return NewSecondaryOn<Index, cString>(spos, ptype, ppos, itype, ipos,
+				args...);
+	}
+}
+
+MemTable::MemTable(TableSchema *schema, const MemTableOptions &options) :
+		schema_(schema), options_(options), hash_(NULL), epoch_(NULL),
+		wal_(NULL), checkpoint_(NULL), seq_(0), tombstones_(0), row_bytes_(0),
+		string_bytes_(0) {
+	if (options_.snapshots)
+		assert(options_.concurrent && schema_->GetVersionPos() >= 0);
+	if (options_.concurrent) {
+		assert(schema_->GetArena() == NULL);
+		assert(!options_.hash_index);
+		epoch_ = new EpochManager;
+	}
+	if (options_.hash_index)
+		hash_ = NewRowIndex<OpenHashIndex, HashIndex>(schema_);
+	nindexes_ = schema_->NumIndexes();
+	indexes_ = new std::atomic<RowIndex *>[nindexes_];
+	for (int i = 0; i < nindexes_; i++)
+		indexes_[i].store(NewIndex(i));
+	if (!options_.wal_path.empty()) {
+		wal_ = new Wal(options_.wal_path, options_.wal_sync,
+				options_.wal_sync_ms);
+		bool ok = wal_->Open([this](const Slice &record) {
+			Replay(record);
+		});
+		assert(ok);
+	}
+}
+
+MemTable::~MemTable() {
+	//the rows go, the log stays for the next table opened over it
+	assert(snapshots_.empty());
+	delete wal_;
+	if (checkpoint_ == NULL)
+		ApplyClear();
+	delete epoch_;
+	for (int i = 0; i < nindexes_; i++)
+		delete Index(i);
+	delete[] indexes_;
+	delete hash_;
+	delete checkpoint_;
+}
+
+bool MemTable::WriteCheckpoint(const std::string &path) {
+	std::unique_lock<std::mutex> l(write_mu_, std::defer_lock);
+	if (epoch_)
+		l.lock();
+	return memdb::WriteCheckpoint(schema_, Index(), path);
+}
+
+MemTable *MemTable::OpenCheckpoint(TableSchema *schema,
+		const std::string &path, const MemTableOptions &options) {
+	assert(options.wal_path.empty());
+	Checkpoint *ck = new Checkpoint;
+	if (!ck->Open(path, schema)) {
+		delete ck;
+		return NULL;
+	}
+	MemTable *t = new MemTable(schema, options);
+	t->checkpoint_ = ck;
+	delete t->Index();
+	t->indexes_[0].store(NewRowIndex<MappedIndex>(schema,
+			(const Checkpoint *) ck));
+
+	if (t->nindexes_ == 1 && t->hash_ == NULL)
+		return t;
+	//the other indexes point into the mapping as well
+	std::vector<char *> rows;
+	IndexPos p;
+	for (t->Index()->SeekToFirst(&p); p.Valid(); t->Index()->Next(&p))
+		rows.push_back(t->Index()->RowAt(p));
+	for (int i = 1; i < t->nindexes_; i++) {
+		std::vector<char *> batch(rows), none;
+		t->Index(i)->BulkLoad(batch.data(), batch.size(), false, &none);
+	}
+	for (size_t i = 0; t->hash_ && i < rows.size(); i++) {
+		char *old;
+		t->hash_->Insert(rows[i], &old);
+	}
+	return t;
+}
+
+RowIndex *MemTable::NewIndex(int i) {
+	if (i > 0) {
+		if (options_.concurrent)
+			return NewSecondaryIndex<SkipListIndex>(schema_, i, epoch_);
+		return NewSecondaryIndex<BTreeIndex>(schema_, i);
+	}
+	if (options_.concurrent)
+		return NewRowIndex<SkipListIndex>(schema_, epoch_);
+	return NewRowIndex<BTreeIndex>(schema_);
+}
+
+void MemTable::FreeRow(void *table, void *row) {
+	((MemTable *) table)->FreeRowBuffer((char *) row);
+}
+
+void MemTable::FreeIndex(void *table, void *index) {
+	RowIndex *idx = (RowIndex *) index;
+	IndexPos p;
+	for (idx->SeekToFirst(&p); p.Valid(); idx->Next(&p))
+		((MemTable *) table)->FreeRowBuffer(idx->RowAt(p));
+	delete idx;
+}
+
+void MemTable::DeleteIndex(void *table, void *index) {
+	delete (RowIndex *) index;
+}
+
+//Frees a row that has been unlinked from the index, once readers are done
+void MemTable::ReleaseRow(char *row) {
+	if (epoch_)
+		epoch_->Retire(&FreeRow, this, row);
+	else
+		FreeRowBuffer(row);
+}
+
+void MemTable::FreeRowBuffer(char *row) {
+	Uncharge(row);
+	schema_->FreeRowBuffer(row);
+}
+
+/*-----------------memory accounting---------------*/
+//A row is charged when the table takes it over and uncharged when it is
+//freed, so the counters follow the heap rather than the index
+
+size_t MemTable::StringBytes(const char *row) {
+	size_t n = 0;
+	for (int i = 0; i < schema_->NumColumns(); i++) {
+		//a dictionary's strings are counted once, in dict_bytes
+		if (schema_->GetColumnType(i) != cString || schema_->GetDictionary(i))
+			continue;
+		uint32_t len = StrColumn::Length(row + schema_->GetColumnPos(i));
+		if (!StrColumn::IsInline(len))
+			n += len + 1;
+	}
+	return n;
+}
+
+void MemTable::Charge(const char *row) {
+	row_bytes_.fetch_add(schema_->RowSize(), std::memory_order_relaxed);
+	string_bytes_.fetch_add(StringBytes(row), std::memory_order_relaxed);
+}
+
+void MemTable::Uncharge(const char *row) {
+	row_bytes_.fetch_sub(schema_->RowSize(), std::memory_order_relaxed);
+	string_bytes_.fetch_sub(StringBytes(row), std::memory_order_relaxed);
+}
+
+//Clear may retire an index under a concurrent caller, which stays in an
+//epoch until it is done reading it
+size_t MemTable::IndexBytes() {
+	int slot = epoch_ ? epoch_->Enter() : -1;
+	size_t n = hash_ ? hash_->MemoryUsage() : 0;
+	for (int i = 0; i < nindexes_; i++)
+		n += Index(i)->MemoryUsage();
+	if (epoch_)
+		epoch_->Exit(slot);
+	return n;
+}
+
+MemTableStats MemTable::GetStats() {
+	MemTableStats s;
+	s.rows = Size();
+	s.row_bytes = row_bytes_.load(std::memory_order_relaxed);
+	s.string_bytes = string_bytes_.load(std::memory_order_relaxed);
+	s.index_bytes = IndexBytes();
+	s.dict_bytes = schema_->DictionaryBytes();
+	return s;
+}
+
+size_t MemTable::ApproximateMemoryUsage() {
+	return row_bytes_.load(std::memory_order_relaxed)
+			+ string_bytes_.load(std::memory_order_relaxed) + IndexBytes();
+}
+
+//Whether a write that adds bytes may go ahead under options_.memory_limit
+bool MemTable::HasRoom(size_t bytes) {
+	size_t limit = options_.memory_limit;
+	if (limit == 0 || ApproximateMemoryUsage() + bytes <= limit)
+		return true;
+	if (options_.on_memory_limit && options_.on_memory_limit(this))
+		return true;
+	return ApproximateMemoryUsage() + bytes <= limit;
+}
+
+enum RecordType {
+	kInsertRecord = 1, kUpdateRecord = 2, kBulkInsertRecord = 3,
+	kBulkUpdateRecord = 4, kClearRecord = 5, kDeleteRecord = 6,
+	kUpdateColumnRecord = 7
+};
+
+//Columns in schema order: a string as its 4 byte length and its bytes,
+//any other column as its bytes in the row
+void MemTable::EncodeRow(std::string *dst, const char *row) {
+	for (int i = 0; i < schema_->NumColumns(); i++) {
+		const char *col = row + schema_->GetColumnPos(i);
+		if (schema_->GetColumnType(i) != cString) {
+			dst->append(col, schema_->GetColumnSize(i));
+		} else {
+			uint32_t len = StrColumn::Length(col);
+			dst->append((const char *) &len, sizeof(len));
+			dst->append(StrColumn::Data(col), len);
+		}
+	}
+}
+
+bool MemTable::DecodeRow(Slice *in, RwRow *row) {
+	const char *p = in->data(), *limit = p + in->size();
+	for (int i = 0; i < schema_->NumColumns(); i++) {
+		bool str = schema_->GetColumnType(i) == cString;
+		int n = str ? sizeof(uint32_t) : schema_->GetColumnSize(i);
+		if (limit - p < n)
+			return false;
+		if (!str) {
+			memcpy(row->Buffer() + schema_->GetColumnPos(i), p, n);
+			p += n;
+		} else {
+			uint32_t len;
+			memcpy(&len, p, sizeof(len));
+			p += sizeof(len);
+			if ((uint32_t) (limit - p) < len)
+				return false;
+			row->PutColumn(Slice(p, len), i);
+			p += len;
+		}
+	}
+	*in = Slice(p, limit - p);
+	return true;
+}
+
+void MemTable::Replay(const Slice &record) {
+	assert(record.size() > 0);
+	Slice in(record.data() + 1, record.size() - 1);
+	switch (record[0]) {
+	case kInsertRecord:
+	case kUpdateRecord: {
+		RwRow r(this);
+		bool ok = DecodeRow(&in, &r);
+		assert(ok);
+		ApplyInsert(r, record[0] == kUpdateRecord);
+		break;
+	}
+	case kBulkInsertRecord:
+	case kBulkUpdateRecord: {
+		std::vector<RwRow *> rows;
+		while (!in.empty()) {
+			rows.push_back(new RwRow(this));
+			bool ok = DecodeRow(&in, rows.back());
+			assert(ok);
+		}
+		ApplyBulkLoad(rows, record[0] == kBulkUpdateRecord);
+		for (size_t i = 0; i < rows.size(); i++)
+			delete rows[i];
+		break;
+	}
+	case kClearRecord:
+		ApplyClear();
+		break;
+	case kDeleteRecord:
+	case kUpdateColumnRecord: {
+		int colno = 0;
+		if (record[0] == kUpdateColumnRecord) {
+			memcpy(&colno, in.data(), sizeof(colno));
+			in = Slice(in.data() + sizeof(colno), in.size() - sizeof(colno));
+		}
+		RwRow r(this);
+		bool ok = DecodeRow(&in, &r);
+		assert(ok);
+		if (record[0] == kDeleteRecord)
+			ApplyDelete(r.Buffer());
+		else
+			ApplyUpdate(r.Buffer(), colno);
+		break;
+	}
+	default:
+		assert(0);
+	}
+}
+
+//On success the table takes over the row buffer. If a row with the same
+//key exists and update is false, nothing changes and r keeps its buffer.
 bool MemTable::InsertRow(RwRow &r, bool update) {
-	//bool update = true;
-	auto it = content_->lower_bound(r.Buffer());
-	if (it!=content_->end() && RdOnlyRow::LessThan(it->first, r.Buffer(), schema_)) {
-		if (update) {
-			schema_->FreeRowBuffer(it->first);
-			content_->erase(it++);
-		}else {
+	assert(checkpoint_ == NULL);
+	r.EncodeKey();
+	if (!HasRoom(schema_->RowSize() + StringBytes(r.Buffer())))
+		return false;
+	if (wal_ == NULL)
+		return ApplyInsert(r, update);
+	std::string record(1, update ? kUpdateRecord : kInsertRecord);
+	EncodeRow(&record, r.Buffer());
+	bool ok = false;
+	wal_->Write(record, [&]() {
+		ok = ApplyInsert(r, update);
+	});
+	return ok;
+}
+
+bool MemTable::ApplyInsert(RwRow &r, bool update) {
+	std::unique_lock<std::mutex> l(write_mu_, std::defer_lock);
+	if (epoch_)
+		l.lock();
+	return InsertLocked(r, update);
+}
+
+bool MemTable::InsertLocked(RwRow &r, bool update, IndexPos *hint) {
+	if (options_.snapshots) {
+		if (!InsertVersion(r.Buffer(), update))
+			return false;
+		r.ReplaceRowBuffer(NULL);
+		CollectVersions();
+		return true;
+	}
+	char *old = NULL;
+	bool ok = hint ? Index()->InsertNear(hint, r.Buffer(), update, &old) :
+			Index()->Insert(r.Buffer(), update, &old);
+	if (!ok)
+		return false;
+	Charge(r.Buffer());
+	InsertSecondary(r.Buffer(), old);
+	if (hash_) {
+		char *replaced;
+		hash_->Insert(r.Buffer(), &replaced);
+		assert(replaced == old);
+	}
+	r.ReplaceRowBuffer(NULL);
+	if (old)
+		ReleaseRow(old);
+	return true;
+}
+
+//Points the secondary indexes at row, which the main index took in place
+//of old (NULL if it added a new key). The new entry goes in before the old
+//one comes out, so a concurrent reader finds at least one of them.
+void MemTable::InsertSecondary(char *row, char *old) {
+	for (int i = 1; i < nindexes_; i++) {
+		RowIndex *index = Index(i);
+		char *replaced = NULL;
+		index->Insert(row, true, &replaced);
+		if (old && replaced != old) {
+			//the indexed column changed, the old entry is elsewhere
+			assert(replaced == NULL);
+			index->Remove(old, &replaced);
+			assert(replaced == old);
+		}
+	}
+}
+
+//Readies a batch for BulkLoad or InsertBatch, false if it does not fit
+bool MemTable::CheckBatch(const std::vector<RwRow *> &rows) {
+	assert(checkpoint_ == NULL);
+	for (size_t i = 0; i < rows.size(); i++)
+		rows[i]->EncodeKey();
+	if (options_.memory_limit) {
+		size_t bytes = 0;
+		for (size_t i = 0; i < rows.size(); i++)
+			bytes += schema_->RowSize() + StringBytes(rows[i]->Buffer());
+		return HasRoom(bytes);
+	}
+	return true;
+}
+
+int MemTable::BulkLoadRows(const std::vector<RwRow *> &rows, bool update) {
+	if (!CheckBatch(rows))
+		return 0;
+	if (wal_ == NULL)
+		return ApplyBulkLoad(rows, update);
+	std::string record(1, update ? kBulkUpdateRecord : kBulkInsertRecord);
+	for (size_t i = 0; i < rows.size(); i++)
+		EncodeRow(&record, rows[i]->Buffer());
+	int taken = 0;
+	wal_->Write(record, [&]() {
+		taken = ApplyBulkLoad(rows, update);
+	});
+	return taken;
+}
+
+//Logged as a bulk load, whose replay has the same outcome
+int MemTable::InsertBatchRows(const std::vector<RwRow *> &rows, bool update) {
+	if (!CheckBatch(rows))
+		return 0;
+	if (wal_ == NULL)
+		return ApplyInsertBatch(rows, update);
+	std::string record(1, update ? kBulkUpdateRecord : kBulkInsertRecord);
+	for (size_t i = 0; i < rows.size(); i++)
+		EncodeRow(&record, rows[i]->Buffer());
+	int taken = 0;
+	wal_->Write(record, [&]() {
+		taken = ApplyInsertBatch(rows, update);
+	});
+	return taken;
+}
+
+//A stable sort keeps rows with the same key in batch order, so the last
+//one wins as it would have through InsertRow. Hints are only good while
+//nothing leaves the main index, which snapshots may do between inserts.
+int MemTable::ApplyInsertBatch(const std::vector<RwRow *> &rows,
+		bool update) {
+	RowIndex *index = Index();
+	std::vector<std::pair<uint64_t, RwRow *> > sorted(rows.size());
+	for (size_t i = 0; i < rows.size(); i++)
+		sorted[i] = std::make_pair(index->KeyPrefix(rows[i]->Buffer()), rows[i]);
+	std::stable_sort(sorted.begin(), sorted.end(),
+			[this](const std::pair<uint64_t, RwRow *> &a,
+					const std::pair<uint64_t, RwRow *> &b) {
+				if (a.first != b.first)
+					return a.first < b.first;
+				return RdOnlyRow::LessThan(a.second->Buffer(),
+						b.second->Buffer(), schema_);
+			});
+	std::unique_lock<std::mutex> l(write_mu_, std::defer_lock);
+	if (epoch_)
+		l.lock();
+	IndexPos hint;
+	int taken = 0;
+	for (size_t i = 0; i < sorted.size(); i++) {
+		if (InsertLocked(*sorted[i].second, update,
+				options_.snapshots ? NULL : &hint))
+			taken++;
+	}
+	return taken;
+}
+
+int MemTable::ApplyBulkLoad(const std::vector<RwRow *> &rows, bool update) {
+	if (options_.snapshots) {
+		//every row needs its own version, as from InsertRow
+		std::lock_guard<std::mutex> l(write_mu_);
+		int taken = 0;
+		for (size_t i = 0; i < rows.size(); i++) {
+			if (InsertVersion(rows[i]->Buffer(), update)) {
+				rows[i]->ReplaceRowBuffer(NULL);
+				taken++;
+			}
+		}
+		CollectVersions();
+		return taken;
+	}
+	std::vector<char *> bufs(rows.size());
+	for (size_t i = 0; i < rows.size(); i++)
+		bufs[i] = rows[i]->Buffer();
+	std::vector<char *> displaced;
+	std::unique_lock<std::mutex> l(write_mu_, std::defer_lock);
+	if (epoch_)
+		l.lock();
+	Index()->BulkLoad(bufs.data(), bufs.size(), update, &displaced);
+	if (nindexes_ > 1 || hash_) {
+		//displaced holds table rows, whose secondary entries must go, and
+		//batch rows superseded within the batch, which have none; what the
+		//main index kept goes into the secondary ones as a batch
+		std::set<char *> gone(displaced.begin(), displaced.end());
+		std::vector<char *> kept;
+		for (size_t i = 0; i < bufs.size(); i++) {
+			if (bufs[i] && gone.find(bufs[i]) == gone.end())
+				kept.push_back(bufs[i]);
+		}
+		//every displaced table row shares its key with a kept row
+		for (size_t i = 0; hash_ && i < kept.size(); i++) {
+			char *replaced;
+			hash_->Insert(kept[i], &replaced);
+		}
+		for (int j = 1; j < nindexes_; j++) {
+			RowIndex *index = Index(j);
+			char *old;
+			for (size_t i = 0; i < displaced.size(); i++)
+				index->Remove(displaced[i], &old);
+			std::vector<char *> none;
+			index->BulkLoad(kept.data(), kept.size(), false, &none);
+			assert(none.empty());
+		}
+	}
+
+	int taken = 0;
+	for (size_t i = 0; i < rows.size(); i++) {
+		if (bufs[i]) {
+			Charge(bufs[i]);
+			rows[i]->ReplaceRowBuffer(NULL);
+			taken++;
+		}
+	}
+	for (size_t i = 0; i < displaced.size(); i++)
+		ReleaseRow(displaced[i]);
+	return taken;
+}
+
+bool MemTable::DeleteRow(const char *probe) {
+	assert(checkpoint_ == NULL);
+	if (wal_ == NULL)
+		return ApplyDelete(probe);
+	std::string record(1, kDeleteRecord);
+	EncodeRow(&record, probe);
+	bool ok = false;
+	wal_->Write(record, [&]() {
+		ok = ApplyDelete(probe);
+	});
+	return ok;
+}
+
+bool MemTable::ApplyDelete(const char *probe) {
+	std::unique_lock<std::mutex> l(write_mu_, std::defer_lock);
+	if (epoch_)
+		l.lock();
+	if (options_.snapshots) {
+		if (!DeleteVersion(probe))
 			return false;
+		CollectVersions();
+		return true;
+	}
+	//readers of a concurrent table may stand on the row; the skiplist
+	//unlinks it so they can still move on, and both are freed through the
+	//epoch manager
+	char *old;
+	if (!Index()->Remove(probe, &old))
+		return false;
+	for (int i = 1; i < nindexes_; i++) {
+		char *removed;
+		Index(i)->Remove(old, &removed);
+		assert(removed == old);
+	}
+	if (hash_)
+		hash_->Remove(old);
+	ReleaseRow(old);
+	return true;
+}
+
+bool MemTable::UpdateRow(const char *probe, int colno) {
+	assert(checkpoint_ == NULL);
+	if (wal_ == NULL)
+		return ApplyUpdate(probe, colno);
+	std::string record(1, kUpdateColumnRecord);
+	record.append((const char *) &colno, sizeof(colno));
+	EncodeRow(&record, probe);
+	bool ok = false;
+	wal_->Write(record, [&]() {
+		ok = ApplyUpdate(probe, colno);
+	});
+	return ok;
+}
+
+//Sets column colno of row to that of from, a string by copy
+void MemTable::CopyColumn(char *row, const char *from, int colno) {
+	int pos = schema_->GetColumnPos(colno);
+	if (schema_->GetColumnType(colno) != cString) {
+		memcpy(row + pos, from + pos, schema_->GetColumnSize(colno));
+		return;
+	}
+	schema_->FreeString(colno, row + pos);
+	schema_->SetString(colno, row + pos,
+			Slice(StrColumn::Data(from + pos), StrColumn::Length(from + pos)));
+}
+
+bool MemTable::ApplyUpdate(const char *probe, int colno) {
+	std::unique_lock<std::mutex> l(write_mu_, std::defer_lock);
+	if (epoch_)
+		l.lock();
+	char *row = Index()->Find(probe);
+	if (row == NULL || IsTombstone(row))
+		return false;
+
+	if (epoch_) {
+		RwRow copy(this);
+		for (int i = 0; i < schema_->NumColumns(); i++)
+			CopyColumn(copy.Buffer(), i == colno ? probe : row, i);
+		bool ok = InsertLocked(copy, true);
+		assert(ok);
+		return true;
+	}
+
+	//only the indexes on the column need to move the row
+	std::vector<int> moved;
+	for (int i = 1; i < nindexes_; i++) {
+		if (schema_->GetIndexNumber(i) == colno) {
+			char *removed;
+			Index(i)->Remove(row, &removed);
+			assert(removed == row);
+			moved.push_back(i);
 		}
 	}
-	content_->insert(it, std::pair<char *, int>(r.ReplaceRowBuffer(NULL), 1));
+	Uncharge(row);
+	CopyColumn(row, probe, colno);
+	Charge(row);
+	for (size_t i = 0; i < moved.size(); i++) {
+		char *replaced = NULL;
+		Index(moved[i])->Insert(row, true, &replaced);
+		assert(replaced == NULL);
+	}
 	return true;
 }
 
 void MemTable::Clear() {
-	for (auto it = content_->begin(); it != content_->end(); ++it) {
-		schema_->FreeRowBuffer(it->first);
+	assert(checkpoint_ == NULL);
+	if (wal_ == NULL) {
+		ApplyClear();
+		return;
+	}
+	std::string record(1, kClearRecord);
+	wal_->Write(record, [this]() {
+		ApplyClear();
+	});
+}
+
+void MemTable::ApplyClear() {
+	if (epoch_) {
+		//readers may still be walking the old index, swap in a fresh one
+		std::lock_guard<std::mutex> l(write_mu_);
+		seq_++;
+		tombstones_.store(0, std::memory_order_relaxed);
+		for (int i = 0; i < nindexes_; i++) {
+			RowIndex *old = Index(i);
+			indexes_[i].store(NewIndex(i), std::memory_order_release);
+			if (options_.snapshots) {
+				OldVersion o = { seq_, NULL, NULL, old, i };
+				old_versions_.push_back(o);
+				continue;
+			}
+			//the main index owns the rows
+			epoch_->Retire(i == 0 ? &FreeIndex : &DeleteIndex, this, old);
+		}
+		if (options_.snapshots)
+			CollectVersions();
+		return;
+	}
+	for (int i = 1; i < nindexes_; i++)
+		Index(i)->Clear();
+	if (hash_)
+		hash_->Clear();
+	RowIndex *index = Index();
+	if (schema_->GetArena()) {
+		index->Clear();
+		schema_->ResetArena();
+		row_bytes_.store(0, std::memory_order_relaxed);
+		string_bytes_.store(0, std::memory_order_relaxed);
+		return;
+	}
+	IndexPos p;
+	for (index->SeekToFirst(&p); p.Valid(); index->Next(&p)) {
+		FreeRowBuffer(index->RowAt(p));
 	}
-	content_->clear();
+	index->Clear();
 }
 
 void MemTable::PrintAll() {
@@ -53,43 +782,292 @@ void MemTable::PrintAll() {
 	}
 	printf("\n");
 	RdOnlyRow r(schema_);
-	for (auto it = content_->begin(); it != content_->end(); ++it) {
-		r.ReplaceRowBuffer(it->first);
+	Iterator it(this);
+	for (it.SeekToFirst(); it.Valid(); it.Next()) {
+		it.RowAt(r);
 		r.PrintRow();
 	}
 }
 
+/*-----------------snapshots---------------*/
+//The row that row replaces is linked from its version header before row is
+//published, so a reader of an older snapshot always finds it
+bool MemTable::InsertVersion(char *row, bool update) {
+	RowIndex *index = Index();
+	char *old = index->Find(row);
+	if (old && IsTombstone(old)) {
+		//a key deleted after the oldest snapshot, written again
+		tombstones_.fetch_sub(1, std::memory_order_relaxed);
+	} else if (old && !update) {
+		return false;
+	}
+	RowVersion *v = Version(row);
+	v->seq = ++seq_;
+	v->prev.store(old, std::memory_order_relaxed);
+	char *replaced = NULL;
+	index->Insert(row, true, &replaced);
+	assert(replaced == old);
+	Charge(row);
+	InsertSecondary(row, old && !IsTombstone(old) ? old : NULL);
+	if (old) {
+		OldVersion o = { v->seq, row, old, NULL, 0 };
+		old_versions_.push_back(o);
+	}
+	return true;
+}
+
+//The tombstone takes the row's place in the main index, and is removed
+//with the row once no snapshot can see either. The secondary indexes drop
+//the row at once: only the main index is read through snapshots.
+bool MemTable::DeleteVersion(const char *probe) {
+	RowIndex *index = Index();
+	char *old = index->Find(probe);
+	if (old == NULL || IsTombstone(old))
+		return false;
+	char *tomb = schema_->AllocRowBuffer();
+	CopyColumn(tomb, old, schema_->GetIndexNumber());
+	CopyColumn(tomb, old, schema_->GetPrimaryNumber());
+	RowVersion *v = Version(tomb);
+	v->seq = ++seq_;
+	v->prev.store(old, std::memory_order_relaxed);
+	v->deleted = true;
+	Charge(tomb);
+	char *replaced = NULL;
+	index->Insert(tomb, true, &replaced);
+	assert(replaced == old);
+	tombstones_.fetch_add(1, std::memory_order_relaxed);
+	for (int i = 1; i < nindexes_; i++) {
+		Index(i)->Remove(old, &replaced);
+		assert(replaced == old);
+	}
+	OldVersion o = { v->seq, tomb, old, NULL, 0 };
+	old_versions_.push_back(o);
+	return true;
+}
+
+//Hands what no snapshot can read any more to the epoch manager, which
+//frees it once plain iterators are done with it as well
+void MemTable::CollectVersions() {
+	uint64_t oldest = snapshots_.empty() ? seq_ : *snapshots_.begin();
+	while (!old_versions_.empty() && old_versions_.front().seq <= oldest) {
+		OldVersion &o = old_versions_.front();
+		if (o.index) {
+			//versions of its rows came before, and are gone already
+			epoch_->Retire(o.which == 0 ? &FreeIndex : &DeleteIndex, this,
+					o.index);
+		} else {
+			Version(o.newer)->prev.store(NULL, std::memory_order_relaxed);
+			ReleaseRow(o.older);
+			//a tombstone still in the index has nothing left to hide
+			char *removed;
+			if (Version(o.newer)->deleted && Index()->Find(o.newer) == o.newer
+					&& Index()->Remove(o.newer, &removed)) {
+				tombstones_.fetch_sub(1, std::memory_order_relaxed);
+				ReleaseRow(o.newer);
+			}
+		}
+		old_versions_.pop_front();
+	}
+}
+
+//The newest version of row's key written at or before seq, NULL if the
+//key was only written later or deleted
+char *MemTable::VisibleVersion(char *row, uint64_t seq) {
+	while (row != NULL && Version(row)->seq > seq)
+		row = Version(row)->prev.load(std::memory_order_acquire);
+	return row && Version(row)->deleted ? NULL : row;
+}
+
+const Snapshot *MemTable::GetSnapshot() {
+	assert(options_.snapshots);
+	std::lock_guard<std::mutex> l(write_mu_);
+	snapshots_.insert(seq_);
+	return new Snapshot(seq_, Index());
+}
+
+void MemTable::ReleaseSnapshot(const Snapshot *snapshot) {
+	std::lock_guard<std::mutex> l(write_mu_);
+	snapshots_.erase(snapshots_.find(snapshot->seq_));
+	delete snapshot;
+	CollectVersions();
+}
+
+//A zeroed string or binary column is already the smallest, a zeroed
+//number is not
+void ProbeRow::SetScanStart(int index) {
+	int cols[2] = { schema_->GetPrimaryNumber(), schema_->GetIndexNumber() };
+	for (int i = 0; i < (index > 0 ? 2 : 1); i++) {
+		char *col = buf_ + schema_->GetColumnPos(cols[i]);
+		switch (schema_->GetColumnType(cols[i])) {
+		case cInt32:
+			*(int *) col = INT_MIN;
+			break;
+		case cInt64:
+		case cTimestamp:
+			*(int64_t *) col = INT64_MIN;
+			break;
+		case cDouble:
+			//a NaN with every bit set, first in KeyColumn<cDouble> order
+			memset(col, 0xff, sizeof(double));
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+size_t MemTable::ScanRows(const char *probe, const ColumnPredicate &end,
+		const std::vector<ColumnPredicate> &preds, const ScanCallback &cb,
+		int index) {
+	int slot = epoch_ ? epoch_->Enter() : -1;
+	RowIndex *idx = Index(index);
+	char *batch[kScanBatch];
+	size_t n = 0, total = 0;
+	bool more = true;
+	IndexPos p;
+	for (idx->Seek(&p, probe); more && p.Valid(); idx->Next(&p)) {
+		char *row = idx->RowAt(p);
+		if (!end.Matches(row))
+			break;
+		if (IsTombstone(row))
+			continue;
+		size_t i = 0;
+		while (i < preds.size() && preds[i].Matches(row))
+			i++;
+		if (i < preds.size())
+			continue;
+		batch[n++] = row;
+		if (n == kScanBatch) {
+			more = cb(batch, n);
+			total += n;
+			n = 0;
+		}
+	}
+	if (more && n > 0) {
+		cb(batch, n);
+		total += n;
+	}
+	if (slot >= 0)
+		epoch_->Exit(slot);
+	return total;
+}
+
 /*-----------------MemTable::Iterator---------------*/
-MemTable::Iterator::Iterator(MemTable* table) :
-		table_(table) {
-	iter_ = table_->content_->begin();
+MemTable::Iterator::Iterator(MemTable* table, int index) :
+		table_(table), which_(index), snapshot_(NULL), epoch_slot_(-1) {
+	assert(which_ >= 0 && which_ < table_->nindexes_);
+	if (table_->epoch_)
+		epoch_slot_ = table_->epoch_->Enter();
+	SeekToFirst();
+}
+
+MemTable::Iterator::Iterator(MemTable *table, const Snapshot *snapshot) :
+		table_(table), which_(0), snapshot_(snapshot), epoch_slot_(-1) {
+	epoch_slot_ = table_->epoch_->Enter();
+	SeekToFirst();
+}
+
+MemTable::Iterator::Iterator(const Iterator &it) :
+		table_(it.table_), which_(it.which_), snapshot_(it.snapshot_),
+		index_(it.index_), pos_(it.pos_), epoch_slot_(-1) {
+	if (it.epoch_slot_ >= 0)
+		epoch_slot_ = table_->epoch_->EnterAs(it.epoch_slot_);
+}
+
+MemTable::Iterator &MemTable::Iterator::operator=(const Iterator &it) {
+	if (this == &it)
+		return *this;
+	int slot = -1;
+	if (it.epoch_slot_ >= 0)
+		slot = it.table_->epoch_->EnterAs(it.epoch_slot_);
+	if (epoch_slot_ >= 0)
+		table_->epoch_->Exit(epoch_slot_);
+	table_ = it.table_;
+	which_ = it.which_;
+	snapshot_ = it.snapshot_;
+	index_ = it.index_;
+	pos_ = it.pos_;
+	epoch_slot_ = slot;
+	return *this;
+}
+
+MemTable::Iterator::~Iterator() {
+	if (epoch_slot_ >= 0)
+		table_->epoch_->Exit(epoch_slot_);
 }
 
 bool MemTable::Iterator::Valid() {
-	return (iter_ != table_->content_->end());
+	return pos_.Valid();
+}
+
+bool MemTable::Iterator::ValidPrefix(const Slice &prefix) {
+	if (!pos_.Valid())
+		return false;
+	TableSchema *s = table_->schema_;
+	assert(s->GetIndexType(which_) == cString);
+	const char *col = index_->RowAt(pos_) + s->GetIndexPos(which_);
+	return StrColumn::Length(col) >= prefix.size()
+			&& memcmp(StrColumn::Data(col), prefix.data(), prefix.size()) == 0;
 }
 
 RdOnlyRow&
 MemTable::Iterator::RowAt(RdOnlyRow &r) {
-	r.ReplaceRowBuffer(iter_->first);
+	char *row = index_->RowAt(pos_);
+	if (snapshot_)
+		row = table_->VisibleVersion(row, snapshot_->seq_);
+	r.ReplaceRowBuffer(row);
 	return r;
 }
 
 void MemTable::Iterator::Next() {
-	iter_++;
+	index_->Next(&pos_);
+	SkipInvisible(true);
 }
 
 void MemTable::Iterator::Prev() {
-	iter_--;
+	index_->Prev(&pos_);
+	SkipInvisible(false);
 }
 
 void
 MemTable::Iterator::SeekRow(RdOnlyRow &r) {
-	iter_ = table_->content_->lower_bound(r.Buffer());
+	SeekProbe(r.Buffer());
+}
+
+void MemTable::Iterator::SeekProbe(const char *probe) {
+	index_ = CurrentIndex();
+	index_->Seek(&pos_, probe);
+	SkipInvisible(true);
 }
 
 void MemTable::Iterator::SeekToFirst() {
-	iter_ = table_->content_->begin();
+	index_ = CurrentIndex();
+	index_->SeekToFirst(&pos_);
+	SkipInvisible(true);
+}
+
+void MemTable::Iterator::SeekToLast() {
+	index_ = CurrentIndex();
+	index_->SeekToLast(&pos_);
+	SkipInvisible(false);
+}
+
+RowIndex *MemTable::Iterator::CurrentIndex() {
+	return snapshot_ ? snapshot_->index_ : table_->Index(which_);
+}
+
+//Steps over tombstones, and keys first written after the snapshot
+void MemTable::Iterator::SkipInvisible(bool forward) {
+	if (!table_->options_.snapshots)
+		return;
+	uint64_t seq = snapshot_ ? snapshot_->seq_ : UINT64_MAX;
+	while (pos_.Valid()
+			&& table_->VisibleVersion(index_->RowAt(pos_), seq) == NULL) {
+		if (forward)
+			index_->Next(&pos_);
+		else
+			index_->Prev(&pos_);
+	}
 }
 
 /* --------------------------- RdOnlyRow ----------------------------------*/
@@ -103,59 +1081,89 @@ void RdOnlyRow::GetColumn(int colno, int *ret) {
 	*ret = GetIntColumn(colno);
 }
 
-std::string RdOnlyRow::GetStrColumn(int colno) {
+int64_t RdOnlyRow::GetInt64Column(int colno) {
+	assert(schema_->GetColumnType(colno) == cInt64);
+	return *(int64_t *) (buf_ + schema_->GetColumnPos(colno));
+}
+
+void RdOnlyRow::GetColumn(int colno, int64_t *ret) {
+	*ret = GetInt64Column(colno);
+}
+
+double RdOnlyRow::GetDoubleColumn(int colno) {
+	assert(schema_->GetColumnType(colno) == cDouble);
+	return *(double *) (buf_ + schema_->GetColumnPos(colno));
+}
+
+void RdOnlyRow::GetColumn(int colno, double *ret) {
+	*ret = GetDoubleColumn(colno);
+}
+
+Timestamp RdOnlyRow::GetTimestampColumn(int colno) {
+	assert(schema_->GetColumnType(colno) == cTimestamp);
+	return Timestamp(*(int64_t *) (buf_ + schema_->GetColumnPos(colno)));
+}
+
+void RdOnlyRow::GetColumn(int colno, Timestamp *ret) {
+	*ret = GetTimestampColumn(colno);
+}
+
+const char *RdOnlyRow::GetStrColumn(int colno) {
 	assert(schema_->GetColumnType(colno) == cString);
-	return std::string(*(char **)(buf_ + schema_->GetColumnPos(colno)));
+	return StrColumn::Data(buf_ + schema_->GetColumnPos(colno));
+}
+
+Slice RdOnlyRow::GetSliceColumn(int colno) {
+	if (schema_->GetColumnType(colno) == cBinary)
+		return Slice(buf_ + schema_->GetColumnPos(colno),
+				schema_->GetColumnSize(colno));
+	assert(schema_->GetColumnType(colno) == cString);
+	return ColumnTraits<Slice>::Read(buf_ + schema_->GetColumnPos(colno));
+}
+
+void RdOnlyRow::GetColumn(int colno, Slice *ret) {
+	*ret = GetSliceColumn(colno);
 }
 
 void RdOnlyRow::GetColumn(int colno, std::string *ret) {
-	*ret = GetStrColumn(colno);
+	Slice s = GetSliceColumn(colno);
+	ret->assign(s.data(), s.size());
 }
 
 bool RdOnlyRow::LessThan(char * const r1, char * const r2, TableSchema *s) {
-	int pos = s->GetIndexPos();
-	if (s->GetIndexType() == cInt32) {
-		if ((*(int *) r1 + pos) < (*(int *) r2 + pos)) {
-			return true;
-		} else if ((*(int *) (r1 + pos)) > (*(int *) (r2 + pos))) {
-			return false;
-		}
-	} else if (s->GetIndexType() == cString) {
-		int result = strcmp(*(char **) (r1 + pos), *(char **) (r2 + pos));
-		if (result < 0) {
-			return true;
-		} else if (result > 0) {
-			return false;
-		}
-	} else {
-		assert(0);
-	}
-
-	if (pos == s->GetPrimaryPos()) {
+	int c = ColumnOps::Compare(s->GetIndexType(), s->GetColumnSize(
+			s->GetIndexNumber()), r1 + s->GetIndexPos(), r2 + s->GetIndexPos());
+	if (c != 0)
+		return c < 0;
+	if (s->GetIndexPos() == s->GetPrimaryPos())
 		return false;
-	} else {
-		pos = s->GetPrimaryPos();
-	}
-
-	if (s->GetPrimaryType() == cInt32) {
-		if ((*(int *) (r1 + pos)) < (*(int *) (r2 + pos)))
-			return true;
-	} else if (s->GetPrimaryType() == cString) {
-		int result = strcmp(*(char **) (r1 + pos), *(char **) (r2 + pos));
-		if (result < 0)
-			return true;
-	} else {
-		assert(0);
-	}
-	return false;
+	return ColumnOps::Compare(s->GetPrimaryType(), s->GetColumnSize(
+			s->GetPrimaryNumber()), r1 + s->GetPrimaryPos(),
+			r2 + s->GetPrimaryPos()) < 0;
 }
 
 void RdOnlyRow::PrintRow() {
 	for (int i = 0; i < schema_->NumColumns(); i++) {
-		if (schema_->GetColumnType(i) == cString) {
-			printf("%s\t", *(char **) (buf_ + schema_->GetColumnPos(i)));
-		} else if (schema_->GetColumnType(i) == cInt32) {
-			printf("%d\t", *(int *) (buf_ + schema_->GetColumnPos(i)));
+		const char *col = buf_ + schema_->GetColumnPos(i);
+		switch (schema_->GetColumnType(i)) {
+		case cString:
+			printf("%s\t", StrColumn::Data(col));
+			break;
+		case cInt32:
+			printf("%d\t", *(int *) col);
+			break;
+		case cInt64:
+		case cTimestamp:
+			printf("%lld\t", (long long) *(int64_t *) col);
+			break;
+		case cDouble:
+			printf("%g\t", *(double *) col);
+			break;
+		case cBinary:
+			for (int j = 0; j < schema_->GetColumnSize(i); j++)
+				printf("%02x", (unsigned char) col[j]);
+			printf("\t");
+			break;
 		}
 	}
 	printf("\n");
@@ -164,12 +1172,43 @@ void RdOnlyRow::PrintRow() {
 
 /*----------------------RwRow-------------------------------------------------*/
 RwRow::RwRow(TableSchema *s) : RdOnlyRow(s), col_(0) {
-	buf_ = schema_->AllocRowBuffer();
+	AllocBuffer();
 }
 RwRow::RwRow(MemTable *t) : RdOnlyRow(t), col_(0) {
+	AllocBuffer();
+}
+
+RwRow::RwRow(RwRow &&r) :
+		RdOnlyRow(r.schema_, r.buf_), col_(r.col_) {
+	r.buf_ = NULL;
+	r.col_ = 0;
+}
+
+RwRow &RwRow::operator=(RwRow &&r) {
+	if (this != &r) {
+		if (buf_)
+			schema_->FreeRowBuffer(buf_);
+		schema_ = r.schema_;
+		buf_ = r.buf_;
+		col_ = r.col_;
+		r.buf_ = NULL;
+		r.col_ = 0;
+	}
+	return *this;
+}
+
+void RwRow::AllocBuffer() {
 	buf_ = schema_->AllocRowBuffer();
 }
 
+void RwRow::Reset() {
+	if (buf_)
+		schema_->ClearRowBuffer(buf_);
+	else
+		AllocBuffer();
+	col_ = 0;
+}
+
 RwRow::~RwRow() {
 	if (buf_) {
 		schema_->FreeRowBuffer(buf_);
@@ -189,18 +1228,82 @@ operator<<(RwRow &r, const std::string &s) {
 	return r;
 }
 
+RwRow &
+operator<<(RwRow &r, const Slice &s) {
+	r.AddColumn(s);
+	return r;
+}
+
+RwRow &
+operator<<(RwRow &r, const char *s) {
+	r.AddColumn(s);
+	return r;
+}
+
+RwRow &
+operator<<(RwRow &r, const int64_t &x) {
+	r.AddColumn(x);
+	return r;
+}
+
+RwRow &
+operator<<(RwRow &r, const double &x) {
+	r.AddColumn(x);
+	return r;
+}
+
+RwRow &
+operator<<(RwRow &r, const Timestamp &t) {
+	r.AddColumn(t);
+	return r;
+}
+
 
 void RwRow::PutColumn(const int &x, int colno) {
 	assert(schema_->GetColumnType(colno) == cInt32);
 	*((int *) (buf_ + schema_->GetColumnPos(colno))) = x;
 }
 
-void RwRow::PutColumn(const std::string &s, int colno) {
+void RwRow::PutColumn(const int64_t &x, int colno) {
+	assert(schema_->GetColumnType(colno) == cInt64);
+	*((int64_t *) (buf_ + schema_->GetColumnPos(colno))) = x;
+}
+
+void RwRow::PutColumn(const double &x, int colno) {
+	assert(schema_->GetColumnType(colno) == cDouble);
+	*((double *) (buf_ + schema_->GetColumnPos(colno))) = x;
+}
+
+void RwRow::PutColumn(const Timestamp &t, int colno) {
+	assert(schema_->GetColumnType(colno) == cTimestamp);
+	*((int64_t *) (buf_ + schema_->GetColumnPos(colno))) = t.micros;
+}
+
+//A binary column takes at most its width, zero padded
+void RwRow::PutColumn(const Slice &s, int colno) {
+	if (schema_->GetColumnType(colno) == cBinary) {
+		char *col = buf_ + schema_->GetColumnPos(colno);
+		int width = schema_->GetColumnSize(colno);
+		assert(s.size() <= (size_t) width);
+		memcpy(col, s.data(), s.size());
+		memset(col + s.size(), 0, width - s.size());
+		return;
+	}
 	assert(schema_->GetColumnType(colno) == cString);
-	char *cs = (char *) malloc(s.length() + 1);
-	assert(cs);
-	memcpy(cs, s.c_str(), s.length() + 1);
-	*((char **) (buf_ + schema_->GetColumnPos(colno))) = cs;
+	schema_->SetString(colno, buf_ + schema_->GetColumnPos(colno), s);
+}
+
+void RwRow::EncodeKey() {
+	if (schema_->HasCompositeKey())
+		schema_->EncodeKey(buf_);
+}
+
+void RwRow::PutColumn(const std::string &s, int colno) {
+	PutColumn(Slice(s), colno);
+}
+
+void RwRow::PutColumn(const char *s, int colno) {
+	PutColumn(Slice(s), colno);
 }
 
 
@@ -9,12 +9,28 @@
 #define MEMDB_DB_MEMTABLE_H_
 
 #include "db/tableschema.h"
-#include <map>
+#include "db/comparator.h"
+#include "db/rowindex.h"
+#include "db/hashindex.h"
+#include "db/wal.h"
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <set>
+#include <string>
+#include <vector>
 
 namespace memdb {
 
 class RwRow;
 class RdOnlyRow;
+class ProbeRow;
+class EpochManager;
+class Checkpoint;
 
 class RowCompare {
 public:
@@ -26,25 +42,296 @@ private:
 	TableSchema *s_;
 };
 
+// A comparison of one column with a constant, evaluated on a raw row
+// buffer without copying the column out. A string or binary constant is
+// not copied: it must outlive the predicate. Columns compare in index
+// order, so a predicate agrees with the order of a Scan over the column.
+class ColumnPredicate {
+public:
+	enum Op {
+		kEq, kNe, kLt, kLe, kGt, kGe
+	};
+
+	ColumnPredicate(TableSchema *s, int column, Op op, int value) :
+			op_(op), type_(cInt32), pos_(s->GetColumnPos(column)), width_(0) {
+		assert(s->GetColumnType(column) == cInt32);
+		memcpy(fixed_, &value, sizeof(value));
+	}
+	ColumnPredicate(TableSchema *s, int column, Op op, int64_t value) :
+			op_(op), type_(cInt64), pos_(s->GetColumnPos(column)), width_(0) {
+		assert(s->GetColumnType(column) == cInt64);
+		memcpy(fixed_, &value, sizeof(value));
+	}
+	ColumnPredicate(TableSchema *s, int column, Op op, double value) :
+			op_(op), type_(cDouble), pos_(s->GetColumnPos(column)), width_(0) {
+		assert(s->GetColumnType(column) == cDouble);
+		memcpy(fixed_, &value, sizeof(value));
+	}
+	ColumnPredicate(TableSchema *s, int column, Op op, Timestamp value) :
+			op_(op), type_(cTimestamp), pos_(s->GetColumnPos(column)),
+			width_(0) {
+		assert(s->GetColumnType(column) == cTimestamp);
+		memcpy(fixed_, &value.micros, sizeof(value.micros));
+	}
+	// A binary constant compares as if zero padded to the column width
+	ColumnPredicate(TableSchema *s, int column, Op op, const Slice &value) :
+			op_(op), type_(s->GetColumnType(column)),
+			pos_(s->GetColumnPos(column)), width_(s->GetColumnSize(column)),
+			svalue_(value) {
+		assert(type_ == cString || type_ == cBinary);
+		assert(type_ != cBinary || value.size() <= (size_t) width_);
+	}
+
+	bool Matches(const char *row) const {
+		int c;
+		if (type_ == cString) {
+			c = ColumnTraits<Slice>::Read(row + pos_).compare(svalue_);
+		} else if (type_ == cBinary) {
+			c = memcmp(row + pos_, svalue_.data(), svalue_.size());
+			for (int i = svalue_.size(); c == 0 && i < width_; i++)
+				c = row[pos_ + i] != 0;
+		} else {
+			c = ColumnOps::Compare(type_, 0, row + pos_, fixed_);
+		}
+		switch (op_) {
+		case kEq:
+			return c == 0;
+		case kNe:
+			return c != 0;
+		case kLt:
+			return c < 0;
+		case kLe:
+			return c <= 0;
+		case kGt:
+			return c > 0;
+		default:
+			return c >= 0;
+		}
+	}
+
+private:
+	Op op_;
+	column_t type_;
+	int pos_;
+	int width_;
+	char fixed_[8];
+	Slice svalue_;
+};
+
+class MemTable;
+
+struct MemTableOptions {
+	MemTableOptions() :
+			concurrent(false), snapshots(false), hash_index(false),
+			wal_sync(kSyncEveryWrite), wal_sync_ms(100), memory_limit(0) {
+	}
+
+	// Let any number of threads Seek/Next through iterators without locks
+	// while other threads insert. Rows are kept in a lock-free skiplist,
+	// writers serialize on a mutex, and a row replaced by InsertRow or
+	// dropped by Clear is freed only once no iterator can still reach it.
+	// REQUIRES: the schema is not in arena mode
+	bool concurrent;
+
+	// Keep the rows that writes replace for as long as a snapshot taken
+	// before the write needs them, so GetSnapshot() can hand out
+	// point-in-time views. Every write also looks its key up first.
+	// REQUIRES: concurrent, TableSchema::EnableVersions()
+	bool snapshots;
+
+	// Also keep a hash table on the full (index, primary) key, for Get and
+	// MultiGet. Costs a slot per row and a hash table update per insert.
+	// REQUIRES: !concurrent
+	bool hash_index;
+
+	// If set, InsertRow, BulkLoad and Clear are appended to a write-ahead
+	// log at this path before they change the table, with group commit
+	// across concurrent writers. A table created over an existing log
+	// replays it first, so it comes back as it was when the log was last
+	// synced.
+	std::string wal_path;
+	WalSync wal_sync;
+	int wal_sync_ms; //for kSyncPeriodic
+
+	// If nonzero, an InsertRow or BulkLoad whose rows and strings would
+	// take ApproximateMemoryUsage() past this many bytes calls
+	// on_memory_limit, if set, and fails unless it returns true or has made
+	// room (e.g. by clearing the table). Index nodes the rows add are not
+	// foreseen, and concurrent writers check without the write lock, so the
+	// table may overshoot by a little. Replaying the log ignores the limit.
+	size_t memory_limit;
+	std::function<bool(MemTable *table)> on_memory_limit;
+};
+
+// Where the memory of a MemTable goes, see MemTable::GetStats()
+struct MemTableStats {
+	size_t rows; //as Size()
+	// Row buffers the table has yet to free, which includes old versions
+	// kept for snapshots and rows waiting for readers to move on
+	size_t row_bytes;
+	size_t string_bytes; //held by those rows outside their buffers
+	size_t index_bytes; //nodes of every index and the hash index
+	// Strings of dictionary columns, shared by the rows of every table on
+	// the schema and kept after the rows are gone. Not part of
+	// ApproximateMemoryUsage(), which is what the table can give back.
+	size_t dict_bytes;
+};
+
+// A point-in-time view of a MemTable, see MemTable::GetSnapshot()
+class Snapshot {
+public:
+	// Writes with a sequence number up to this one are visible
+	uint64_t Sequence() const {
+		return seq_;
+	}
+
+private:
+	friend class MemTable;
+	Snapshot(uint64_t seq, RowIndex *index) :
+			seq_(seq), index_(index) {
+	}
+
+	uint64_t seq_;
+	RowIndex *index_; //the main index when the snapshot was taken
+};
+
 class MemTable {
 public:
-	MemTable(TableSchema *schema);
+	MemTable(TableSchema *schema,
+			const MemTableOptions &options = MemTableOptions());
 	~MemTable();
 
 	bool InsertRow(RwRow &row, bool update = true);
 
+	// Removes the row with the (index, primary) key. Returns false if there
+	// is none. With options.snapshots the row is replaced by a tombstone,
+	// which stays until no snapshot can see the row any more.
+	template<class T, class U> bool Delete(const T &key, const U &primary);
+
+	// Sets column colno of the row with the (index, primary) key to value.
+	// The row is changed in place, where a reinsert would copy every string
+	// and search the index again; in concurrent mode, which readers must
+	// never see half done, a changed copy replaces it. Returns false if
+	// there is no such row, or if colno is part of the key (the index
+	// column, the primary or a column of SetKey), which would move the row.
+	template<class T, class U, class V> bool UpdateColumn(const T &key,
+			const U &primary, int colno, const V &value);
+
+	// Inserts a batch of rows (an iterator range over RwRow or RwRow *) with
+	// the same outcome as calling InsertRow(row, update) on each in order,
+	// but sorts the batch once and builds the index bottom-up. Returns the
+	// number of rows the table took over; rows refused because update is
+	// false keep their buffers.
+	template<class Iter> int BulkLoad(Iter begin, Iter end, bool update = true);
+
+	// Inserts a batch of rows, as BulkLoad takes them, with the same outcome
+	// as InsertRow on each in order. The batch is sorted first, so that
+	// each row is inserted from where the row before it went rather than
+	// from the top of the index, and takes the lock and the log once.
+	// Unlike BulkLoad, which rebuilds the index, the cost is in proportion
+	// to the batch: for batches that are small next to the table.
+	template<class Iter> int InsertBatch(Iter begin, Iter end,
+			bool update = true);
+
 	void Clear();
 	void PrintAll();
 
+	// Writes the rows, in index order, to a checkpoint file at path that
+	// OpenCheckpoint can map (format in db/checkpoint.h). In concurrent
+	// mode writers wait until it is done. Returns false on I/O errors.
+	bool WriteCheckpoint(const std::string &path);
+	// Returns a read-only table over the mapped checkpoint at path, whose
+	// iterators read the rows in the file in place, or NULL if it cannot
+	// be mapped or was written for different columns. Opening costs a few
+	// page faults, plus a sort per secondary index and a pass for the hash
+	// index if options ask for them.
+	// REQUIRES: options.wal_path is empty
+	static MemTable *OpenCheckpoint(TableSchema *schema,
+			const std::string &path,
+			const MemTableOptions &options = MemTableOptions());
+
+	// Points row at the row with the exact (index, primary) key, in O(1)
+	// and without allocating. Returns false, leaving row NULL, if there is
+	// no such row.
+	// REQUIRES: options.hash_index
+	template<class T, class U> bool Get(const T &key, const U &primary,
+			RdOnlyRow *row);
+	// Get for n keys at once, with the memory accesses of neighbouring
+	// lookups overlapped through prefetching. Returns how many were found.
+	template<class T, class U> size_t MultiGet(const T *keys,
+			const U *primaries, size_t n, RdOnlyRow *rows);
+
+	// Seek for n keys at once through index: points rows[i] at the first
+	// row whose index column and primary are >= keys[i] and primaries[i],
+	// NULL if there is none. The descents of neighbouring keys are
+	// interleaved so that their cache misses overlap, which beats as many
+	// Iterator::Seek calls when the keys are many and the table large.
+	// Returns how many rows have exactly the key asked for.
+	// REQUIRES: !options.concurrent
+	template<class T, class U> size_t MultiSeek(const T *keys,
+			const U *primaries, size_t n, RdOnlyRow *rows, int index = 0);
+
+	// Receives the rows of a scan as row buffers, at most kScanBatch at a
+	// time; returns false to end the scan
+	typedef std::function<bool(char * const *rows, size_t n)> ScanCallback;
+	static const size_t kScanBatch = 256;
+
+	// Walks index once from the first row whose key column is >= lo to the
+	// last one <= hi, and hands the rows that satisfy every predicate to
+	// cb in index order. Cheaper than Iterator::Seek/Valid/RowAt per row:
+	// bounds and predicates are tested on the row buffers and cb is called
+	// once per batch. Returns the number of rows handed to cb. The rows
+	// stay valid until Scan returns, in concurrent mode as well.
+	template<class T> size_t Scan(const T &lo, const T &hi,
+			const std::vector<ColumnPredicate> &preds, const ScanCallback &cb,
+			int index = 0);
+
+	// Returns the table as it is now, to pass to Iterator, unchanged by
+	// later writes; writers do not wait for its readers. The row versions
+	// it needs are kept until it is released.
+	// REQUIRES: options.snapshots
+	const Snapshot *GetSnapshot();
+	// REQUIRES: no iterator still uses snapshot
+	void ReleaseSnapshot(const Snapshot *snapshot);
+
+	// Number of rows in the table
+	size_t Size() {
+		return Index()->Size() - tombstones_.load(std::memory_order_relaxed);
+	}
+
+	// Bytes of heap the table holds: the sum of the byte counts of
+	// GetStats(), but for the schema's dictionaries, which are kept up to
+	// date on every write rather than counted here. Rows of a table opened
+	// over a checkpoint live in the mapping and are not counted; neither is
+	// the unused space of an arena.
+	size_t ApproximateMemoryUsage();
+	MemTableStats GetStats();
+
 	TableSchema *GetSchema() {
 		return schema_;
 	}
 
-	//iterate the contents of in-memory sorted list, adapted from leveldb's skiplist iterator
+	// The order preserving 64-bit prefix of row's main index key
+	uint64_t KeyPrefix(const char *row) {
+		return Index()->KeyPrefix(row);
+	}
+
+	//iterate the contents of the in-memory sorted index, adapted from leveldb's skiplist iterator
 
+	// In concurrent mode an iterator pins every row it returns: rows read
+	// through RowAt stay valid until the iterator is destroyed.
+	//
+	// An iterator walks one of the schema's indexes, the main one unless
+	// another is named; keys passed to Seek and Valid are then that
+	// index's column and the primary.
 	class Iterator {
 	public:
-		explicit Iterator(MemTable* table);
+		explicit Iterator(MemTable* table, int index = 0);
+		// Walks the main index as of snapshot
+		Iterator(MemTable *table, const Snapshot *snapshot);
+		Iterator(const Iterator &it);
+		Iterator &operator=(const Iterator &it);
+		~Iterator();
 
 		// Returns true iff the iterator is positioned at a valid node.
 		bool Valid();
@@ -53,6 +340,12 @@ public:
 		template<class T> bool Valid(const T &key);
 		//returns true iff the iterator's current node has matching index and primary key
 		template<class T, class U> bool Valid(const T &key, const U &primary);
+		// Returns true iff the current row's index column, a string, starts
+		// with prefix. With a composite key and a KeyBuilder key of its
+		// first columns, Seek(prefix) and Next() while ValidPrefix(prefix)
+		// visit the rows with those columns; Valid(prefix) would stop at
+		// the first, as every longer key compares greater.
+		bool ValidPrefix(const Slice &prefix);
 
 		// Returns the row at the current position.
 		// REQUIRES: Valid()
@@ -71,18 +364,114 @@ public:
 		template<class T, class U> void Seek(const T &key,
 				const U &primary);
 		void SeekRow(RdOnlyRow &r);
+		void SeekProbe(const char *probe);
 
 		// Position at the first entry in list.
 		// Final state of iterator is Valid() iff list is not empty.
 		void SeekToFirst();
 
+		// Position at the last entry in list.
+		// Final state of iterator is Valid() iff list is not empty.
+		void SeekToLast();
+
 	private:
+		RowIndex *CurrentIndex();
+		void SkipInvisible(bool forward);
+
 		MemTable* table_;
-		std::map<char *, int, RowCompare>::iterator iter_;
+		int which_; //index number in the schema
+		const Snapshot *snapshot_; //NULL for the latest rows
+		RowIndex *index_; //the index pos_ belongs to
+		IndexPos pos_;
+		int epoch_slot_; //-1 unless the table is concurrent
 	};
 private:
+	static RwRow *RowPtr(RwRow &r) {
+		return &r;
+	}
+	static RwRow *RowPtr(RwRow *r) {
+		return r;
+	}
+	int BulkLoadRows(const std::vector<RwRow *> &rows, bool update);
+	int InsertBatchRows(const std::vector<RwRow *> &rows, bool update);
+	bool CheckBatch(const std::vector<RwRow *> &rows);
+	bool DeleteRow(const char *probe);
+	bool UpdateRow(const char *probe, int colno);
+
+	//change the table, after the change has been logged
+	bool ApplyInsert(RwRow &r, bool update);
+	bool InsertLocked(RwRow &r, bool update, IndexPos *hint = NULL);
+	bool ApplyDelete(const char *probe);
+	bool ApplyUpdate(const char *probe, int colno);
+	void CopyColumn(char *row, const char *from, int colno);
+	int ApplyBulkLoad(const std::vector<RwRow *> &rows, bool update);
+	int ApplyInsertBatch(const std::vector<RwRow *> &rows, bool update);
+	void ApplyClear();
+	void EncodeRow(std::string *dst, const char *row);
+	bool DecodeRow(Slice *in, RwRow *row);
+	void Replay(const Slice &record);
+
+	//a row replaced at seq, or a whole index dropped by Clear at seq, that
+	//snapshots taken before seq may still read
+	struct OldVersion {
+		uint64_t seq;
+		char *newer; //the row that replaced older
+		char *older;
+		RowIndex *index;
+		int which; //index number of index
+	};
+	RowVersion *Version(const char *row) {
+		return (RowVersion *) (row + schema_->GetVersionPos());
+	}
+	bool InsertVersion(char *row, bool update);
+	bool DeleteVersion(const char *probe);
+	bool IsTombstone(const char *row) {
+		return options_.snapshots && Version(row)->deleted;
+	}
+	void CollectVersions();
+	char *VisibleVersion(char *row, uint64_t seq);
+
+	size_t ScanRows(const char *probe, const ColumnPredicate &end,
+			const std::vector<ColumnPredicate> &preds, const ScanCallback &cb,
+			int index);
+
+	RowIndex *Index(int i = 0) {
+		return indexes_[i].load(std::memory_order_acquire);
+	}
+	RowIndex *NewIndex(int i);
+	void InsertSecondary(char *row, char *old);
+	void ReleaseRow(char *row);
+	void FreeRowBuffer(char *row);
+	static void FreeRow(void *table, void *row);
+	static void FreeIndex(void *table, void *index);
+	static void DeleteIndex(void *table, void *index);
+
+	//memory accounting of the rows the table owns
+	size_t StringBytes(const char *row);
+	void Charge(const char *row);
+	void Uncharge(const char *row);
+	size_t IndexBytes();
+	bool HasRoom(size_t bytes);
+
 	TableSchema *schema_;
-	std::map<char *, int, RowCompare> *content_;
+	MemTableOptions options_;
+	//one per index of the schema, main index first; secondary indexes hold
+	//the same row buffers as the main one
+	std::atomic<RowIndex *> *indexes_;
+	int nindexes_;
+	HashIndex *hash_; //NULL unless options_.hash_index
+	std::mutex write_mu_; //serializes writers in concurrent mode
+	EpochManager *epoch_; //NULL unless concurrent
+	Wal *wal_; //NULL unless options_.wal_path is set
+	Checkpoint *checkpoint_; //rows of a read-only table, else NULL
+	//the rest is for options_.snapshots, guarded by write_mu_
+	uint64_t seq_; //of the last write
+	std::multiset<uint64_t> snapshots_; //sequence numbers of live snapshots
+	std::deque<OldVersion> old_versions_; //by seq
+	std::atomic<size_t> tombstones_; //in the main index
+	//for GetStats(); rows may be freed by readers leaving an epoch
+	std::atomic<size_t> row_bytes_;
+	std::atomic<size_t> string_bytes_;
 };
 
 class RdOnlyRow {
@@ -105,9 +494,26 @@ public:
 
 	//cannot overload function with return types, so have to use different names
 	int GetIntColumn(int colno);
-	std::string GetStrColumn(int colno);
+	// Points into the row, valid as long as the row is
+	const char *GetStrColumn(int colno);
+	// Zero-copy view of a string or binary column, valid as long as the
+	// row is
+	Slice GetSliceColumn(int colno);
+	int64_t GetInt64Column(int colno);
+	double GetDoubleColumn(int colno);
+	Timestamp GetTimestampColumn(int colno);
 	void GetColumn(int colno, int *ret);
+	void GetColumn(int colno, int64_t *ret);
+	void GetColumn(int colno, double *ret);
+	void GetColumn(int colno, Timestamp *ret);
 	void GetColumn(int colno, std::string *ret);
+	void GetColumn(int colno, Slice *ret);
+
+	// Typed read through a column resolved by TableSchema::GetColumnRef,
+	// no type check or schema lookup per call
+	template<class T> T Get(const ColumnRef<T> &col) const {
+		return ColumnTraits<T>::Read(buf_ + col.Pos());
+	}
 
 	static bool LessThan(char * const r1, char * const r2, TableSchema *s);
 	void PrintRow();
@@ -116,71 +522,362 @@ protected:
 	TableSchema *schema_;
 };
 
+// A row being built for insertion. InsertRow and friends take its buffer
+// over; Reset() then readies the row for the next one, as does moving
+// another row into it.
 class RwRow : public RdOnlyRow {
 public:
 	RwRow(TableSchema *s);
 	RwRow(MemTable *table);
+	RwRow(RwRow &&r);
+	RwRow &operator=(RwRow &&r);
 	~RwRow();
 
+	// Starts over at column 0 with an empty row, in the same buffer unless
+	// a table took it
+	void Reset();
+
 	void PutColumn(const int & x, int colno);
+	void PutColumn(const int64_t & x, int colno);
+	void PutColumn(const double & x, int colno);
+	void PutColumn(const Timestamp & t, int colno);
 	void PutColumn(const std::string & s, int colno);
+	void PutColumn(const Slice & s, int colno);
+	void PutColumn(const char *s, int colno);
 
 	template<class T> void AddColumn(const T &x);
 
+	// With a composite key (TableSchema::SetKey), encodes the key columns
+	// into the key column, as InsertRow and BulkLoad do. No-op otherwise.
+	void EncodeKey();
+
 private:
 	void AllocBuffer();
 	int col_;
+
+	//no copying allowed
+	RwRow(const RwRow &);
+	void operator=(const RwRow &);
+};
+
+
+// A row buffer that only carries key columns for a lookup, on the stack
+// for all but very wide rows. Strings are not copied, the probe refers to
+// the caller's memory for as long as it lives.
+class ProbeRow {
+public:
+	explicit ProbeRow(TableSchema *s) :
+			schema_(s) {
+		int n = s->RowSize();
+		buf_ = n <= kStackSize ? stack_ : (char *) malloc(n);
+		memset(buf_, 0, n);
+	}
+	~ProbeRow() {
+		if (buf_ != stack_)
+			free(buf_);
+	}
+	char *Buffer() {
+		return buf_;
+	}
+
+	// Sets the key columns of index other than its own column to their
+	// smallest values, so that a probe for a key lands before every row
+	// with that key
+	void SetScanStart(int index);
+
+	void PutColumn(int x, int colno) {
+		assert(schema_->GetColumnType(colno) == cInt32);
+		*(int *) (buf_ + schema_->GetColumnPos(colno)) = x;
+	}
+	void PutColumn(int64_t x, int colno) {
+		assert(schema_->GetColumnType(colno) == cInt64);
+		*(int64_t *) (buf_ + schema_->GetColumnPos(colno)) = x;
+	}
+	void PutColumn(double x, int colno) {
+		assert(schema_->GetColumnType(colno) == cDouble);
+		*(double *) (buf_ + schema_->GetColumnPos(colno)) = x;
+	}
+	void PutColumn(Timestamp t, int colno) {
+		assert(schema_->GetColumnType(colno) == cTimestamp);
+		*(int64_t *) (buf_ + schema_->GetColumnPos(colno)) = t.micros;
+	}
+	void PutColumn(const Slice &s, int colno) {
+		if (schema_->GetColumnType(colno) == cBinary) {
+			char *col = buf_ + schema_->GetColumnPos(colno);
+			int width = schema_->GetColumnSize(colno);
+			assert(s.size() <= (size_t) width);
+			memcpy(col, s.data(), s.size());
+			memset(col + s.size(), 0, width - s.size());
+			return;
+		}
+		assert(schema_->GetColumnType(colno) == cString);
+		StrColumn::SetView(buf_ + schema_->GetColumnPos(colno), s.data(),
+				s.size());
+	}
+
+private:
+	enum {
+		kStackSize = 256
+	};
+	TableSchema *schema_;
+	char *buf_;
+	char stack_[kStackSize];
+
+	//no copying allowed
+	ProbeRow(const ProbeRow &);
+	void operator=(const ProbeRow &);
 };
 
+// Builds the encoded key of a schema with a composite key, one key column
+// at a time in key order, to pass wherever a lookup takes the index or the
+// primary column (both are the encoded key). A key of only the first few
+// columns is a prefix: Seek to it lands on the first row that starts with
+// those columns, and Iterator::ValidPrefix tells when the rows that do
+// run out.
+class KeyBuilder {
+public:
+	explicit KeyBuilder(TableSchema *s) :
+			schema_(s), n_(0) {
+		assert(s->HasCompositeKey());
+	}
+
+	KeyBuilder &Add(int x) {
+		KeyCoding::AppendInt32(x, Next(cInt32), &key_);
+		return *this;
+	}
+	KeyBuilder &Add(int64_t x) {
+		KeyCoding::AppendInt64(x, Next(cInt64), &key_);
+		return *this;
+	}
+	KeyBuilder &Add(double x) {
+		KeyCoding::AppendDouble(x, Next(cDouble), &key_);
+		return *this;
+	}
+	KeyBuilder &Add(Timestamp t) {
+		KeyCoding::AppendInt64(t.micros, Next(cTimestamp), &key_);
+		return *this;
+	}
+	// For a string or a binary column
+	KeyBuilder &Add(const Slice &s) {
+		int c = schema_->GetKeyColumn(n_);
+		if (schema_->GetColumnType(c) == cBinary) {
+			assert(s.size() <= (size_t) schema_->GetColumnSize(c));
+			KeyCoding::AppendBinary(s.data(), s.size(),
+					schema_->GetColumnSize(c), Next(cBinary), &key_);
+		} else {
+			KeyCoding::AppendString(s.data(), s.size(), Next(cString), &key_);
+		}
+		return *this;
+	}
+	KeyBuilder &Add(const char *s) {
+		return Add(Slice(s));
+	}
+
+	// Valid until the builder changes
+	Slice Key() const {
+		return Slice(key_);
+	}
+	void Clear() {
+		key_.clear();
+		n_ = 0;
+	}
+
+private:
+	//returns whether the next key column, of type t, is descending
+	bool Next(column_t t) {
+		assert(n_ < schema_->NumKeyColumns());
+		assert(schema_->GetColumnType(schema_->GetKeyColumn(n_)) == t);
+		return schema_->IsKeyDescending(n_++);
+	}
+
+	TableSchema *schema_;
+	int n_; //key columns added
+	std::string key_;
+};
 
 RwRow& operator<<(RwRow &, const int &c);
 RwRow& operator<<(RwRow &, const std::string &s);
+RwRow& operator<<(RwRow &, const Slice &s);
+RwRow& operator<<(RwRow &, const char *s);
+RwRow& operator<<(RwRow &, const int64_t &x);
+RwRow& operator<<(RwRow &, const double &x);
+RwRow& operator<<(RwRow &, const Timestamp &t);
 
 template<class T> void RwRow::AddColumn(const T &val) {
 	PutColumn(val, col_);
 	col_++;
 }
 
+template<class Iter> int MemTable::BulkLoad(Iter begin, Iter end,
+		bool update) {
+	std::vector<RwRow *> rows;
+	for (; begin != end; ++begin)
+		rows.push_back(RowPtr(*begin));
+	return BulkLoadRows(rows, update);
+}
+
+template<class Iter> int MemTable::InsertBatch(Iter begin, Iter end,
+		bool update) {
+	std::vector<RwRow *> rows;
+	for (; begin != end; ++begin)
+		rows.push_back(RowPtr(*begin));
+	return InsertBatchRows(rows, update);
+}
+
+template<class T, class U> bool MemTable::Delete(const T &key,
+		const U &primary) {
+	ProbeRow p(schema_);
+	p.PutColumn(key, schema_->GetIndexNumber());
+	p.PutColumn(primary, schema_->GetPrimaryNumber());
+	return DeleteRow(p.Buffer());
+}
+
+//The probe carries the new value along with the key
+template<class T, class U, class V> bool MemTable::UpdateColumn(const T &key,
+		const U &primary, int colno, const V &value) {
+	if (schema_->IsKeyColumn(colno))
+		return false;
+	ProbeRow p(schema_);
+	p.PutColumn(key, schema_->GetIndexNumber());
+	p.PutColumn(primary, schema_->GetPrimaryNumber());
+	p.PutColumn(value, colno);
+	return UpdateRow(p.Buffer(), colno);
+}
+
+template<class T, class U> bool MemTable::Get(const T &key, const U &primary,
+		RdOnlyRow *row) {
+	assert(hash_);
+	ProbeRow p(schema_);
+	p.PutColumn(key, schema_->GetIndexNumber());
+	p.PutColumn(primary, schema_->GetPrimaryNumber());
+	char *r = hash_->Find(p.Buffer(), hash_->Hash(p.Buffer()));
+	row->ReplaceRowBuffer(r);
+	return r != NULL;
+}
+
+//Works through the keys in groups: hash every key and prefetch its slot,
+//then prefetch the rows those slots point at, then compare. By the time a
+//lookup needs a cache line the other lookups of its group have been waiting
+//on theirs too.
+template<class T, class U> size_t MemTable::MultiGet(const T *keys,
+		const U *primaries, size_t n, RdOnlyRow *rows) {
+	assert(hash_);
+	enum {
+		kGroup = 16
+	};
+	size_t found = 0;
+	for (size_t base = 0; base < n; base += kGroup) {
+		size_t m = n - base < kGroup ? n - base : kGroup;
+		ProbeRow *probes[kGroup];
+		alignas(ProbeRow) char space[kGroup][sizeof(ProbeRow)];
+		uint32_t h[kGroup];
+		for (size_t i = 0; i < m; i++) {
+			probes[i] = new (space[i]) ProbeRow(schema_);
+			probes[i]->PutColumn(keys[base + i], schema_->GetIndexNumber());
+			probes[i]->PutColumn(primaries[base + i],
+					schema_->GetPrimaryNumber());
+			h[i] = hash_->Hash(probes[i]->Buffer());
+			hash_->Prefetch(h[i]);
+		}
+		for (size_t i = 0; i < m; i++)
+			hash_->PrefetchRow(h[i]);
+		for (size_t i = 0; i < m; i++) {
+			char *r = hash_->Find(probes[i]->Buffer(), h[i]);
+			rows[base + i].ReplaceRowBuffer(r);
+			if (r)
+				found++;
+			probes[i]->~ProbeRow();
+		}
+	}
+	return found;
+}
+
+template<class T, class U> size_t MemTable::MultiSeek(const T *keys,
+		const U *primaries, size_t n, RdOnlyRow *rows, int index) {
+	assert(epoch_ == NULL);
+	enum {
+		kGroup = 64
+	};
+	int col = schema_->GetIndexNumber(index);
+	int pcol = schema_->GetPrimaryNumber();
+	RowIndex *idx = Index(index);
+	size_t found = 0;
+	for (size_t base = 0; base < n; base += kGroup) {
+		size_t m = n - base < kGroup ? n - base : kGroup;
+		ProbeRow *probes[kGroup];
+		alignas(ProbeRow) char space[kGroup][sizeof(ProbeRow)];
+		const char *bufs[kGroup];
+		IndexPos pos[kGroup];
+		for (size_t i = 0; i < m; i++) {
+			probes[i] = new (space[i]) ProbeRow(schema_);
+			probes[i]->SetScanStart(index);
+			probes[i]->PutColumn(keys[base + i], col);
+			probes[i]->PutColumn(primaries[base + i], pcol);
+			bufs[i] = probes[i]->Buffer();
+		}
+		idx->MultiSeek(pos, bufs, m);
+		for (size_t i = 0; i < m; i++) {
+			char *r = pos[i].Valid() ? idx->RowAt(pos[i]) : NULL;
+			rows[base + i].ReplaceRowBuffer(r);
+			if (r && ColumnPredicate(schema_, col, ColumnPredicate::kEq,
+					keys[base + i]).Matches(r)
+					&& ColumnPredicate(schema_, pcol, ColumnPredicate::kEq,
+							primaries[base + i]).Matches(r))
+				found++;
+			probes[i]->~ProbeRow();
+		}
+	}
+	return found;
+}
+
+template<class T> size_t MemTable::Scan(const T &lo, const T &hi,
+		const std::vector<ColumnPredicate> &preds, const ScanCallback &cb,
+		int index) {
+	int col = schema_->GetIndexNumber(index);
+	ProbeRow probe(schema_);
+	probe.SetScanStart(index);
+	probe.PutColumn(lo, col);
+	ColumnPredicate end(schema_, col, ColumnPredicate::kLe, hi);
+	return ScanRows(probe.Buffer(), end, preds, cb, index);
+}
+
+//Seek and Valid build their keys on the stack and compare in place, so
+//that a lookup never touches the heap
+
 template<class T> void MemTable::Iterator::Seek(const T &key) {
-	RwRow r(table_);
-	r.PutColumn(key, table_->GetSchema()->GetIndexNumber());
-	return SeekRow(r);
+	ProbeRow p(table_->schema_);
+	p.SetScanStart(which_);
+	p.PutColumn(key, table_->schema_->GetIndexNumber(which_));
+	SeekProbe(p.Buffer());
 }
 
 template<class T, class U> void MemTable::Iterator::Seek(const T &key,
 		const U &primary) {
-	RwRow r(table_);
-	r.PutColumn(key, table_->GetSchema()->GetIndexNumber());
-	r.PutColumn(primary, table_->GetSchema()->GetPrimaryNumber());
-	return SeekRow(r);
+	ProbeRow p(table_->schema_);
+	p.SetScanStart(which_);
+	p.PutColumn(key, table_->schema_->GetIndexNumber(which_));
+	p.PutColumn(primary, table_->schema_->GetPrimaryNumber());
+	SeekProbe(p.Buffer());
 }
 
 template<class T> bool MemTable::Iterator::Valid(const T &key) {
-	if (iter_ == table_->content_->end())
+	if (!pos_.Valid())
 		return false;
-	T t1;
-	RdOnlyRow r(table_,iter_->first);
-	r.GetColumn(table_->GetSchema()->GetIndexNumber(), &t1);
-	if (t1 > key)
-		return false;
-	return true;
+	TableSchema *s = table_->schema_;
+	return ColumnPredicate(s, s->GetIndexNumber(which_), ColumnPredicate::kLe,
+			key).Matches(index_->RowAt(pos_));
 }
 
 template<class T, class U> bool MemTable::Iterator::Valid(const T &key,
 		const U &primary) {
-	if (iter_ == table_->content_->end())
-		return false;
-	T t1;
-	RdOnlyRow r(table_, iter_->first);
-	r.GetColumn(table_->GetSchema()->GetIndexNumber(), &t1);
-	if (t1 > key)
-		return false;
-	U t2;
-	r.ReplaceRowBuffer(iter_->first);
-	r.GetColumn(table_->GetSchema()->GetPrimaryNumber(), &t2);
-	if (t2 > primary)
+	if (!pos_.Valid())
 		return false;
-	return true;
+	TableSchema *s = table_->schema_;
+	const char *row = index_->RowAt(pos_);
+	return ColumnPredicate(s, s->GetIndexNumber(which_), ColumnPredicate::kLe,
+			key).Matches(row)
+			&& ColumnPredicate(s, s->GetPrimaryNumber(), ColumnPredicate::kLe,
+					primary).Matches(row);
 }
 
 } //namespace memdb
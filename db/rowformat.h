@@ -0,0 +1,149 @@
+/*
+ * rowformat.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: jinyang
+ */
+
+#ifndef MEMDB_DB_ROWFORMAT_H_
+#define MEMDB_DB_ROWFORMAT_H_
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+
+namespace memdb {
+
+// Layout of a string column inside a row buffer, kSize bytes:
+//   [0,4)   length
+//   [4,16)  the string and its NUL terminator, if length < kInline
+// otherwise
+//   [4,8)   copy of the first four bytes
+//   [8,16)  distance from the column to the NUL terminated string
+// Either way bytes [4,8) hold a zero padded prefix, so most comparisons are
+// decided without leaving the row. A zeroed column is the empty string.
+// Being relative to the column, the string reference stays valid when a
+// row and its string move together, as in a memory-mapped checkpoint.
+struct StrColumn {
+	static const int kSize = 16;
+	static const uint32_t kInline = 12;
+
+	static bool IsInline(uint32_t len) {
+		return len < kInline;
+	}
+
+	static uint32_t Length(const char *col) {
+		return *(const uint32_t *) col;
+	}
+
+	static const char *Data(const char *col) {
+		if (IsInline(Length(col)))
+			return col + 4;
+		int64_t delta;
+		memcpy(&delta, col + 8, sizeof(delta));
+		return col + delta;
+	}
+
+	// The first four bytes, big endian so that integer order is byte order
+	static uint32_t Prefix(const char *col) {
+		const unsigned char *p = (const unsigned char *) col + 4;
+		return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16)
+				| ((uint32_t) p[2] << 8) | p[3];
+	}
+
+	// The first nbytes (at most 8), big endian, zero padded
+	static uint64_t Prefix(const char *col, int nbytes) {
+		if (nbytes <= 4)
+			return Prefix(col) >> (8 * (4 - nbytes));
+		uint32_t len = Length(col);
+		const unsigned char *d = (const unsigned char *) Data(col);
+		uint64_t k = Prefix(col);
+		for (int i = 4; i < nbytes; i++)
+			k = (k << 8) | (i < (int) len ? d[i] : 0);
+		return k;
+	}
+
+	// Fills in the column with a string short enough to be kept in it.
+	// REQUIRES: IsInline(len)
+	static void SetInline(char *col, const char *s, uint32_t len) {
+		assert(IsInline(len));
+		memset(col, 0, kSize);
+		*(uint32_t *) col = len;
+		memcpy(col + 4, s, len);
+	}
+
+	// Fills in the column. heap must hold len+1 bytes unless IsInline(len).
+	static void Set(char *col, const char *s, uint32_t len, char *heap) {
+		if (IsInline(len)) {
+			SetInline(col, s, len);
+			return;
+		}
+		memset(col, 0, kSize);
+		*(uint32_t *) col = len;
+		memcpy(heap, s, len);
+		heap[len] = '\0';
+		memcpy(col + 4, s, 4);
+		SetDelta(col, heap);
+	}
+
+	// Fills in the column to refer to s in place: for lookup probes and
+	// interned strings, which must never be freed through the column, and
+	// strings built in the heap copy the column is to own. The column is
+	// valid while s is.
+	static void SetView(char *col, const char *s, uint32_t len) {
+		memset(col, 0, kSize);
+		*(uint32_t *) col = len;
+		if (IsInline(len)) {
+			memcpy(col + 4, s, len);
+			return;
+		}
+		memcpy(col + 4, s, 4);
+		SetDelta(col, s);
+	}
+
+	// Points a long string column at data
+	static void SetDelta(char *col, const char *data) {
+		int64_t delta = data - col;
+		memcpy(col + 8, &delta, sizeof(delta));
+	}
+
+	// The separately allocated payload, NULL for inline strings
+	static char *Heap(const char *col) {
+		if (IsInline(Length(col)))
+			return NULL;
+		return (char *) Data(col);
+	}
+
+	static int Compare(const char *a, const char *b) {
+		uint32_t pa = Prefix(a), pb = Prefix(b);
+		if (pa != pb)
+			return pa < pb ? -1 : 1;
+		uint32_t la = Length(a), lb = Length(b);
+		uint32_t n = la < lb ? la : lb;
+		//the same interned string, as equal values of a dictionary column are
+		if (la == lb && Data(a) == Data(b))
+			return 0;
+		if (n > 4) {
+			int c = memcmp(Data(a) + 4, Data(b) + 4, n - 4);
+			if (c != 0)
+				return c;
+		}
+		return (la > lb) - (la < lb);
+	}
+};
+
+// Header after the columns of a row buffer when the schema keeps versions
+// (TableSchema::EnableVersions): the sequence number of the write that
+// made the row, and the row it replaced, which readers of older snapshots
+// see instead. A tombstone is a version that deletes its key and has only
+// the key columns. A zeroed header is a live row with no history.
+struct RowVersion {
+	uint64_t seq;
+	std::atomic<char *> prev;
+	bool deleted;
+};
+
+} //namespace memdb
+
+#endif
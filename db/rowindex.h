@@ -0,0 +1,97 @@
+/*
+ * rowindex.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: jinyang
+ */
+
+#ifndef MEMDB_DB_ROWINDEX_H_
+#define MEMDB_DB_ROWINDEX_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace memdb {
+
+// A position inside a RowIndex. Only the index that filled it in knows
+// what node and slot mean; everybody else just checks Valid().
+struct IndexPos {
+	IndexPos() : node(NULL), slot(0) {}
+	bool Valid() const {
+		return node != NULL;
+	}
+	void *node;
+	int slot;
+};
+
+// Ordered collection of row buffers, sorted by the (index, primary) key of
+// the table schema. Row buffers are owned by the caller: an index never
+// allocates or frees them, it only hands back the ones it displaced.
+class RowIndex {
+public:
+	virtual ~RowIndex() {
+	}
+
+	// Inserts row. If a row with an equal key is already present, it is
+	// replaced when replace is true (and returned through *old so the caller
+	// can free it), otherwise the index is left untouched and false returned.
+	virtual bool Insert(char *row, bool replace, char **old) = 0;
+
+	// Insert for a row whose key is close to that of the row at *hint,
+	// such as the next row of a sorted batch: an index may then start
+	// from there instead of searching from the top. Moves *hint to row.
+	// A hint that is not Valid() is no help; this index ignores hints.
+	// REQUIRES: nothing was removed since *hint was filled in
+	virtual bool InsertNear(IndexPos *hint, char *row, bool replace,
+			char **old) {
+		hint->node = NULL;
+		return Insert(row, replace, old);
+	}
+
+	// Adds n rows with the same outcome as calling Insert(rows[i], replace)
+	// for i = 0..n-1, but sorts the batch once and rebuilds the index
+	// bottom-up. Rows that Insert would have refused are set to NULL in
+	// rows[]; rows it would have replaced, including rows of the batch
+	// itself, are appended to *displaced.
+	virtual void BulkLoad(char **rows, size_t n, bool replace,
+			std::vector<char *> *displaced) = 0;
+
+	// Returns the row whose key equals the key of probe, or NULL
+	virtual char *Find(const char *probe) = 0;
+
+	// Removes the row whose key equals the key of probe and returns it
+	// through *old. Returns false if there is no such row.
+	virtual bool Remove(const char *probe, char **old) = 0;
+
+	// Drops all entries without touching the row buffers.
+	virtual void Clear() = 0;
+
+	virtual size_t Size() = 0;
+	// Bytes the index itself holds for its nodes, not counting the rows
+	virtual size_t MemoryUsage() = 0;
+
+	// The order preserving 64-bit prefix of the key of row that the index
+	// compares before it looks at the row itself
+	virtual uint64_t KeyPrefix(const char *row) = 0;
+
+	virtual void SeekToFirst(IndexPos *p) = 0;
+	virtual void SeekToLast(IndexPos *p) = 0;
+	// Position at the first row whose key is >= the key of probe
+	virtual void Seek(IndexPos *p, const char *probe) = 0;
+	// Seek for n probes at once, p[i] for probes[i]. An index may overlap
+	// the memory accesses of neighbouring probes; this one seeks in turn.
+	virtual void MultiSeek(IndexPos *p, const char * const *probes,
+			size_t n) {
+		for (size_t i = 0; i < n; i++)
+			Seek(p + i, probes[i]);
+	}
+	// REQUIRES: p->Valid()
+	virtual void Next(IndexPos *p) = 0;
+	virtual void Prev(IndexPos *p) = 0;
+	virtual char *RowAt(const IndexPos &p) = 0;
+};
+
+} //namespace memdb
+
+#endif
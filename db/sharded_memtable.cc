@@ -0,0 +1,213 @@
+/*
+ * sharded_memtable.cc
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: jinyang
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include "db/sharded_memtable.h"
+#include "db/rowformat.h"
+#include "db/comparator.h"
+
+namespace memdb {
+
+//true if both rows have the same value in the index column
+static bool SameIndexKey(TableSchema *s, const char *r1, const char *r2) {
+	int pos = s->GetIndexPos();
+	return ColumnOps::Compare(s->GetIndexType(), s->GetColumnSize(
+			s->GetIndexNumber()), r1 + pos, r2 + pos) == 0;
+}
+
+ShardedMemTable::ShardedMemTable(TableSchema *schema, int nshards,
+		const MemTableOptions &options) :
+		schema_(schema) {
+	assert(nshards > 0);
+	//one arena would be shared, and reset, by all shards
+	assert(schema_->GetArena() == NULL);
+	for (int i = 0; i < nshards; i++) {
+		MemTableOptions o = options;
+		if (!o.wal_path.empty()) {
+			//each shard logs and group-commits on its own
+			char suffix[16];
+			snprintf(suffix, sizeof(suffix), ".%d", i);
+			o.wal_path += suffix;
+		}
+		shards_.push_back(new MemTable(schema_, o));
+		locks_.push_back(new std::mutex);
+	}
+}
+
+ShardedMemTable::~ShardedMemTable() {
+	for (size_t i = 0; i < shards_.size(); i++) {
+		delete shards_[i];
+		delete locks_[i];
+	}
+}
+
+int ShardedMemTable::ShardOf(const char *row) {
+	uint32_t h = ColumnOps::Hash(schema_->GetIndexType(),
+			schema_->GetColumnSize(schema_->GetIndexNumber()),
+			row + schema_->GetIndexPos(), 0);
+	return h % shards_.size();
+}
+
+bool ShardedMemTable::InsertRow(RwRow &row, bool update) {
+	//the shard goes by the index column, which may be the encoded key
+	row.EncodeKey();
+	int s = ShardOf(row.Buffer());
+	std::lock_guard<std::mutex> l(*locks_[s]);
+	return shards_[s]->InsertRow(row, update);
+}
+
+void ShardedMemTable::Clear() {
+	for (size_t i = 0; i < shards_.size(); i++) {
+		std::lock_guard<std::mutex> l(*locks_[i]);
+		shards_[i]->Clear();
+	}
+}
+
+/*-----------------ShardedMemTable::Iterator---------------*/
+//Merges the shard iterators the way leveldb's MergingIterator merges its
+//children, including the direction switches for Next/Prev.
+ShardedMemTable::Iterator::Iterator(ShardedMemTable* table) :
+		table_(table), current_(-1), forward_(true), single_(false) {
+	for (size_t i = 0; i < table_->shards_.size(); i++)
+		children_.push_back(MemTable::Iterator(table_->shards_[i]));
+	FindSmallest();
+}
+
+bool ShardedMemTable::Iterator::Valid() {
+	return current_ >= 0;
+}
+
+RdOnlyRow &ShardedMemTable::Iterator::RowAt(RdOnlyRow &r) {
+	return children_[current_].RowAt(r);
+}
+
+void ShardedMemTable::Iterator::FindSmallest() {
+	TableSchema *s = table_->schema_;
+	RdOnlyRow r(s);
+	char *smallest = NULL;
+	current_ = -1;
+	for (size_t i = 0; i < children_.size(); i++) {
+		if (!children_[i].Valid())
+			continue;
+		char *row = children_[i].RowAt(r).Buffer();
+		if (smallest == NULL || RdOnlyRow::LessThan(row, smallest, s)) {
+			smallest = row;
+			current_ = i;
+		}
+	}
+}
+
+void ShardedMemTable::Iterator::FindLargest() {
+	TableSchema *s = table_->schema_;
+	RdOnlyRow r(s);
+	char *largest = NULL;
+	current_ = -1;
+	for (size_t i = 0; i < children_.size(); i++) {
+		if (!children_[i].Valid())
+			continue;
+		char *row = children_[i].RowAt(r).Buffer();
+		if (largest == NULL || RdOnlyRow::LessThan(largest, row, s)) {
+			largest = row;
+			current_ = i;
+		}
+	}
+}
+
+//Positions every shard but the current one at its first row >= row.
+//Rows are unique across shards, so none of them is equal to row.
+void ShardedMemTable::Iterator::SeekOthers(char *row) {
+	RdOnlyRow target(table_->schema_, row);
+	for (size_t i = 0; i < children_.size(); i++) {
+		if ((int) i != current_)
+			children_[i].SeekRow(target);
+	}
+	single_ = false;
+}
+
+void ShardedMemTable::Iterator::SeekToFirst() {
+	for (size_t i = 0; i < children_.size(); i++)
+		children_[i].SeekToFirst();
+	forward_ = true;
+	single_ = false;
+	FindSmallest();
+}
+
+void ShardedMemTable::Iterator::SeekToLast() {
+	for (size_t i = 0; i < children_.size(); i++)
+		children_[i].SeekToLast();
+	forward_ = false;
+	single_ = false;
+	FindLargest();
+}
+
+void ShardedMemTable::Iterator::SeekRow(RdOnlyRow &r) {
+	forward_ = true;
+	int home = table_->ShardOf(r.Buffer());
+	MemTable::Iterator &it = children_[home];
+	it.SeekRow(r);
+	RdOnlyRow cur(table_->schema_);
+	if (it.Valid()
+			&& SameIndexKey(table_->schema_, it.RowAt(cur).Buffer(),
+					r.Buffer())) {
+		//every row between the target and this one would share its index
+		//key, and all of those live in this shard
+		current_ = home;
+		single_ = true;
+		return;
+	}
+	for (size_t i = 0; i < children_.size(); i++) {
+		if ((int) i != home)
+			children_[i].SeekRow(r);
+	}
+	single_ = false;
+	FindSmallest();
+}
+
+void ShardedMemTable::Iterator::Next() {
+	assert(Valid());
+	char *row = Current();
+	if (single_) {
+		MemTable::Iterator &it = children_[current_];
+		it.Next();
+		RdOnlyRow cur(table_->schema_);
+		if (it.Valid()
+				&& SameIndexKey(table_->schema_, it.RowAt(cur).Buffer(), row))
+			return;
+		SeekOthers(row);
+		FindSmallest();
+		return;
+	}
+	if (!forward_) {
+		SeekOthers(row);
+		forward_ = true;
+	}
+	children_[current_].Next();
+	FindSmallest();
+}
+
+void ShardedMemTable::Iterator::Prev() {
+	assert(Valid());
+	if (single_ || forward_) {
+		//position the other shards at their last row before the current one
+		char *row = Current();
+		SeekOthers(row);
+		for (size_t i = 0; i < children_.size(); i++) {
+			if ((int) i == current_)
+				continue;
+			if (children_[i].Valid())
+				children_[i].Prev();
+			else
+				children_[i].SeekToLast();
+		}
+		forward_ = false;
+	}
+	children_[current_].Prev();
+	FindLargest();
+}
+
+} //namespace memdb
@@ -0,0 +1,124 @@
+/*
+ * sharded_memtable.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: jinyang
+ */
+
+#ifndef MEMDB_DB_SHARDED_MEMTABLE_H_
+#define MEMDB_DB_SHARDED_MEMTABLE_H_
+
+#include "db/memtable.h"
+#include <mutex>
+#include <vector>
+
+namespace memdb {
+
+// A table split into independent MemTables by a hash of the index column,
+// each with its own writer lock, so inserts from several threads into
+// different shards do not contend. All rows with the same index key live
+// in one shard: a Seek that lands on its key touches only that shard, while
+// scans merge the shards and see the same order a single MemTable gives.
+//
+// Shards inherit options; with options.concurrent iterators may run while
+// rows are inserted, as for MemTable. Shard i logs to options.wal_path
+// followed by ".i".
+class ShardedMemTable {
+public:
+	ShardedMemTable(TableSchema *schema, int nshards,
+			const MemTableOptions &options = MemTableOptions());
+	~ShardedMemTable();
+
+	bool InsertRow(RwRow &row, bool update = true);
+	void Clear();
+
+	TableSchema *GetSchema() {
+		return schema_;
+	}
+	int NumShards() {
+		return shards_.size();
+	}
+	MemTable *Shard(int i) {
+		return shards_[i];
+	}
+	// The shard that holds rows with the index key of row
+	int ShardOf(const char *row);
+
+	// Same interface as MemTable::Iterator, merging the shards
+	class Iterator {
+	public:
+		explicit Iterator(ShardedMemTable* table);
+
+		bool Valid();
+		template<class T> bool Valid(const T &key);
+		template<class T, class U> bool Valid(const T &key, const U &primary);
+
+		// REQUIRES: Valid()
+		RdOnlyRow & RowAt(RdOnlyRow &r);
+		void Next();
+		void Prev();
+
+		template<class T> void Seek(const T &key);
+		template<class T, class U> void Seek(const T &key, const U &primary);
+		void SeekRow(RdOnlyRow &r);
+		void SeekToFirst();
+		void SeekToLast();
+
+	private:
+		char *Current() {
+			RdOnlyRow r(table_->schema_);
+			return children_[current_].RowAt(r).Buffer();
+		}
+		void FindSmallest();
+		void FindLargest();
+		void SeekOthers(char *row);
+
+		ShardedMemTable *table_;
+		std::vector<MemTable::Iterator> children_;
+		int current_; //-1 when not Valid()
+		bool forward_;
+		// Only children_[current_] is positioned, at a row with the index
+		// key of the last Seek; the other shards cannot hold such rows
+		bool single_;
+	};
+
+private:
+	TableSchema *schema_;
+	std::vector<MemTable *> shards_;
+	std::vector<std::mutex *> locks_;
+
+	//no copying allowed
+	ShardedMemTable(const ShardedMemTable &);
+	void operator=(const ShardedMemTable &);
+};
+
+template<class T> bool ShardedMemTable::Iterator::Valid(const T &key) {
+	return current_ >= 0 && children_[current_].Valid(key);
+}
+
+template<class T, class U> bool ShardedMemTable::Iterator::Valid(
+		const T &key, const U &primary) {
+	return current_ >= 0 && children_[current_].Valid(key, primary);
+}
+
+template<class T> void ShardedMemTable::Iterator::Seek(const T &key) {
+	ProbeRow p(table_->schema_);
+	p.SetScanStart(0);
+	p.PutColumn(key, table_->schema_->GetIndexNumber());
+	RdOnlyRow r(table_->schema_, p.Buffer());
+	SeekRow(r);
+}
+
+template<class T, class U> void ShardedMemTable::Iterator::Seek(const T &key,
+		const U &primary) {
+	ProbeRow p(table_->schema_);
+	p.SetScanStart(0);
+	p.PutColumn(key, table_->schema_->GetIndexNumber());
+	p.PutColumn(primary, table_->schema_->GetPrimaryNumber());
+	RdOnlyRow r(table_->schema_, p.Buffer());
+	SeekRow(r);
+}
+
+} //namespace memdb
+
+#endif
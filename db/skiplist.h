@@ -0,0 +1,341 @@
+/*
+ * skiplist.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: jinyang
+ */
+
+#ifndef MEMDB_DB_SKIPLIST_H_
+#define MEMDB_DB_SKIPLIST_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <atomic>
+#include <new>
+#include <vector>
+#include "db/rowindex.h"
+#include "util/epoch.h"
+
+namespace memdb {
+
+// Row index that readers can search and iterate without locks while a
+// writer inserts, adapted from leveldb's skiplist.
+//
+// Thread safety: writes (Insert, BulkLoad, Clear) need external
+// synchronization, most likely a mutex. Reads need only that the index and
+// any row they can reach are not freed while they run; MemTable retires
+// replaced rows through an EpochManager for that. Nodes are never unlinked
+// before the index is destroyed or cleared, except by Remove, which hands
+// them to the EpochManager given at construction.
+//
+// Like BTreeIndex every node keeps the 64-bit key prefix of its row, and
+// Compare has the same requirements.
+template<class Compare>
+class SkipListIndex: public RowIndex {
+public:
+	// Removed nodes are retired through epoch, or freed at once if it is NULL
+	explicit SkipListIndex(const Compare &cmp, EpochManager *epoch = NULL);
+	virtual ~SkipListIndex();
+
+	virtual bool Insert(char *row, bool replace, char **old);
+	virtual void BulkLoad(char **rows, size_t n, bool replace,
+			std::vector<char *> *displaced);
+	virtual char *Find(const char *probe) {
+		uint64_t k = cmp_.Prefix(probe);
+		Node *x = FindGreaterOrEqual(k, probe, NULL);
+		if (x == NULL || Less(k, probe, x))
+			return NULL;
+		return x->row.load(std::memory_order_acquire);
+	}
+	virtual bool Remove(const char *probe, char **old);
+	virtual void Clear();
+	virtual size_t Size() {
+		return size_.load(std::memory_order_relaxed);
+	}
+	virtual size_t MemoryUsage() {
+		return sizeof(*this) + node_bytes_.load(std::memory_order_relaxed);
+	}
+	virtual uint64_t KeyPrefix(const char *row) {
+		return cmp_.Prefix(row);
+	}
+
+	virtual void SeekToFirst(IndexPos *p) {
+		p->node = head_->Next(0);
+		p->slot = 0;
+	}
+	virtual void SeekToLast(IndexPos *p);
+	virtual void Seek(IndexPos *p, const char *probe) {
+		p->node = FindGreaterOrEqual(cmp_.Prefix(probe), probe, NULL);
+		p->slot = 0;
+	}
+	virtual void Next(IndexPos *p) {
+		p->node = ((Node *) p->node)->Next(0);
+	}
+	virtual void Prev(IndexPos *p);
+	virtual char *RowAt(const IndexPos &p) {
+		return ((Node *) p.node)->row.load(std::memory_order_acquire);
+	}
+
+private:
+	enum {
+		kMaxHeight = 16, kBranching = 4
+	};
+
+	struct Node {
+		uint64_t key;
+		std::atomic<char *> row; //swapped in place when a row is replaced
+
+		Node *Next(int n) {
+			return next_[n].load(std::memory_order_acquire);
+		}
+		void SetNext(int n, Node *x) {
+			next_[n].store(x, std::memory_order_release);
+		}
+		Node *NoBarrier_Next(int n) {
+			return next_[n].load(std::memory_order_relaxed);
+		}
+		void NoBarrier_SetNext(int n, Node *x) {
+			next_[n].store(x, std::memory_order_relaxed);
+		}
+
+		//array of length equal to the node height, next_[0] is the lowest level
+		std::atomic<Node *> next_[1];
+	};
+
+	static size_t NodeSize(int height) {
+		return sizeof(Node) + sizeof(std::atomic<Node *>) * (height - 1);
+	}
+	Node *NewNode(uint64_t key, char *row, int height);
+	static void FreeNode(void *arg, void *node) {
+		free(node);
+	}
+	int RandomHeight();
+
+	bool Less(uint64_t k1, const char *r1, Node *n) const {
+		if (k1 != n->key)
+			return k1 < n->key;
+		if (cmp_.PrefixIsKey())
+			return false;
+		return cmp_.Less(r1, n->row.load(std::memory_order_acquire));
+	}
+
+	bool KeyIsAfterNode(uint64_t k, const char *r, Node *n) const {
+		if (n == NULL)
+			return false;
+		if (n->key != k)
+			return n->key < k;
+		if (cmp_.PrefixIsKey())
+			return false;
+		return cmp_.Less(n->row.load(std::memory_order_acquire), r);
+	}
+
+	// Returns the earliest node at or after the key, NULL if there is none.
+	// If prev is non-NULL, fills prev[level] with the last node before it.
+	Node *FindGreaterOrEqual(uint64_t k, const char *r, Node **prev) const;
+	// Returns the last node before the key, head_ if there is none
+	Node *FindLessThan(uint64_t k, const char *r) const;
+
+	Compare cmp_;
+	EpochManager *epoch_;
+	Node *head_;
+	std::atomic<int> max_height_;
+	std::atomic<size_t> size_;
+	std::atomic<size_t> node_bytes_; //nodes linked into the list, head_ included
+	uint32_t rnd_;
+};
+
+template<class Compare>
+SkipListIndex<Compare>::SkipListIndex(const Compare &cmp,
+		EpochManager *epoch) :
+		cmp_(cmp), epoch_(epoch), max_height_(1), size_(0), node_bytes_(0),
+		rnd_(0xdeadbeef) {
+	head_ = NewNode(0, NULL, kMaxHeight);
+}
+
+template<class Compare>
+SkipListIndex<Compare>::~SkipListIndex() {
+	Clear();
+	free(head_);
+}
+
+template<class Compare>
+typename SkipListIndex<Compare>::Node *
+SkipListIndex<Compare>::NewNode(uint64_t key, char *row, int height) {
+	char *mem = (char *) malloc(NodeSize(height));
+	assert(mem);
+	node_bytes_.fetch_add(NodeSize(height), std::memory_order_relaxed);
+	Node *x = (Node *) mem;
+	x->key = key;
+	new (&x->row) std::atomic<char *>(row);
+	for (int i = 0; i < height; i++)
+		new (&x->next_[i]) std::atomic<Node *>(NULL);
+	return x;
+}
+
+template<class Compare>
+int SkipListIndex<Compare>::RandomHeight() {
+	int height = 1;
+	for (;;) {
+		rnd_ ^= rnd_ << 13;
+		rnd_ ^= rnd_ >> 17;
+		rnd_ ^= rnd_ << 5;
+		if (height >= kMaxHeight || (rnd_ % kBranching) != 0)
+			break;
+		height++;
+	}
+	return height;
+}
+
+template<class Compare>
+typename SkipListIndex<Compare>::Node *
+SkipListIndex<Compare>::FindGreaterOrEqual(uint64_t k, const char *r,
+		Node **prev) const {
+	Node *x = head_;
+	int level = max_height_.load(std::memory_order_relaxed) - 1;
+	while (true) {
+		Node *next = x->Next(level);
+		if (KeyIsAfterNode(k, r, next)) {
+			x = next;
+		} else {
+			if (prev != NULL)
+				prev[level] = x;
+			if (level == 0)
+				return next;
+			level--;
+		}
+	}
+}
+
+template<class Compare>
+typename SkipListIndex<Compare>::Node *
+SkipListIndex<Compare>::FindLessThan(uint64_t k, const char *r) const {
+	Node *x = head_;
+	int level = max_height_.load(std::memory_order_relaxed) - 1;
+	while (true) {
+		Node *next = x->Next(level);
+		if (KeyIsAfterNode(k, r, next)) {
+			x = next;
+		} else {
+			if (level == 0)
+				return x;
+			level--;
+		}
+	}
+}
+
+template<class Compare>
+bool SkipListIndex<Compare>::Insert(char *row, bool replace, char **old) {
+	uint64_t k = cmp_.Prefix(row);
+	Node *prev[kMaxHeight];
+	Node *x = FindGreaterOrEqual(k, row, prev);
+	if (x != NULL && !Less(k, row, x)) {
+		if (!replace)
+			return false;
+		*old = x->row.load(std::memory_order_relaxed);
+		x->row.store(row, std::memory_order_release);
+		return true;
+	}
+
+	int height = RandomHeight();
+	int max_height = max_height_.load(std::memory_order_relaxed);
+	if (height > max_height) {
+		for (int i = max_height; i < height; i++)
+			prev[i] = head_;
+		//readers that see the new height before the new node find NULL
+		//pointers from head_ at those levels, which is fine
+		max_height_.store(height, std::memory_order_relaxed);
+	}
+
+	x = NewNode(k, row, height);
+	for (int i = 0; i < height; i++) {
+		x->NoBarrier_SetNext(i, prev[i]->NoBarrier_Next(i));
+		prev[i]->SetNext(i, x);
+	}
+	size_.fetch_add(1, std::memory_order_relaxed);
+	return true;
+}
+
+//Readers may be walking the list, so there is no bottom-up rebuild here
+template<class Compare>
+void SkipListIndex<Compare>::BulkLoad(char **rows, size_t n, bool replace,
+		std::vector<char *> *displaced) {
+	for (size_t i = 0; i < n; i++) {
+		char *old = NULL;
+		if (!Insert(rows[i], replace, &old))
+			rows[i] = NULL;
+		else if (old)
+			displaced->push_back(old);
+	}
+}
+
+//Unlinks the node top-down; its own links stay intact, so a reader standing
+//on it still reaches the rest of the list
+template<class Compare>
+bool SkipListIndex<Compare>::Remove(const char *probe, char **old) {
+	uint64_t k = cmp_.Prefix(probe);
+	Node *prev[kMaxHeight];
+	Node *x = FindGreaterOrEqual(k, probe, prev);
+	if (x == NULL || Less(k, probe, x))
+		return false;
+	int height = 0;
+	for (int i = max_height_.load(std::memory_order_relaxed) - 1; i >= 0; i--) {
+		if (prev[i]->NoBarrier_Next(i) == x) {
+			prev[i]->SetNext(i, x->NoBarrier_Next(i));
+			height++;
+		}
+	}
+	*old = x->row.load(std::memory_order_relaxed);
+	size_.fetch_sub(1, std::memory_order_relaxed);
+	node_bytes_.fetch_sub(NodeSize(height), std::memory_order_relaxed);
+	if (epoch_)
+		epoch_->Retire(&FreeNode, NULL, x);
+	else
+		free(x);
+	return true;
+}
+
+template<class Compare>
+void SkipListIndex<Compare>::Clear() {
+	Node *x = head_->NoBarrier_Next(0);
+	while (x) {
+		Node *next = x->NoBarrier_Next(0);
+		free(x);
+		x = next;
+	}
+	for (int i = 0; i < kMaxHeight; i++)
+		head_->NoBarrier_SetNext(i, NULL);
+	max_height_.store(1, std::memory_order_relaxed);
+	size_.store(0, std::memory_order_relaxed);
+	node_bytes_.store(NodeSize(kMaxHeight), std::memory_order_relaxed);
+}
+
+template<class Compare>
+void SkipListIndex<Compare>::SeekToLast(IndexPos *p) {
+	Node *x = head_;
+	int level = max_height_.load(std::memory_order_relaxed) - 1;
+	while (true) {
+		Node *next = x->Next(level);
+		if (next == NULL) {
+			if (level == 0)
+				break;
+			level--;
+		} else {
+			x = next;
+		}
+	}
+	p->node = (x == head_) ? NULL : x;
+	p->slot = 0;
+}
+
+//There are no back links, search for the last node before the current one
+template<class Compare>
+void SkipListIndex<Compare>::Prev(IndexPos *p) {
+	Node *n = (Node *) p->node;
+	Node *x = FindLessThan(n->key, n->row.load(std::memory_order_acquire));
+	p->node = (x == head_) ? NULL : x;
+}
+
+} //namespace memdb
+
+#endif
@@ -6,14 +6,48 @@
  */
 
 #include "tableschema.h"
+#include "db/rowformat.h"
+#include "db/comparator.h"
+#include "db/dictionary.h"
+#include "util/arena.h"
 #include "assert.h"
 
+#include <algorithm>
 #include <string>
 #include <strings.h>
 
 namespace memdb {
 
-const int TableSchema::cTypeToSize[2] = { sizeof(int), sizeof(void *) };
+//A string column is only read 4 bytes at a time
+int TableSchema::Alignment(column_t type) {
+	switch (type) {
+	case cInt64:
+	case cDouble:
+	case cTimestamp:
+		return 8;
+	case cBinary:
+		return 1;
+	default:
+		return 4;
+	}
+}
+
+static int ColumnSize(column_t type, int width) {
+	switch (type) {
+	case cInt32:
+		return sizeof(int);
+	case cString:
+		return StrColumn::kSize;
+	case cBinary:
+		return width;
+	default:
+		return sizeof(int64_t);
+	}
+}
+
+static int RoundUp(int n, int align) {
+	return (n + align - 1) / align * align;
+}
 
 TableSchema::TableSchema(int NumColumns, const std::string cnames[],
 		const column_t ctypes[], std::string primary_column) {
@@ -23,28 +57,92 @@ TableSchema::TableSchema(int NumColumns, const std::string cnames[],
 		vname.push_back(cnames[i]);
 		vtype.push_back(ctypes[i]);
 	}
-	init(vname,vtype,primary_column);
+	init(vname, vtype, std::vector<int>(), primary_column);
 }
 
 TableSchema::TableSchema(const std::vector<std::string> &cnames,
 		const std::vector<column_t> &ctypes, std::string primary_column) {
 
-	init(cnames, ctypes, primary_column);
+	init(cnames, ctypes, std::vector<int>(), primary_column);
+}
+
+TableSchema::TableSchema(const std::vector<std::string> &cnames,
+		const std::vector<column_t> &ctypes, const std::vector<int> &widths,
+		std::string primary_column) {
+	init(cnames, ctypes, widths, primary_column);
+}
+
+TableSchema::~TableSchema() {
+	delete arena_;
+	for (size_t i = 0; i < dicts_.size(); i++)
+		delete dicts_[i];
 }
 
 void TableSchema::init(const std::vector<std::string> &cnames,
-		const std::vector<column_t> &ctypes, std::string primary_column) {
-	row_byte_sz_ = 0;
+		const std::vector<column_t> &ctypes, const std::vector<int> &widths,
+		std::string primary_column) {
 	primary_ = 0;
-	for (int i = 0; i < cnames.size(); i++) {
+	version_pos_ = -1;
+	arena_ = NULL;
+	allocated_.store(false);
+	indexes_.push_back(0);
+	for (size_t i = 0; i < cnames.size(); i++) {
 		cnames_.push_back(cnames[i]);
 		ctypes_.push_back(ctypes[i]);
-		cpos_.push_back(row_byte_sz_);
+		assert(ctypes[i] != cBinary || (i < widths.size() && widths[i] > 0));
+		csize_.push_back(ColumnSize(ctypes[i], i < widths.size() ? widths[i] : 0));
+		dicts_.push_back(NULL);
 		if (cnames[i] == primary_column) {
 			primary_ = i;
 		}
-		row_byte_sz_ += cTypeToSize[ctypes[i]];
 	}
+	Layout();
+}
+
+void TableSchema::Layout() {
+	//the key columns in front, in order, then the rest by alignment
+	int index = indexes_[0];
+	std::vector<std::pair<int, int> > rest; //(-alignment, column)
+	for (int i = 0; i < NumColumns(); i++) {
+		if (i != index && i != primary_)
+			rest.push_back(std::make_pair(-Alignment(ctypes_[i]), i));
+	}
+	std::stable_sort(rest.begin(), rest.end());
+	std::vector<int> order;
+	order.push_back(index);
+	if (primary_ != index)
+		order.push_back(primary_);
+	size_t nkeys = order.size();
+	for (size_t i = 0; i < rest.size(); i++)
+		order.push_back(rest[i].second);
+
+	cpos_.assign(NumColumns(), 0);
+	std::vector<std::pair<int, int> > gaps; //[start, end) left by alignment
+	int end = 0, maxalign = 1;
+	for (size_t k = 0; k < order.size(); k++) {
+		int c = order[k], align = Alignment(ctypes_[c]);
+		maxalign = std::max(maxalign, align);
+		bool placed = false;
+		for (size_t g = 0; k >= nkeys && !placed && g < gaps.size(); g++) {
+			int start = RoundUp(gaps[g].first, align);
+			if (start + csize_[c] > gaps[g].second)
+				continue;
+			cpos_[c] = start;
+			placed = true;
+			int gapend = gaps[g].second;
+			gaps[g].second = start;
+			if (start + csize_[c] < gapend)
+				gaps.push_back(std::make_pair(start + csize_[c], gapend));
+		}
+		if (placed)
+			continue;
+		int start = RoundUp(end, align);
+		if (start > end)
+			gaps.push_back(std::make_pair(end, start));
+		cpos_[c] = start;
+		end = start + csize_[c];
+	}
+	row_byte_sz_ = RoundUp(end, maxalign);
 }
 
 int TableSchema::GetColumnNumber(std::string name) {
@@ -55,17 +153,156 @@ int TableSchema::GetColumnNumber(std::string name) {
 	return -1;
 }
 
+void TableSchema::SetKey(const std::vector<std::string> &columns,
+		const std::vector<bool> &descending) {
+	assert(arena_ == NULL && version_pos_ < 0 && !HasCompositeKey());
+	assert(!columns.empty());
+	for (size_t i = 0; i < columns.size(); i++) {
+		int c = GetColumnNumber(columns[i]);
+		assert(c >= 0);
+		key_columns_.push_back(c);
+		key_descending_.push_back(i < descending.size() && descending[i]);
+	}
+	cnames_.push_back("__key");
+	ctypes_.push_back(cString);
+	csize_.push_back(ColumnSize(cString, 0));
+	dicts_.push_back(NULL);
+	primary_ = indexes_[0] = NumColumns() - 1;
+	Layout();
+}
+
+//Sized first, so that the key is encoded straight into the column or the
+//copy it will own
+void TableSchema::EncodeKey(char *row) {
+	size_t n = 0;
+	for (size_t i = 0; i < key_columns_.size(); i++) {
+		int c = key_columns_[i];
+		n += KeyCoding::ColumnSize(ctypes_[c], csize_[c], row + cpos_[c]);
+	}
+	char *col = row + cpos_[indexes_[0]];
+	FreeString(indexes_[0], col);
+	char small[StrColumn::kInline];
+	char *dst = StrColumn::IsInline(n) ? small : AllocString(n + 1);
+	KeyWriter w(dst);
+	for (size_t i = 0; i < key_columns_.size(); i++) {
+		int c = key_columns_[i];
+		KeyCoding::AppendColumn(ctypes_[c], csize_[c], row + cpos_[c],
+				key_descending_[i], &w);
+	}
+	assert(w.p == dst + n);
+	if (dst == small) {
+		StrColumn::SetInline(col, small, n);
+		return;
+	}
+	dst[n] = '\0';
+	StrColumn::SetView(col, dst, n);
+}
+
+bool TableSchema::IsKeyColumn(int c) {
+	if (c == indexes_[0] || c == primary_)
+		return true;
+	for (size_t i = 0; i < key_columns_.size(); i++) {
+		if (key_columns_[i] == c)
+			return true;
+	}
+	return false;
+}
+
+int TableSchema::AddIndex(const std::string &column) {
+	int c = GetColumnNumber(column);
+	assert(c >= 0);
+	indexes_.push_back(c);
+	return indexes_.size() - 1;
+}
+
+void TableSchema::EnableVersions() {
+	assert(arena_ == NULL && version_pos_ < 0);
+	version_pos_ = (row_byte_sz_ + 7) / 8 * 8;
+	row_byte_sz_ = version_pos_ + sizeof(RowVersion);
+}
+
+void TableSchema::EnableArena() {
+	assert(arena_ == NULL && version_pos_ < 0);
+	arena_ = new Arena(row_byte_sz_);
+}
+
+void TableSchema::ResetArena() {
+	assert(arena_);
+	arena_->Reset();
+}
+
 char *TableSchema::AllocRowBuffer() {
+	//read first so that steady state allocations leave the line shared
+	if (!allocated_.load(std::memory_order_relaxed))
+		allocated_.store(true, std::memory_order_relaxed);
+	if (arena_)
+		return arena_->AllocRow();
 	char *buf = (char *) malloc(row_byte_sz_);
 	assert(buf);
 	bzero(buf, row_byte_sz_);
 	return buf;
 }
 
+void TableSchema::EnableDictionary(const std::string &column) {
+	int c = GetColumnNumber(column);
+	assert(c >= 0 && ctypes_[c] == cString && dicts_[c] == NULL);
+	assert(!HasCompositeKey() || c != indexes_[0]);
+	//rows already written own their long strings, which FreeString would leak
+	assert(!allocated_.load());
+	dicts_[c] = new StringDict();
+}
+
+size_t TableSchema::DictionaryBytes() {
+	size_t n = 0;
+	for (size_t i = 0; i < dicts_.size(); i++) {
+		if (dicts_[i])
+			n += dicts_[i]->MemoryUsage();
+	}
+	return n;
+}
+
+void TableSchema::SetString(int c, char *col, const Slice &s) {
+	if (StrColumn::IsInline(s.size())) {
+		StrColumn::SetInline(col, s.data(), s.size());
+		return;
+	}
+	if (dicts_[c]) {
+		StrColumn::SetView(col, dicts_[c]->Intern(s), s.size());
+		return;
+	}
+	StrColumn::Set(col, s.data(), s.size(), AllocString(s.size() + 1));
+}
+
+char *TableSchema::AllocString(size_t n) {
+	char *s = arena_ ? arena_->Allocate(n) : (char *) malloc(n);
+	assert(s);
+	return s;
+}
+
+//an arena keeps strings until it is reset, a dictionary for good
+void TableSchema::FreeString(int c, char *col) {
+	if (arena_ == NULL && dicts_[c] == NULL)
+		free(StrColumn::Heap(col));
+}
+
+void TableSchema::ClearRowBuffer(char *buf) {
+	for (size_t i = 0; i < ctypes_.size(); i++) {
+		if (ctypes_[i] == cString) {
+			FreeString(i, buf + cpos_[i]);
+		}
+	}
+	bzero(buf, row_byte_sz_);
+}
+
 void TableSchema::FreeRowBuffer(char *buf)  {
+	if (arena_) {
+		//strings stay in the heap until ResetArena()
+		arena_->FreeRow(buf);
+		return;
+	}
 	for (int i = 0; i < ctypes_.size(); i++) {
 		if (ctypes_[i] == cString) {
-			free(*(char **) (buf + cpos_[i]));
+			FreeString(i, buf + cpos_[i]);
 		}
 	}
 	free(buf);
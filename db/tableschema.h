@@ -8,29 +8,178 @@
 #ifndef MEMDB_DB_TABLESCHEMA_H_
 #define MEMDB_DB_TABLESCHEMA_H_
 
+#include <assert.h>
+#include <stdint.h>
+#include <atomic>
 #include <vector>
 #include <string>
+#include "db/rowformat.h"
+#include "util/slice.h"
 
 namespace memdb {
 
+class Arena;
+class StringDict;
+
 typedef enum {
-	cInt32 = 0, cString = 1 /*deal with only two types first*/
+	cInt32 = 0, cString = 1, cInt64 = 2, cDouble = 3,
+	cTimestamp = 4, //an int64 of microseconds since the epoch
+	cBinary = 5 //a fixed number of bytes, zero padded, ordered as bytes
 } column_t;
 
+// The value of a cTimestamp column, a distinct type so that it picks the
+// right column type wherever a column is written through a C++ value
+struct Timestamp {
+	Timestamp() :
+			micros(0) {
+	}
+	explicit Timestamp(int64_t us) :
+			micros(us) {
+	}
+	int64_t micros;
+};
+
+inline bool operator==(const Timestamp &a, const Timestamp &b) {
+	return a.micros == b.micros;
+}
+inline bool operator!=(const Timestamp &a, const Timestamp &b) {
+	return a.micros != b.micros;
+}
+inline bool operator<(const Timestamp &a, const Timestamp &b) {
+	return a.micros < b.micros;
+}
+inline bool operator>(const Timestamp &a, const Timestamp &b) {
+	return a.micros > b.micros;
+}
+
+// Maps a C++ type to the column type that stores it and reads it out of
+// the column's bytes in a row buffer
+template<class T> struct ColumnTraits;
+
+template<> struct ColumnTraits<int> {
+	static const column_t kType = cInt32;
+	static int Read(const char *col) {
+		return *(const int *) col;
+	}
+};
+
+template<> struct ColumnTraits<int64_t> {
+	static const column_t kType = cInt64;
+	static int64_t Read(const char *col) {
+		return *(const int64_t *) col;
+	}
+};
+
+template<> struct ColumnTraits<double> {
+	static const column_t kType = cDouble;
+	static double Read(const char *col) {
+		return *(const double *) col;
+	}
+};
+
+template<> struct ColumnTraits<Timestamp> {
+	static const column_t kType = cTimestamp;
+	static Timestamp Read(const char *col) {
+		return Timestamp(*(const int64_t *) col);
+	}
+};
+
+template<> struct ColumnTraits<Slice> {
+	static const column_t kType = cString;
+	static Slice Read(const char *col) {
+		return Slice(StrColumn::Data(col), StrColumn::Length(col));
+	}
+};
+
+// A column whose type has been checked against T, resolved to its offset
+// in the row buffer. Obtained from TableSchema::GetColumnRef.
+template<class T> class ColumnRef {
+public:
+	int Pos() const {
+		return pos_;
+	}
+private:
+	friend class TableSchema;
+	explicit ColumnRef(int pos) :
+			pos_(pos) {
+	}
+	int pos_;
+};
+
+// Columns are not laid out in declaration order: the main index column
+// and the primary (or the encoded key, with SetKey) come first, so that
+// comparisons touch the front of the row, and the rest follow by
+// decreasing alignment, with smaller columns moved into any gap the key
+// columns leave. The only padding is then at the end of the row, to keep
+// the next row of an arena aligned.
 class TableSchema {
 public:
 
 	TableSchema(int NumColumns, const std::string cnames[], const column_t ctypes[], std::string primary);
 	TableSchema(const std::vector<std::string> & cnames, const std::vector<column_t> &ctypes, std::string primary);
+	// widths[i] is the size of column i if it is cBinary, else ignored
+	TableSchema(const std::vector<std::string> &cnames,
+			const std::vector<column_t> &ctypes, const std::vector<int> &widths,
+			std::string primary);
 	~TableSchema();
-	void init(const std::vector<std::string> & cnames, const std::vector<column_t> &ctypes, std::string primary);
+	void init(const std::vector<std::string> & cnames, const std::vector<column_t> &ctypes, const std::vector<int> &widths, std::string primary);
 
 	int NumColumns() {
 		return ctypes_.size();
 	}
+	// Bytes in a row buffer
+	int RowSize() {
+		return row_byte_sz_;
+	}
 
 	char *AllocRowBuffer();
 	void FreeRowBuffer(char *buf);
+	// Empties a row buffer for reuse: frees its strings, as FreeRowBuffer
+	// would, and zeroes it
+	void ClearRowBuffer(char *buf);
+	// Fills in string column c at col with a copy of s, or the interned
+	// one if the column has a dictionary. The copy is released by
+	// FreeRowBuffer or FreeString.
+	void SetString(int c, char *col, const Slice &s);
+	// Releases the copy held by string column c at col, which still
+	// refers to it
+	void FreeString(int c, char *col);
+
+	// Switch to arena allocation: row buffers come from fixed-size slabs and
+	// strings from a bump heap owned by this schema. Must be called before
+	// the first row is allocated, and the schema should then back a single
+	// MemTable since ResetArena() drops every row at once.
+	void EnableArena();
+	Arena *GetArena() {
+		return arena_;
+	}
+
+	// Reserve a RowVersion header in every row buffer, as tables with
+	// MemTableOptions::snapshots need. Must be called before the first row
+	// is allocated; not with an arena.
+	void EnableVersions();
+	// Offset of the RowVersion header, -1 without versions
+	int GetVersionPos() {
+		return version_pos_;
+	}
+	// Frees all rows and strings in O(chunks).
+	// REQUIRES: arena mode, no RwRow still holding a buffer
+	void ResetArena();
+
+	// Interns the long strings of the named string column: rows point at
+	// one shared copy of each distinct value rather than their own, which
+	// pays off for columns with few long values. Strings short enough to
+	// stay in the row are kept there. Rows keep the 16-byte string column,
+	// and values still compare as strings; equal ones only skip the memcmp
+	// by sharing an address. The copies last as long as the schema.
+	// REQUIRES: no row allocated yet; not the key column of SetKey
+	void EnableDictionary(const std::string &column);
+	// The dictionary of column c, NULL if it has none
+	StringDict *GetDictionary(int c) {
+		return dicts_[c];
+	}
+	// Bytes held by the dictionaries of all columns
+	size_t DictionaryBytes();
 
 	column_t GetColumnType(int c) {
 		return ctypes_[c];
@@ -43,17 +192,69 @@ public:
 	int GetColumnPos(int c) {
 		return cpos_[c];
 	}
+	// Bytes column c takes in a row buffer
+	int GetColumnSize(int c) {
+		return csize_[c];
+	}
+	// The boundary a column of this type starts at within a row
+	static int Alignment(column_t type);
+
+	// Checks once that column c holds a T, so that reads through the
+	// returned reference need no further checks
+	template<class T> ColumnRef<T> GetColumnRef(int c) {
+		assert(ctypes_[c] == ColumnTraits<T>::kType);
+		return ColumnRef<T>(cpos_[c]);
+	}
+
+	// Orders the main index by the named columns, in turn, each ascending
+	// unless descending[i]. A row's key columns are encoded into one byte
+	// string that compares with memcmp (KeyCoding, db/comparator.h), held
+	// by an extra string column appended to the schema, which is both the
+	// index column and the primary. The key of a RwRow is encoded when it
+	// is inserted; lookups take a key built with KeyBuilder.
+	// REQUIRES: no MemTable has been created and no row allocated yet
+	void SetKey(const std::vector<std::string> &columns,
+			const std::vector<bool> &descending = std::vector<bool>());
+	bool HasCompositeKey() {
+		return !key_columns_.empty();
+	}
+	int NumKeyColumns() {
+		return key_columns_.size();
+	}
+	// The column that is part i of the key
+	int GetKeyColumn(int i) {
+		return key_columns_[i];
+	}
+	bool IsKeyDescending(int i) {
+		return key_descending_[i];
+	}
+	// Encodes the key of row into its key column, in place of any key the
+	// column held
+	void EncodeKey(char *row);
+	// Whether column c is part of a row's (index, primary) key, as the
+	// columns of SetKey are through the encoded key
+	bool IsKeyColumn(int c);
+
+	// Declares a secondary index on the named column, ordered by (column,
+	// primary). Returns the index number to hand to MemTable::Iterator;
+	// index 0 is the table's main index on column 0.
+	// REQUIRES: no MemTable has been created on this schema yet
+	int AddIndex(const std::string &column);
+	int NumIndexes() {
+		return indexes_.size();
+	}
 
-	int GetIndexNumber() {
-		return 0;
+	// The column an index is on
+	int GetIndexNumber(int index = 0) {
+		return indexes_[index];
 	}
 
-	int GetIndexPos() {
-		return cpos_[GetIndexNumber()];
+	int GetIndexPos(int index = 0) {
+		return cpos_[GetIndexNumber(index)];
 	}
 
-	column_t GetIndexType() {
-		return ctypes_[0];
+	column_t GetIndexType(int index = 0) {
+		return ctypes_[GetIndexNumber(index)];
 	}
 
 	int GetPrimaryNumber() {
@@ -71,10 +272,20 @@ private:
 	std::vector<column_t> ctypes_;
 	std::vector<std::string> cnames_;
 	std::vector<int> cpos_;
+	std::vector<int> csize_;
 	int row_byte_sz_;
 	int primary_;
+	int version_pos_;
+	std::vector<int> indexes_; //column of each index, main index first
+	std::vector<int> key_columns_; //empty without SetKey
+	std::vector<bool> key_descending_;
+	std::vector<StringDict *> dicts_; //of each column, NULL if none
+	Arena *arena_;
+	std::atomic<bool> allocated_; //a row buffer has been handed out
 
-	static const int cTypeToSize[2];
+	void Layout();
+	// Storage for the copy a string column without a dictionary owns
+	char *AllocString(size_t n);
 };
 
 } //namespace memdb
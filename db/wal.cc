@@ -0,0 +1,195 @@
+/*
+ * wal.cc
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: jinyang
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <chrono>
+#include <vector>
+#include "db/wal.h"
+#include "util/hash.h"
+
+namespace memdb {
+
+static const uint32_t kChecksumSeed = 0xbc9f1d34;
+static const int kHeaderSize = 8;
+//a leader stops adding records to its group beyond this many bytes
+static const size_t kMaxGroupBytes = 1 << 20;
+
+static void PutFixed32(std::string *dst, uint32_t v) {
+	dst->append((const char *) &v, sizeof(v));
+}
+
+static uint32_t DecodeFixed32(const char *p) {
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+struct Wal::Writer {
+	Slice record;
+	const std::function<void()> *apply;
+	bool done;
+	std::condition_variable cv;
+};
+
+Wal::Wal(const std::string &path, WalSync sync, int sync_ms) :
+		path_(path), sync_(sync), sync_ms_(sync_ms), fd_(-1), groups_(0),
+		shutdown_(false), dirty_(false) {
+}
+
+Wal::~Wal() {
+	if (syncer_.joinable()) {
+		{
+			std::lock_guard<std::mutex> l(sync_mu_);
+			shutdown_ = true;
+		}
+		sync_cv_.notify_one();
+		syncer_.join();
+	}
+	if (fd_ >= 0) {
+		if (sync_ != kSyncNone)
+			Sync();
+		close(fd_);
+	}
+}
+
+bool Wal::Open(const std::function<void(const Slice &)> &replay) {
+	assert(fd_ < 0);
+	fd_ = open(path_.c_str(), O_RDWR | O_CREAT, 0644);
+	if (fd_ < 0)
+		return false;
+
+	std::string log;
+	char buf[65536];
+	ssize_t n;
+	while ((n = read(fd_, buf, sizeof(buf))) != 0) {
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+		log.append(buf, n);
+	}
+
+	size_t good = 0;
+	while (log.size() - good >= (size_t) kHeaderSize) {
+		const char *p = log.data() + good;
+		uint32_t checksum = DecodeFixed32(p);
+		uint32_t len = DecodeFixed32(p + 4);
+		if (log.size() - good - kHeaderSize < len)
+			break;
+		if (Hash(p + kHeaderSize, len, kChecksumSeed) != checksum)
+			break;
+		replay(Slice(p + kHeaderSize, len));
+		good += kHeaderSize + len;
+	}
+	if (good < log.size()) {
+		//torn by a crash in the middle of a write
+		if (ftruncate(fd_, good) != 0)
+			return false;
+	}
+	if (lseek(fd_, good, SEEK_SET) < 0)
+		return false;
+
+	if (sync_ == kSyncPeriodic)
+		syncer_ = std::thread(&Wal::SyncLoop, this);
+	return true;
+}
+
+void Wal::Write(const Slice &record, const std::function<void()> &apply) {
+	Writer w;
+	w.record = record;
+	w.apply = &apply;
+	w.done = false;
+
+	std::unique_lock<std::mutex> l(mu_);
+	writers_.push_back(&w);
+	while (!w.done && &w != writers_.front())
+		w.cv.wait(l);
+	if (w.done)
+		return;
+
+	//we lead a group of everyone queued so far
+	std::string data;
+	std::deque<Writer *>::iterator last = writers_.begin();
+	for (std::deque<Writer *>::iterator it = writers_.begin();
+			it != writers_.end(); ++it) {
+		if (it != writers_.begin()
+				&& data.size() + (*it)->record.size() > kMaxGroupBytes)
+			break;
+		Slice r = (*it)->record;
+		PutFixed32(&data, Hash(r.data(), r.size(), kChecksumSeed));
+		PutFixed32(&data, r.size());
+		data.append(r.data(), r.size());
+		last = it;
+	}
+	size_t group = (last - writers_.begin()) + 1;
+	std::vector<Writer *> members(writers_.begin(), writers_.begin() + group);
+	//later writers keep queueing while this group is written and applied,
+	//and cannot lead one until it is popped
+	l.unlock();
+	WriteGroup(data);
+	for (size_t i = 0; i < group; i++)
+		(*members[i]->apply)();
+	l.lock();
+
+	for (size_t i = 0; i < group; i++) {
+		Writer *m = writers_.front();
+		writers_.pop_front();
+		if (m != &w) {
+			m->done = true;
+			m->cv.notify_one();
+		}
+	}
+	if (!writers_.empty())
+		writers_.front()->cv.notify_one();
+}
+
+void Wal::WriteGroup(const std::string &data) {
+	const char *p = data.data();
+	size_t left = data.size();
+	while (left > 0) {
+		ssize_t n = write(fd_, p, left);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			//the table would run ahead of its log
+			perror("wal write");
+			abort();
+		}
+		p += n;
+		left -= n;
+	}
+	groups_++;
+	if (sync_ == kSyncEveryWrite)
+		Sync();
+	else
+		dirty_.store(true, std::memory_order_release);
+}
+
+void Wal::Sync() {
+	if (fdatasync(fd_) != 0) {
+		perror("wal fdatasync");
+		abort();
+	}
+}
+
+void Wal::SyncLoop() {
+	std::unique_lock<std::mutex> l(sync_mu_);
+	while (!shutdown_) {
+		sync_cv_.wait_for(l, std::chrono::milliseconds(sync_ms_));
+		if (dirty_.exchange(false, std::memory_order_acq_rel))
+			Sync();
+	}
+}
+
+} //namespace memdb
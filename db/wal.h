@@ -0,0 +1,95 @@
+/*
+ * wal.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: jinyang
+ */
+
+#ifndef MEMDB_DB_WAL_H_
+#define MEMDB_DB_WAL_H_
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "util/slice.h"
+
+namespace memdb {
+
+enum WalSync {
+	kSyncEveryWrite = 0, // a write returns once its record is on disk
+	kSyncPeriodic = 1, // a background thread syncs every wal_sync_ms
+	kSyncNone = 2 // left to the OS, survives a process crash only
+};
+
+// Append-only write-ahead log of opaque records.
+//
+// Each record is stored as
+//   checksum: uint32, Hash() of the payload
+//   length:   uint32
+//   payload:  length bytes
+// A crash can leave a torn record at the end; Open() drops it along with
+// anything after it.
+//
+// Write() does group commit the way leveldb's DBImpl::Write does: writers
+// queue up, the one at the front writes the records of everyone queued
+// behind it with a single write() and, under kSyncEveryWrite, a single
+// fdatasync(), then applies their changes in log order while the others
+// wait. Under a steady stream of concurrent writers the cost of a sync is
+// spread over the whole group.
+class Wal {
+public:
+	Wal(const std::string &path, WalSync sync, int sync_ms);
+	// Syncs whatever is still unsynced
+	~Wal();
+
+	// Passes every intact record of the log at path to replay, in order,
+	// cuts off a torn tail and opens the log for appending. Creates the log
+	// if there is none. Returns false on I/O errors.
+	bool Open(const std::function<void(const Slice &)> &replay);
+
+	// Appends record, then calls apply. Calls from different threads are
+	// applied in the order their records are in the log.
+	// REQUIRES: Open() succeeded
+	void Write(const Slice &record, const std::function<void()> &apply);
+
+	// Number of write() calls so far, each covering a group of records
+	uint64_t Groups() {
+		return groups_;
+	}
+
+private:
+	struct Writer;
+
+	void WriteGroup(const std::string &data);
+	void Sync();
+	void SyncLoop();
+
+	std::string path_;
+	WalSync sync_;
+	int sync_ms_;
+	int fd_;
+	uint64_t groups_;
+
+	std::mutex mu_; //protects writers_
+	std::deque<Writer *> writers_;
+
+	//kSyncPeriodic only
+	std::thread syncer_;
+	std::mutex sync_mu_;
+	std::condition_variable sync_cv_;
+	bool shutdown_;
+	std::atomic<bool> dirty_;
+
+	//no copying allowed
+	Wal(const Wal &);
+	void operator=(const Wal &);
+};
+
+} //namespace memdb
+
+#endif
@@ -0,0 +1,87 @@
+/*
+ * arena.cc
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: jinyang
+ */
+
+#include "util/arena.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace memdb {
+
+Arena::Arena(size_t row_size) :
+		free_rows_(NULL), slab_ptr_(NULL), slab_left_(0), heap_ptr_(NULL),
+		heap_left_(0), rows_used_(0), heap_used_(0), reserved_(0) {
+	//free rows hold a pointer, and rows must stay pointer aligned
+	row_size_ = (row_size + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+	if (row_size_ == 0)
+		row_size_ = sizeof(void *);
+}
+
+Arena::~Arena() {
+	Reset();
+}
+
+char *Arena::NewChunk(size_t bytes) {
+	char *c = (char *) malloc(bytes);
+	assert(c);
+	chunks_.push_back(c);
+	reserved_ += bytes;
+	return c;
+}
+
+char *Arena::AllocRow() {
+	char *r;
+	if (free_rows_) {
+		r = free_rows_;
+		free_rows_ = *(char **) r;
+	} else {
+		if (slab_left_ == 0) {
+			slab_ptr_ = NewChunk(row_size_ * kSlabRows);
+			slab_left_ = kSlabRows;
+		}
+		r = slab_ptr_;
+		slab_ptr_ += row_size_;
+		slab_left_--;
+	}
+	rows_used_++;
+	memset(r, 0, row_size_);
+	return r;
+}
+
+void Arena::FreeRow(char *row) {
+	*(char **) row = free_rows_;
+	free_rows_ = row;
+	rows_used_--;
+}
+
+char *Arena::Allocate(size_t n) {
+	heap_used_ += n;
+	if (n > kHeapChunk / 4) {
+		//big objects get their own chunk so the current one is not wasted
+		return NewChunk(n);
+	}
+	if (n > heap_left_) {
+		heap_ptr_ = NewChunk(kHeapChunk);
+		heap_left_ = kHeapChunk;
+	}
+	char *p = heap_ptr_;
+	heap_ptr_ += n;
+	heap_left_ -= n;
+	return p;
+}
+
+void Arena::Reset() {
+	for (size_t i = 0; i < chunks_.size(); i++)
+		free(chunks_[i]);
+	chunks_.clear();
+	free_rows_ = slab_ptr_ = heap_ptr_ = NULL;
+	slab_left_ = heap_left_ = 0;
+	rows_used_ = heap_used_ = reserved_ = 0;
+}
+
+} //namespace memdb
@@ -0,0 +1,70 @@
+/*
+ * arena.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: jinyang
+ */
+
+#ifndef MEMDB_UTIL_ARENA_H_
+#define MEMDB_UTIL_ARENA_H_
+
+#include <stddef.h>
+#include <vector>
+
+namespace memdb {
+
+// Chunked allocator for one table: fixed-size row buffers are carved out of
+// slabs and recycled through a free list, variable sized payloads (strings)
+// are bump allocated and only given back all at once by Reset().
+class Arena {
+public:
+	explicit Arena(size_t row_size);
+	~Arena();
+
+	// Returns a zeroed row buffer
+	char *AllocRow();
+	// Puts a row buffer back on the free list
+	void FreeRow(char *row);
+
+	// Returns n bytes from the bump heap, released by Reset()
+	char *Allocate(size_t n);
+
+	// Frees every chunk, invalidating all memory handed out so far
+	void Reset();
+
+	// Bytes handed out in live rows and heap allocations
+	size_t MemoryUsed() const {
+		return rows_used_ * row_size_ + heap_used_;
+	}
+
+	// Bytes obtained from malloc
+	size_t MemoryReserved() const {
+		return reserved_;
+	}
+
+private:
+	enum {
+		kSlabRows = 4096, kHeapChunk = 64 * 1024
+	};
+
+	char *NewChunk(size_t bytes);
+
+	size_t row_size_;
+	char *free_rows_; //linked through the first word of each free row
+	char *slab_ptr_;
+	size_t slab_left_; //rows left in the current slab
+	char *heap_ptr_;
+	size_t heap_left_;
+	std::vector<char *> chunks_;
+	size_t rows_used_;
+	size_t heap_used_;
+	size_t reserved_;
+
+	//no copying allowed
+	Arena(const Arena &);
+	void operator=(const Arena &);
+};
+
+} //namespace memdb
+
+#endif
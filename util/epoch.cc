@@ -0,0 +1,128 @@
+/*
+ * epoch.cc
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: jinyang
+ */
+
+#include "util/epoch.h"
+
+#include <assert.h>
+#include <functional>
+#include <thread>
+
+namespace memdb {
+
+EpochManager::Block::Block() :
+		next(NULL) {
+	for (int i = 0; i < kSlots; i++)
+		slots[i].epoch.store(0);
+}
+
+EpochManager::EpochManager() :
+		global_(1), since_reclaim_(0) {
+}
+
+EpochManager::~EpochManager() {
+	Block *next = head_.next.load();
+	for (Block *b = &head_; b != NULL; b = next) {
+		next = b->next.load();
+		for (int i = 0; i < kSlots; i++)
+			assert(b->slots[i].epoch.load() == 0);
+		if (b != &head_)
+			delete b;
+	}
+	for (size_t i = 0; i < retired_.size(); i++)
+		retired_[i].deleter(retired_[i].arg, retired_[i].p);
+}
+
+//A new block is published with the caller's slot already taken, the same
+//as claiming a slot of a block Reclaim() has yet to scan
+int EpochManager::Claim(uint64_t epoch) {
+	//start at a per thread position to keep readers off each other's lines
+	size_t start = std::hash<std::thread::id>()(std::this_thread::get_id());
+	int base = 0;
+	for (Block *b = &head_;; base += kSlots) {
+		for (int i = 0; i < kSlots; i++) {
+			int s = (start + i) % kSlots;
+			uint64_t expected = 0;
+			if (b->slots[s].epoch.load(std::memory_order_relaxed) == 0
+					&& b->slots[s].epoch.compare_exchange_strong(expected,
+							epoch))
+				return base + s;
+		}
+		Block *next = b->next.load();
+		if (next == NULL) {
+			Block *fresh = new Block();
+			int s = start % kSlots;
+			fresh->slots[s].epoch.store(epoch, std::memory_order_relaxed);
+			if (b->next.compare_exchange_strong(next, fresh))
+				return base + kSlots + s;
+			//another reader added one first, try its slots
+			delete fresh;
+		}
+		b = next;
+	}
+}
+
+std::atomic<uint64_t> &EpochManager::SlotEpoch(int slot) {
+	Block *b = &head_;
+	for (; slot >= kSlots; slot -= kSlots)
+		b = b->next.load();
+	return b->slots[slot].epoch;
+}
+
+//A reader whose slot a concurrent Reclaim() misses has announced itself
+//after that scan, so it can only reach objects unlinked later than that.
+int EpochManager::Enter() {
+	return Claim(global_.load());
+}
+
+int EpochManager::EnterAs(int slot) {
+	uint64_t e = SlotEpoch(slot).load();
+	assert(e != 0);
+	return Claim(e);
+}
+
+void EpochManager::Exit(int slot) {
+	SlotEpoch(slot).store(0, std::memory_order_release);
+}
+
+void EpochManager::Retire(Deleter d, void *arg, void *p) {
+	std::lock_guard<std::mutex> l(mu_);
+	Retired r = { global_.load(), d, arg, p };
+	retired_.push_back(r);
+	if (++since_reclaim_ >= kReclaimEvery)
+		ReclaimLocked();
+}
+
+void EpochManager::Reclaim() {
+	std::lock_guard<std::mutex> l(mu_);
+	ReclaimLocked();
+}
+
+void EpochManager::ReclaimLocked() {
+	since_reclaim_ = 0;
+	uint64_t min = global_.fetch_add(1) + 1;
+	for (Block *b = &head_; b != NULL; b = b->next.load()) {
+		for (int i = 0; i < kSlots; i++) {
+			uint64_t e = b->slots[i].epoch.load();
+			if (e != 0 && e < min)
+				min = e;
+		}
+	}
+	//an object retired at epoch r was unlinked before any reader entered
+	//at an epoch > r
+	while (!retired_.empty() && retired_.front().epoch < min) {
+		Retired r = retired_.front();
+		retired_.pop_front();
+		r.deleter(r.arg, r.p);
+	}
+}
+
+size_t EpochManager::Pending() {
+	std::lock_guard<std::mutex> l(mu_);
+	return retired_.size();
+}
+
+} //namespace memdb
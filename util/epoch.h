@@ -0,0 +1,97 @@
+/*
+ * epoch.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: jinyang
+ */
+
+#ifndef MEMDB_UTIL_EPOCH_H_
+#define MEMDB_UTIL_EPOCH_H_
+
+#include <stdint.h>
+#include <atomic>
+#include <deque>
+#include <mutex>
+
+namespace memdb {
+
+// Epoch based reclamation for structures read without locks.
+//
+// A reader calls Enter() before it loads any shared pointer and Exit() when
+// it no longer holds any. A writer that has unlinked an object hands it to
+// Retire(), which frees it once every reader that entered before the unlink
+// has exited. Long running readers delay reclamation but never see freed
+// memory.
+//
+// Every reader inside holds a slot, such as a MemTable::Iterator of a
+// concurrent table for as long as it lives. Slots come in blocks of
+// kSlots, and a block is added whenever all of them are taken, so any
+// number of readers may be inside at once.
+class EpochManager {
+public:
+	typedef void (*Deleter)(void *arg, void *p);
+
+	EpochManager();
+	// Frees everything still retired.
+	// REQUIRES: no reader inside
+	~EpochManager();
+
+	// Returns the slot to pass to Exit()
+	int Enter();
+	// Enters with the same epoch as the reader in slot, so a copy of that
+	// reader's state is protected as long as the original was
+	int EnterAs(int slot);
+	void Exit(int slot);
+
+	// Arranges for d(arg, p) to run once no reader can still reach p
+	void Retire(Deleter d, void *arg, void *p);
+
+	// Advances the epoch and frees whatever is safe, called by Retire()
+	// every kReclaimEvery objects
+	void Reclaim();
+
+	size_t Pending();
+
+private:
+	enum {
+		kSlots = 128, kReclaimEvery = 64
+	};
+
+	struct Slot {
+		std::atomic<uint64_t> epoch; //0 if the slot is free
+		char pad[64 - sizeof(std::atomic<uint64_t>)];
+	};
+
+	//slot numbers run on from one block to the next; blocks are only
+	//freed with the manager, so readers walk the list without a lock
+	struct Block {
+		Block();
+		Slot slots[kSlots];
+		std::atomic<Block *> next;
+	};
+
+	struct Retired {
+		uint64_t epoch;
+		Deleter deleter;
+		void *arg;
+		void *p;
+	};
+
+	int Claim(uint64_t epoch);
+	std::atomic<uint64_t> &SlotEpoch(int slot);
+	void ReclaimLocked();
+
+	Block head_;
+	std::atomic<uint64_t> global_;
+	std::mutex mu_; //protects retired_
+	std::deque<Retired> retired_;
+	size_t since_reclaim_;
+
+	//no copying allowed
+	EpochManager(const EpochManager &);
+	void operator=(const EpochManager &);
+};
+
+} //namespace memdb
+
+#endif
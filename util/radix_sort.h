@@ -0,0 +1,91 @@
+/*
+ * radix_sort.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: jinyang
+ */
+
+#ifndef MEMDB_UTIL_RADIX_SORT_H_
+#define MEMDB_UTIL_RADIX_SORT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+namespace memdb {
+
+// Calls f(t, lo, hi) for nthreads contiguous chunks of [0, n), chunk t on
+// its own thread unless there is only one.
+template<class F>
+void RunChunks(size_t nthreads, size_t n, const F &f) {
+	if (nthreads == 1) {
+		f(0, 0, n);
+		return;
+	}
+	std::vector<std::thread> threads;
+	for (size_t t = 0; t < nthreads; t++)
+		threads.push_back(std::thread(f, t, n * t / nthreads,
+				n * (t + 1) / nthreads));
+	for (size_t t = 0; t < nthreads; t++)
+		threads[t].join();
+}
+
+// Stable LSD radix sort of records on their uint64_t "key" member, 11 bits
+// per pass. Digits on which all keys agree are skipped, so small integer
+// keys take few passes. Each pass is split over the hardware threads: every
+// thread counts and then scatters its own contiguous chunk, and the counts
+// are summed in (digit, thread) order, which keeps the sort stable.
+template<class T>
+void ParallelRadixSort(std::vector<T> *v) {
+	const int kBits = 11;
+	const size_t kBuckets = 1 << kBits;
+	const size_t kMinChunk = 1 << 16;
+	size_t n = v->size();
+	if (n < 2)
+		return;
+
+	std::vector<T> tmp(n);
+	T *src = v->data(), *dst = tmp.data();
+	uint64_t diff = 0;
+	for (size_t i = 1; i < n; i++)
+		diff |= src[i].key ^ src[0].key;
+
+	size_t nthreads = std::thread::hardware_concurrency();
+	nthreads = std::min(nthreads, n / kMinChunk);
+	if (nthreads < 1)
+		nthreads = 1;
+	std::vector<size_t> counts(nthreads * kBuckets);
+
+	for (int shift = 0; shift < 64; shift += kBits) {
+		if (((diff >> shift) & (kBuckets - 1)) == 0)
+			continue;
+		RunChunks(nthreads, n, [&](size_t t, size_t lo, size_t hi) {
+			size_t *c = &counts[t * kBuckets];
+			std::fill(c, c + kBuckets, 0);
+			for (size_t i = lo; i < hi; i++)
+				c[(src[i].key >> shift) & (kBuckets - 1)]++;
+		});
+		size_t sum = 0;
+		for (size_t d = 0; d < kBuckets; d++) {
+			for (size_t t = 0; t < nthreads; t++) {
+				size_t c = counts[t * kBuckets + d];
+				counts[t * kBuckets + d] = sum;
+				sum += c;
+			}
+		}
+		RunChunks(nthreads, n, [&](size_t t, size_t lo, size_t hi) {
+			size_t *c = &counts[t * kBuckets];
+			for (size_t i = lo; i < hi; i++)
+				dst[c[(src[i].key >> shift) & (kBuckets - 1)]++] = src[i];
+		});
+		std::swap(src, dst);
+	}
+	if (src != v->data())
+		v->swap(tmp);
+}
+
+} //namespace memdb
+
+#endif